@@ -0,0 +1,42 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+#ifdef RBTREE_MALLOC_NODES
+#define VARIANT "malloc"
+#else
+#define VARIANT "slab"
+#endif
+
+// insert/erase churn: the allocator sits on the hot path of every operation
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report(VARIANT, "insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i += 2) {
+    rbtree_erase(t, rbtree_find(t, keys[i]));
+  }
+  for (size_t i = 0; i < n; i += 2) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report(VARIANT, "erase+reinsert", n, now_ns() - start);
+
+  start = now_ns();
+  delete_rbtree(t);
+  bench_report(VARIANT, "delete_rbtree", n, now_ns() - start);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+static int comp(const void *p1, const void *p2) {
+  const key_t k1 = *(const key_t *)p1, k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+static void run(const char *dist, const key_t *keys, const size_t n) {
+  char op[64];
+
+  uint64_t start = now_ns();
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  snprintf(op, sizeof(op), "insert loop %s", dist);
+  bench_report("rbtree", op, n, now_ns() - start);
+  delete_rbtree(t);
+
+  start = now_ns();
+  t = rbtree_from_array(keys, n);
+  snprintf(op, sizeof(op), "from_array %s", dist);
+  bench_report("rbtree", op, n, now_ns() - start);
+  delete_rbtree(t);
+}
+
+// startup cost: build a tree of n keys one insert at a time vs in bulk
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+  run("random", keys, n);
+
+  qsort(keys, n, sizeof(key_t), comp);
+  run("sorted", keys, n);
+
+  free(keys);
+  return 0;
+}
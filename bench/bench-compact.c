@@ -0,0 +1,61 @@
+#include <rbtree.h>
+#include <rbtree_compact.h>
+
+#include "bench.h"
+
+static size_t rbtree_memory(const rbtree *t) {
+  size_t bytes = sizeof(rbtree) + sizeof(rbtree_pool_t);  // tree and pool
+  for (const node_chunk_t *c = t->pool->chunks; c != NULL; c = c->next) {
+    bytes += sizeof(node_chunk_t) + c->capacity * sizeof(node_t);
+  }
+  return bytes;
+}
+
+static void report_memory(const char *variant, size_t bytes, size_t n) {
+  printf("%-10s %-24s n=%-10zu %10.1f bytes/key\n", variant, "memory", n,
+         (double)bytes / (double)n);
+}
+
+// pointer-linked node_t vs index-linked cnode_t: memory, insert and find
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+  volatile size_t found = 0;
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report("rbtree", "insert", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += rbtree_find(t, keys[n - 1 - i]) != NULL;
+  }
+  bench_report("rbtree", "find", n, now_ns() - start);
+  report_memory("rbtree", rbtree_memory(t), n);
+  delete_rbtree(t);
+
+  compact_rbtree *c = new_compact_rbtree();
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    compact_rbtree_insert(c, keys[i]);
+  }
+  bench_report("compact", "insert", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += compact_rbtree_find(c, keys[n - 1 - i]) != NULL;
+  }
+  bench_report("compact", "find", n, now_ns() - start);
+  report_memory("compact", compact_rbtree_memory(c), n);
+  printf("%-10s %-24s %zu bytes/node (node_t %zu)\n", "compact", "sizeof",
+         sizeof(cnode_t), sizeof(node_t));
+  delete_compact_rbtree(c);
+
+  free(keys);
+  return found == 2 * n ? 0 : 1;
+}
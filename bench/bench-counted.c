@@ -0,0 +1,70 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+#define DISTINCT 256  // distinct keys, so every key has about n / 256 copies
+
+static size_t rbtree_memory(const rbtree *t) {
+  size_t bytes = sizeof(rbtree) + sizeof(rbtree_pool_t);
+  for (const node_chunk_t *c = t->pool->chunks; c != NULL; c = c->next) {
+    bytes += sizeof(node_chunk_t) + c->capacity * sizeof(node_t);
+  }
+  return bytes;
+}
+
+static int height(const rbtree *t, const node_t *p) {
+  if (p == t->nil) {
+    return 0;
+  }
+  const int l = height(t, p->left), r = height(t, p->right);
+  return 1 + (l > r ? l : r);
+}
+
+static void run(const char *variant, rbtree *t, const key_t *keys, size_t n) {
+  volatile size_t found = 0;
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report(variant, "insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += rbtree_find(t, keys[n - 1 - i]) != NULL;
+  }
+  bench_report(variant, "find", n, now_ns() - start);
+
+  key_t *arr = malloc(n * sizeof(key_t));
+  start = now_ns();
+  rbtree_to_array(t, arr, n);
+  bench_report(variant, "to_array", n, now_ns() - start);
+  found += arr[n / 2] >= 0;
+  free(arr);
+
+  printf("%-10s %-24s n=%-10zu %10zu bytes (height %d)\n", variant, "memory",
+         n, rbtree_memory(t), height(t, t->root));
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_erase(t, rbtree_find(t, keys[i]));
+  }
+  bench_report(variant, "find+erase", n, now_ns() - start);
+  delete_rbtree(t);
+}
+
+// duplicate-heavy input (as test_duplicate_values, at scale): one node per
+// copy vs one counted node per distinct key
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(bench_rand(&seed) % DISTINCT);
+  }
+
+  run("plain", new_rbtree(), keys, n);
+  run("counted", new_rbtree_counted(), keys, n);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+#define BATCH 4096
+
+// batches of BATCH probes (about half of them hits) against a tree of n keys
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  const size_t rounds = 256;
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(&seed) % (2 * n)));
+  }
+
+  key_t *keys = malloc(rounds * BATCH * sizeof(key_t));
+  for (size_t i = 0; i < rounds * BATCH; i++) {
+    keys[i] = (key_t)(bench_rand(&seed) % (2 * n));
+  }
+  node_t **out = malloc(BATCH * sizeof(node_t *));
+  volatile size_t hits = 0;
+
+  uint64_t start = now_ns();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < BATCH; i++) {
+      out[i] = rbtree_find(t, keys[r * BATCH + i]);
+    }
+    hits += out[BATCH - 1] != NULL;
+  }
+  bench_report("rbtree", "find loop", rounds * BATCH, now_ns() - start);
+
+  start = now_ns();
+  for (size_t r = 0; r < rounds; r++) {
+    rbtree_find_many(t, keys + r * BATCH, BATCH, out);
+    hits += out[BATCH - 1] != NULL;
+  }
+  bench_report("rbtree", "find_many", rounds * BATCH, now_ns() - start);
+
+  free(out);
+  free(keys);
+  delete_rbtree(t);
+  return 0;
+}
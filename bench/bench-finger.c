@@ -0,0 +1,73 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+static void run(const char *dist, const key_t *keys, const size_t n) {
+  char op[64];
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  snprintf(op, sizeof(op), "insert %s", dist);
+  bench_report("root", op, n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    sink += rbtree_find(t, keys[i]) != NULL;
+  }
+  snprintf(op, sizeof(op), "find %s", dist);
+  bench_report("root", op, n, now_ns() - start);
+  delete_rbtree(t);
+
+  // NULL hint: the last inserted node
+  t = new_rbtree();
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert_hint(t, NULL, keys[i]);
+  }
+  snprintf(op, sizeof(op), "insert %s", dist);
+  bench_report("finger", op, n, now_ns() - start);
+
+  // each find starts from the node the previous one found
+  node_t *finger = rbtree_min(t);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find_from(t, finger, keys[i]);
+    finger = p != NULL ? p : finger;
+  }
+  snprintf(op, sizeof(op), "find %s", dist);
+  bench_report("finger", op, n, now_ns() - start);
+  sink += (size_t)finger;
+  delete_rbtree(t);
+}
+
+// keys that arrive in order (timestamps), nearly in order (timestamps with
+// jitter of a few places) and at random: descending from the root vs finger
+// search from the last node
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = calloc(n, sizeof(key_t));
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(i * 16);
+  }
+  run("sorted", keys, n);
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(i * 16 + bench_rand(&seed) % 64);
+  }
+  run("nearly-sorted", keys, n);
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+  run("random", keys, n);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <rbtree_frozen.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+static int count_key(const key_t *p, void *ctx) {
+  *(size_t *)ctx += (size_t)*p;
+  return 0;
+}
+
+// random lookups on the live tree against the frozen Eytzinger copy. Half of
+// the probes hit and half miss; range scans visit about 100 keys each.
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  const size_t queries = 1000000;
+  const size_t scans = 10000;
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)((bench_rand(&seed) >> 35) << 1);
+    rbtree_insert(t, keys[i]);
+  }
+  key_t *probes = malloc(queries * sizeof(key_t));
+  for (size_t i = 0; i < queries; i++) {
+    probes[i] = keys[bench_rand(&seed) % n] | (key_t)(i & 1);
+  }
+
+  uint64_t start = now_ns();
+  rbtree_frozen_t *f = rbtree_freeze(t);
+  bench_report("frozen", "freeze", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    sink += rbtree_find(t, probes[i]) != NULL;
+  }
+  bench_report("rbtree", "find", queries, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    sink += rbtree_frozen_find(f, probes[i]) != NULL;
+  }
+  bench_report("frozen", "find", queries, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    sink += rbtree_lower_bound(t, probes[i]) != NULL;
+  }
+  bench_report("rbtree", "lower_bound", queries, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    sink += rbtree_frozen_lower_bound(f, probes[i]) != NULL;
+  }
+  bench_report("frozen", "lower_bound", queries, now_ns() - start);
+
+  // keys are even numbers below 2^30, so this width holds ~100 of them
+  const key_t width = (key_t)((1ull << 30) / n * 100);
+  size_t visited = 0;
+  start = now_ns();
+  for (size_t i = 0; i < scans; i++) {
+    for (node_t *p = rbtree_lower_bound(t, probes[i]);
+         p != NULL && p->key < probes[i] + width; p = rbtree_iter_next(t, p)) {
+      visited += (size_t)p->key;
+    }
+  }
+  bench_report("rbtree", "range scan", scans, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < scans; i++) {
+    rbtree_frozen_foreach_range(f, probes[i], probes[i] + width, count_key,
+                                &visited);
+  }
+  bench_report("frozen", "range scan", scans, now_ns() - start);
+  sink += visited;
+
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+  free(probes);
+  free(keys);
+  return 0;
+}
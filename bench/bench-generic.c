@@ -0,0 +1,66 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+#define RBMAP_NAME intmap
+#define RBMAP_KEY key_t
+#define RBMAP_VALUE int
+#include <rbtree_map.h>
+
+static volatile size_t sink;
+
+// the same insert / find / erase loop on rbtree.c and on the int instantiation
+// of rbtree_map.h. Both take their descents and rebalancing from rbtree_core.h;
+// rbtree.c adds subtree sizes, counted mode, shared pools and the lock-free
+// reader hooks through its parameters, which should cost nothing here.
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report("rbtree", "insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    sink += rbtree_find(t, keys[i]) != NULL;
+  }
+  bench_report("rbtree", "find", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_erase(t, rbtree_find(t, keys[i]));
+  }
+  bench_report("rbtree", "find+erase", n, now_ns() - start);
+  delete_rbtree(t);
+
+  intmap *m = intmap_new();
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    intmap_insert(m, keys[i], (int)i);
+  }
+  bench_report("intmap", "insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    sink += intmap_find(m, keys[i]) != NULL;
+  }
+  bench_report("intmap", "find", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    intmap_erase(m, intmap_find(m, keys[i]));
+  }
+  bench_report("intmap", "find+erase", n, now_ns() - start);
+  intmap_delete(m);
+
+  free(keys);
+  return 0;
+}
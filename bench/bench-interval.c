@@ -0,0 +1,56 @@
+#include <rbtree_interval.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+// n time ranges (mostly short, a few long) queried with short windows: the
+// interval tree against scanning an array of every range
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  const size_t queries = 10000;
+  const uint64_t span = 16 * (uint64_t)n;
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *lo = calloc(n, sizeof(key_t));
+  key_t *hi = calloc(n, sizeof(key_t));
+
+  interval_rbtree *t = new_interval_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t x = bench_rand(&seed);
+    lo[i] = (key_t)(x % span);
+    hi[i] = lo[i] + (key_t)((x >> 40) % 64 == 0 ? (x >> 20) % 65536 : (x >> 20) % 256);
+    interval_rbtree_insert(t, lo[i], hi[i]);
+  }
+  bench_report("interval", "insert", n, now_ns() - start);
+
+  for (key_t window = 0; window <= 4096; window += 4096) {
+    char op[64];
+    size_t found = 0;
+    uint64_t qseed = 0x2545f4914f6cdd1dull;
+    start = now_ns();
+    for (size_t i = 0; i < queries; i++) {
+      const key_t a = (key_t)(bench_rand(&qseed) % span);
+      found += interval_rbtree_overlaps(t, a, a + window, NULL, NULL);
+    }
+    snprintf(op, sizeof(op), "overlaps w=%d", window);
+    bench_report("interval", op, queries, now_ns() - start);
+
+    size_t scanned = 0;
+    qseed = 0x2545f4914f6cdd1dull;
+    start = now_ns();
+    for (size_t i = 0; i < queries / 100; i++) {
+      const key_t a = (key_t)(bench_rand(&qseed) % span);
+      for (size_t j = 0; j < n; j++) {
+        scanned += lo[j] <= a + window && hi[j] >= a;
+      }
+    }
+    bench_report("scan", op, queries / 100, now_ns() - start);
+    sink += found + scanned;
+  }
+
+  delete_interval_rbtree(t);
+  free(lo);
+  free(hi);
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include <rbtree_intrusive.h>
+
+#include "bench.h"
+
+#define RBMAP_NAME ptrmap
+#define RBMAP_KEY key_t
+#define RBMAP_VALUE struct item *
+#include <rbtree_map.h>
+
+typedef struct item {
+  key_t key;
+  uint64_t payload;
+  rbtree_link_t link;
+} item_t;
+
+static volatile uint64_t sink;
+
+static int compare_items(const rbtree_link_t *a, const rbtree_link_t *b) {
+  const key_t ka = rbtree_entry(a, item_t, link)->key;
+  const key_t kb = rbtree_entry(b, item_t, link)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+static int compare_key(const void *key, const rbtree_link_t *link) {
+  const key_t k = *(const key_t *)key;
+  const key_t kl = rbtree_entry(link, item_t, link)->key;
+  return (k > kl) - (k < kl);
+}
+
+// the descent a caller writes itself, with the comparison inlined
+static item_t *find_inline(const intrusive_rbtree *t, const key_t key) {
+  const rbtree_link_t *p = t->root;
+  while (p != NULL && rbtree_entry(p, item_t, link)->key != key) {
+    p = key < rbtree_entry(p, item_t, link)->key ? p->left : p->right;
+  }
+  return p != NULL ? rbtree_entry(p, item_t, link) : NULL;
+}
+
+// objects that already exist in the caller's array, indexed two ways: a map
+// node per object that points back at it, or links embedded in the objects.
+// Lookups read the payload, so the map pays the extra pointer hop.
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  item_t *items = calloc(n, sizeof(item_t));
+  key_t *probes = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    items[i].key = (key_t)bench_rand(&seed);
+    items[i].payload = i;
+  }
+  for (size_t i = 0; i < n; i++) {
+    probes[i] = items[bench_rand(&seed) % n].key;
+  }
+
+  ptrmap *m = ptrmap_new();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    ptrmap_insert(m, items[i].key, &items[i]);
+  }
+  bench_report("ptrmap", "insert", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    sink += ptrmap_find(m, probes[i])->value->payload;
+  }
+  bench_report("ptrmap", "find+payload", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    ptrmap_erase(m, ptrmap_find(m, items[i].key));
+  }
+  bench_report("ptrmap", "find+erase", n, now_ns() - start);
+  ptrmap_delete(m);
+
+  intrusive_rbtree t;
+  intrusive_rbtree_init(&t);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    intrusive_rbtree_insert(&t, &items[i].link, compare_items);
+  }
+  bench_report("intrusive", "insert", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_link_t *p = intrusive_rbtree_find(&t, &probes[i], compare_key);
+    sink += rbtree_entry(p, item_t, link)->payload;
+  }
+  bench_report("intrusive", "find+payload (cmp)", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    sink += find_inline(&t, probes[i])->payload;
+  }
+  bench_report("intrusive", "find+payload (inline)", n, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    intrusive_rbtree_erase(&t, &find_inline(&t, items[i].key)->link);
+  }
+  bench_report("intrusive", "find+erase", n, now_ns() - start);
+
+  free(probes);
+  free(items);
+  return 0;
+}
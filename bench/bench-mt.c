@@ -0,0 +1,133 @@
+#include <pthread.h>
+#include <rbtree_mt.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define READS_PER_THREAD 1000000
+#define MAX_THREADS 64
+
+typedef enum { MODE_MUTEX, MODE_RWLOCK, MODE_LOCKFREE } mode_t_;
+static const char *mode_names[] = {"mutex", "rwlock", "lockfree"};
+
+// "mutex" is the baseline: one global mutex around a plain rbtree
+typedef struct {
+  mode_t_ mode;
+  mt_rbtree *mt;
+  rbtree *plain;
+  pthread_mutex_t lock;
+  size_t n;
+  volatile int stop;
+  size_t writes;
+} shared_t;
+
+typedef struct {
+  shared_t *s;
+  uint64_t seed;
+  size_t hits;
+} reader_arg_t;
+
+static void *reader(void *arg) {
+  reader_arg_t *r = (reader_arg_t *)arg;
+  shared_t *s = r->s;
+  for (size_t i = 0; i < READS_PER_THREAD; i++) {
+    const key_t key = (key_t)(bench_rand(&r->seed) % (2 * s->n));
+    if (s->mode == MODE_MUTEX) {
+      pthread_mutex_lock(&s->lock);
+      r->hits += rbtree_find(s->plain, key) != NULL;
+      pthread_mutex_unlock(&s->lock);
+    } else {
+      const int slot = mt_rbtree_read_lock(s->mt);
+      r->hits += mt_rbtree_find(s->mt, key) != NULL;
+      mt_rbtree_read_unlock(s->mt, slot);
+    }
+  }
+  return NULL;
+}
+
+// one writer keeps churning keys until every reader is done
+static void *writer(void *arg) {
+  shared_t *s = (shared_t *)arg;
+  uint64_t seed = 0xdeadbeefull;
+  while (!s->stop) {
+    const key_t key = (key_t)(bench_rand(&seed) % (2 * s->n));
+    if (s->mode == MODE_MUTEX) {
+      pthread_mutex_lock(&s->lock);
+      node_t *p = rbtree_find(s->plain, key);
+      if (p != NULL) {
+        rbtree_erase(s->plain, p);
+      } else {
+        rbtree_insert(s->plain, key);
+      }
+      pthread_mutex_unlock(&s->lock);
+    } else if (mt_rbtree_erase_key(s->mt, key) < 0) {
+      mt_rbtree_insert(s->mt, key);
+    }
+    s->writes++;
+  }
+  return NULL;
+}
+
+static void run(mode_t_ mode, size_t n, int threads) {
+  shared_t s = {.mode = mode, .n = n};
+  pthread_mutex_init(&s.lock, NULL);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  if (mode == MODE_MUTEX) {
+    s.plain = new_rbtree();
+  } else {
+    s.mt = new_mt_rbtree(mode == MODE_RWLOCK ? RBTREE_MT_RWLOCK
+                                             : RBTREE_MT_LOCKFREE);
+  }
+  for (size_t i = 0; i < n; i++) {
+    const key_t key = (key_t)(bench_rand(&seed) % (2 * n));
+    if (mode == MODE_MUTEX) {
+      rbtree_insert(s.plain, key);
+    } else {
+      mt_rbtree_insert(s.mt, key);
+    }
+  }
+
+  pthread_t w, tids[MAX_THREADS];
+  reader_arg_t args[MAX_THREADS];
+  uint64_t start = now_ns();
+  pthread_create(&w, NULL, writer, &s);
+  for (int i = 0; i < threads; i++) {
+    args[i] = (reader_arg_t){&s, 0x1234567ull * (i + 1), 0};
+    pthread_create(&tids[i], NULL, reader, &args[i]);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  const uint64_t elapsed = now_ns() - start;
+  s.stop = 1;
+  pthread_join(w, NULL);
+
+  const double reads = (double)threads * READS_PER_THREAD;
+  printf("%-10s threads=%-3d %10.2f Mreads/s %10.2f Mwrites/s\n",
+         mode_names[mode], threads, reads * 1e3 / (double)elapsed,
+         (double)s.writes * 1e3 / (double)elapsed);
+
+  if (mode == MODE_MUTEX) {
+    delete_rbtree(s.plain);
+  } else {
+    delete_mt_rbtree(s.mt);
+  }
+  pthread_mutex_destroy(&s.lock);
+}
+
+// reader throughput from 1 to N reader threads with one concurrent writer
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  long max_threads = argc > 2 ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (max_threads < 1) {
+    max_threads = 1;
+  } else if (max_threads > MAX_THREADS) {
+    max_threads = MAX_THREADS;
+  }
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    for (int mode = MODE_MUTEX; mode <= MODE_LOCKFREE; mode++) {
+      run((mode_t_)mode, n, threads);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <rbtree_par.h>
+
+#include "bench.h"
+
+static volatile uint64_t sink;
+
+static uint64_t add_key(key_t key, size_t copies, void *ctx) {
+  return (uint64_t)(uint32_t)key * copies;
+}
+
+// one row per bulk operation: the sequential rbtree.c version, then the
+// rbtree_par.h version on 1, 2, 4, ... threads up to max_threads
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 10000000);
+  const int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *sorted = malloc(n * sizeof(key_t));
+  key_t *out = malloc(n * sizeof(key_t));
+  key_t key = 0;
+  for (size_t i = 0; i < n; i++) {
+    key += (key_t)(bench_rand(&seed) % 8);
+    sorted[i] = key;
+  }
+
+  uint64_t start = now_ns();
+  rbtree *t = rbtree_from_sorted_array(sorted, n);
+  bench_report("seq", "from_sorted_array", n, now_ns() - start);
+  start = now_ns();
+  rbtree_to_array(t, out, n);
+  bench_report("seq", "to_array", n, now_ns() - start);
+  start = now_ns();
+  uint64_t sum = 0;
+  for (node_t *p = rbtree_iter_begin(t); p != NULL; p = rbtree_iter_next(t, p)) {
+    sum += add_key(p->key, 1, NULL);
+  }
+  sink += sum;
+  bench_report("seq", "iter sum", n, now_ns() - start);
+  start = now_ns();
+  delete_rbtree(t);
+  bench_report("seq", "delete", n, now_ns() - start);
+
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    char variant[32];
+    snprintf(variant, sizeof(variant), "par x%d", threads);
+    rbtree_par_t *par = new_rbtree_par(threads);
+
+    start = now_ns();
+    t = rbtree_par_from_sorted_array(par, sorted, n);
+    bench_report(variant, "from_sorted_array", n, now_ns() - start);
+    start = now_ns();
+    rbtree_par_to_array(par, t, out, n);
+    bench_report(variant, "to_array", n, now_ns() - start);
+    start = now_ns();
+    sink += rbtree_par_reduce(par, t, add_key, NULL);
+    bench_report(variant, "reduce sum", n, now_ns() - start);
+    start = now_ns();
+    rbtree_par_delete(par, t);
+    bench_report(variant, "delete", n, now_ns() - start);
+
+    delete_rbtree_par(par);
+  }
+
+  free(out);
+  free(sorted);
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <rbtree.h>
+#include <rbtree_persistent.h>
+
+#include "bench.h"
+
+#define SNAPSHOTS 16   // versions readers hold at once
+#define ROUNDS 64      // snapshots taken per run
+
+static volatile size_t sink;
+
+// full copy, the old way to give a reader a stable view
+static rbtree *copy_tree(const rbtree *t, key_t *buf) {
+  const size_t n = rbtree_size(t);
+  rbtree_to_array(t, buf, n);
+  return rbtree_from_sorted_array(buf, n);
+}
+
+// n keys, then ROUNDS times: take a snapshot (readers keep the last
+// SNAPSHOTS) and apply `writes` inserts and erases. Reports the snapshot cost
+// and the bytes all live versions hold next to what full copies would take.
+static void run(const size_t n, const size_t writes) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *buf = malloc((n + ROUNDS * writes) * sizeof(key_t));
+  rbtree *t = new_rbtree();
+  persistent_rbtree *p = new_persistent_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    const key_t key = (key_t)bench_rand(&seed);
+    rbtree_insert(t, key);
+    persistent_rbtree_insert(p, key);
+  }
+
+  rbtree *copies[SNAPSHOTS] = {NULL};
+  persistent_rbtree *versions[SNAPSHOTS] = {NULL};
+  uint64_t copy_ns = 0, snap_ns = 0, copy_write_ns = 0, snap_write_ns = 0;
+  size_t peak_bytes = 0;
+  for (size_t r = 0; r < ROUNDS; r++) {
+    const size_t slot = r % SNAPSHOTS;
+    if (copies[slot] != NULL) {
+      delete_rbtree(copies[slot]);
+      delete_persistent_rbtree(versions[slot]);
+    }
+    uint64_t start = now_ns();
+    copies[slot] = copy_tree(t, buf);
+    copy_ns += now_ns() - start;
+    start = now_ns();
+    versions[slot] = persistent_rbtree_snapshot(p);
+    snap_ns += now_ns() - start;
+
+    // the same writes to both; half inserts, half erases of a fresh key
+    uint64_t wseed = seed;
+    start = now_ns();
+    for (size_t i = 0; i < writes; i++) {
+      const key_t key = (key_t)bench_rand(&wseed);
+      if (i & 1) {
+        rbtree_erase(t, rbtree_insert(t, key));
+      } else {
+        rbtree_insert(t, key);
+      }
+    }
+    copy_write_ns += now_ns() - start;
+    wseed = seed;
+    start = now_ns();
+    for (size_t i = 0; i < writes; i++) {
+      const key_t key = (key_t)bench_rand(&wseed);
+      persistent_rbtree_insert(p, key);
+      if (i & 1) {
+        persistent_rbtree_erase(p, key);
+      }
+    }
+    snap_write_ns += now_ns() - start;
+    seed = wseed;
+
+    const size_t bytes = persistent_rbtree_node_bytes();
+    peak_bytes = bytes > peak_bytes ? bytes : peak_bytes;
+  }
+
+  char op[64];
+  snprintf(op, sizeof(op), "snapshot w=%zu", writes);
+  bench_report("copy", op, ROUNDS, copy_ns);
+  bench_report("persist", op, ROUNDS, snap_ns);
+  snprintf(op, sizeof(op), "write w=%zu", writes);
+  bench_report("copy", op, ROUNDS * writes, copy_write_ns);
+  bench_report("persist", op, ROUNDS * writes, snap_write_ns);
+
+  // the live tree plus SNAPSHOTS versions, per key of the live tree
+  const size_t keys = rbtree_size(t);
+  snprintf(op, sizeof(op), "memory w=%zu", writes);
+  printf("%-10s %-24s n=%-10zu %10.1f bytes/key\n", "copy", op, keys,
+         (double)(SNAPSHOTS + 1) * sizeof(node_t));
+  printf("%-10s %-24s n=%-10zu %10.1f bytes/key\n", "persist", op, keys,
+         (double)peak_bytes / (double)keys);
+
+  for (size_t i = 0; i < SNAPSHOTS; i++) {
+    delete_rbtree(copies[i]);
+    delete_persistent_rbtree(versions[i]);
+  }
+  sink += keys;
+  delete_rbtree(t);
+  delete_persistent_rbtree(p);
+  free(buf);
+}
+
+// O(1) persistent snapshots against full copies of an rbtree, with a few
+// and with many writes between snapshots
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  run(n, 100);
+  run(n, 10000);
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+// array binary min-heap, the usual timer queue
+typedef struct {
+  key_t *keys;
+  size_t n;
+} heap_t;
+
+static void heap_sift_up(heap_t *h, size_t i) {
+  const key_t key = h->keys[i];
+  while (i > 0 && h->keys[(i - 1) / 2] > key) {
+    h->keys[i] = h->keys[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h->keys[i] = key;
+}
+
+static void heap_sift_down(heap_t *h, size_t i) {
+  const key_t key = h->keys[i];
+  while (2 * i + 1 < h->n) {
+    size_t c = 2 * i + 1;
+    if (c + 1 < h->n && h->keys[c + 1] < h->keys[c]) {
+      c++;
+    }
+    if (h->keys[c] >= key) {
+      break;
+    }
+    h->keys[i] = h->keys[c];
+    i = c;
+  }
+  h->keys[i] = key;
+}
+
+static void heap_push(heap_t *h, const key_t key) {
+  h->keys[h->n] = key;
+  heap_sift_up(h, h->n++);
+}
+
+// removes keys[i]: the last key fills the hole and moves whichever way fits
+static key_t heap_remove_at(heap_t *h, const size_t i) {
+  const key_t key = h->keys[i];
+  h->keys[i] = h->keys[--h->n];
+  if (i < h->n) {
+    heap_sift_down(h, i);
+    heap_sift_up(h, i);
+  }
+  return key;
+}
+
+typedef enum { QUEUE_HEAP, QUEUE_ERASE_MIN, QUEUE_POP_MIN } queue_t;
+
+static const char *queue_names[] = {"heap", "erase-min", "pop-min"};
+
+// timer delays: uniform, or mostly short with a tail of long timeouts (the
+// mix a timer wheel is built for)
+static key_t next_delay(const int bimodal, uint64_t *seed) {
+  const uint64_t x = bench_rand(seed);
+  if (!bimodal) {
+    return (key_t)(1 + x % 65536);
+  }
+  return (key_t)((x & 15) < 14 ? 1 + (x >> 8) % 256 : 65536 + (x >> 8) % 983040);
+}
+
+// the hold model: n timers pending; each step fires the earliest (now moves
+// to its expiry) and arms a new one at now + delay. With cancel, one step in
+// four instead cancels a random pending timer and re-arms it (mod_timer).
+static void run(const queue_t q, const int bimodal, const int cancel,
+                const size_t n) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  const size_t steps = 4 * n;
+  heap_t h = {malloc(n * sizeof(key_t)), 0};
+  rbtree *t = new_rbtree();
+  key_t now = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    const key_t expiry = next_delay(bimodal, &seed);
+    if (q == QUEUE_HEAP) {
+      heap_push(&h, expiry);
+    } else {
+      rbtree_insert(t, expiry);
+    }
+  }
+
+  const uint64_t start = now_ns();
+  for (size_t i = 0; i < steps; i++) {
+    const uint64_t x = bench_rand(&seed);
+    const int is_cancel = cancel && (x & 3) == 0;
+    const size_t victim = (size_t)(x >> 8) % n;
+    key_t key;
+    if (q == QUEUE_HEAP) {
+      key = heap_remove_at(&h, is_cancel ? victim : 0);
+    } else if (is_cancel) {
+      node_t *p = rbtree_select(t, victim);
+      key = p->key;
+      rbtree_erase(t, p);
+    } else if (q == QUEUE_ERASE_MIN) {
+      node_t *p = rbtree_min(t);
+      key = p->key;
+      rbtree_erase(t, p);
+    } else {
+      rbtree_pop_min(t, &key);
+    }
+    if (!is_cancel) {
+      now = key;
+    }
+
+    const key_t expiry = now + next_delay(bimodal, &seed);
+    if (q == QUEUE_HEAP) {
+      heap_push(&h, expiry);
+    } else {
+      rbtree_insert(t, expiry);
+    }
+  }
+  const uint64_t ns = now_ns() - start;
+
+  char op[64];
+  snprintf(op, sizeof(op), "%s%s", bimodal ? "bimodal" : "uniform",
+           cancel ? "+cancel" : "");
+  bench_report(queue_names[q], op, steps, ns);
+  sink += (size_t)now;
+  free(h.keys);
+  delete_rbtree(t);
+}
+
+// fill with n random expiries, then fire them all in order
+static void drain(const queue_t q, const size_t n) {
+  uint64_t seed = 0x2545f4914f6cdd1dull;
+  heap_t h = {malloc(n * sizeof(key_t)), 0};
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    const key_t expiry = (key_t)(bench_rand(&seed) % 1000000000);
+    if (q == QUEUE_HEAP) {
+      heap_push(&h, expiry);
+    } else {
+      rbtree_insert(t, expiry);
+    }
+  }
+
+  key_t key, last = 0;
+  const uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    if (q == QUEUE_HEAP) {
+      key = heap_remove_at(&h, 0);
+    } else if (q == QUEUE_ERASE_MIN) {
+      node_t *p = rbtree_min(t);
+      key = p->key;
+      rbtree_erase(t, p);
+    } else {
+      rbtree_pop_min(t, &key);
+    }
+    sink += key < last;
+    last = key;
+  }
+  bench_report(queue_names[q], "drain", n, now_ns() - start);
+  free(h.keys);
+  delete_rbtree(t);
+}
+
+// a binary heap against the tree popping its cached min, either through
+// rbtree_erase or rbtree_pop_min: a plain drain, then timer-queue workloads
+// (one step = pop or cancel + insert)
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  for (queue_t q = QUEUE_HEAP; q <= QUEUE_POP_MIN; q++) {
+    drain(q, n);
+  }
+  for (int cancel = 0; cancel < 2; cancel++) {
+    for (int bimodal = 0; bimodal < 2; bimodal++) {
+      for (queue_t q = QUEUE_HEAP; q <= QUEUE_POP_MIN; q++) {
+        run(q, bimodal, cancel, n);
+      }
+    }
+  }
+  return 0;
+}
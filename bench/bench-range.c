@@ -0,0 +1,52 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+// expire a window of k keys repeatedly: lower_bound + erase per key vs one
+// rbtree_erase_range, from a tree of n keys 0..n-1 refilled between rounds
+static void run(const size_t n, const size_t k) {
+  const size_t rounds = n / k < 200 ? n / k : 200;
+  char op[64];
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  uint64_t one_by_one = 0, ranged = 0;
+
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)i);
+  }
+  for (size_t r = 0; r < rounds; r++) {
+    const key_t lo = (key_t)(bench_rand(&seed) % (n - k + 1));
+    const key_t hi = lo + (key_t)k;
+
+    uint64_t start = now_ns();
+    node_t *p;
+    while ((p = rbtree_lower_bound(t, lo)) != NULL && p->key < hi) {
+      rbtree_erase(t, p);
+    }
+    one_by_one += now_ns() - start;
+    for (key_t key = lo; key < hi; key++) {
+      rbtree_insert(t, key);
+    }
+
+    start = now_ns();
+    rbtree_erase_range(t, lo, hi);
+    ranged += now_ns() - start;
+    for (key_t key = lo; key < hi; key++) {
+      rbtree_insert(t, key);
+    }
+  }
+  delete_rbtree(t);
+
+  snprintf(op, sizeof(op), "erase loop k=%zu", k);
+  bench_report("rbtree", op, rounds * k, one_by_one);
+  snprintf(op, sizeof(op), "erase_range k=%zu", k);
+  bench_report("rbtree", op, rounds * k, ranged);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  for (size_t k = 1; k <= n / 10; k *= 10) {
+    run(n, k);
+  }
+  return 0;
+}
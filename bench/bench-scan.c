@@ -0,0 +1,84 @@
+#include <fcntl.h>
+#include <rbtree.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+// the max node found by walking the right spine, as rbtree_max did before
+// the tree cached its ends
+static node_t *walk_max(const rbtree *t) {
+  node_t *p = t->root;
+  while (p != t->nil && p->right != t->nil) {
+    p = p->right;
+  }
+  return p;
+}
+
+// the successor lookup rbtree_to_array used before the iterator API: it
+// re-derived the max node on every step to detect the end of the walk
+static node_t *successor_with_max_check(const rbtree *t, node_t *p) {
+  if (p == walk_max(t)) {
+    return t->nil;
+  }
+  if (p->right != t->nil) {
+    p = p->right;
+    while (p->left != t->nil) {
+      p = p->left;
+    }
+    return p;
+  }
+  while (p->parent->left != p) {
+    p = p->parent;
+  }
+  return p->parent;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 10000000);
+  uint64_t seed = 0x2545f4914f6cdd1dull;
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)bench_rand(&seed));
+  }
+  key_t *arr = malloc(n * sizeof(key_t));
+
+  uint64_t start = now_ns();
+  size_t i = 0;
+  for (node_t *p = rbtree_min(t); p != t->nil && i < n;
+       p = successor_with_max_check(t, p)) {
+    arr[i++] = p->key;
+  }
+  bench_report("rbtree", "scan max-check", n, now_ns() - start);
+
+  start = now_ns();
+  i = 0;
+  for (node_t *p = rbtree_iter_begin(t); p != rbtree_iter_end(t);
+       p = rbtree_iter_next(t, p)) {
+    arr[i++] = p->key;
+  }
+  bench_report("rbtree", "scan iterator", n, now_ns() - start);
+
+  start = now_ns();
+  rbtree_to_array(t, arr, n);
+  bench_report("rbtree", "rbtree_to_array", n, now_ns() - start);
+
+  // bounded-memory export: 4096-key chunks through a cursor, and the whole
+  // tree streamed to /dev/null
+  key_t chunk[4096];
+  rbtree_cursor_t cursor;
+  start = now_ns();
+  rbtree_cursor_begin(t, &cursor);
+  while (rbtree_cursor_read(t, &cursor, chunk, 4096) > 0) {
+  }
+  bench_report("rbtree", "cursor 4096-key chunks", n, now_ns() - start);
+
+  const int fd = open("/dev/null", O_WRONLY);
+  start = now_ns();
+  rbtree_write_fd(t, fd);
+  bench_report("rbtree", "write_fd /dev/null", n, now_ns() - start);
+  close(fd);
+
+  free(arr);
+  delete_rbtree(t);
+  return 0;
+}
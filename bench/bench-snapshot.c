@@ -0,0 +1,62 @@
+#include <rbtree_snapshot.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+// startup cost of getting n keys back: rebuild with inserts, load a snapshot
+// into a tree, or open it read-only and answer queries from the mapping. The
+// file was just written, so these are page-cache (warm) numbers.
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  const size_t queries = 1000;
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)bench_rand(&seed);
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/bench-snapshot.%ld", (long)getpid());
+
+  uint64_t start = now_ns();
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report("rbtree", "insert loop", n, now_ns() - start);
+
+  start = now_ns();
+  if (rbtree_save(t, path) != 0) {
+    perror("rbtree_save");
+    return 1;
+  }
+  bench_report("snapshot", "save", n, now_ns() - start);
+  delete_rbtree(t);
+
+  start = now_ns();
+  t = rbtree_load(path);
+  bench_report("snapshot", "load", n, now_ns() - start);
+  delete_rbtree(t);
+
+  // per key of the file: open checks the whole checksum once
+  start = now_ns();
+  rbtree_snapshot_t *s = rbtree_snapshot_open(path);
+  bench_report("snapshot", "open", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    sink += rbtree_snapshot_find(s, keys[i]) != NULL;
+  }
+  bench_report("snapshot", "find on mapping", queries, now_ns() - start);
+
+  start = now_ns();
+  t = rbtree_snapshot_thaw(s);
+  bench_report("snapshot", "thaw", n, now_ns() - start);
+  rbtree_snapshot_close(s);
+  delete_rbtree(t);
+
+  unlink(path);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <rbtree.h>
+
+#include "bench.h"
+
+static rbtree *random_tree(const size_t n, uint64_t *seed) {
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(seed) >> 33));
+  }
+  return t;
+}
+
+// re-sharding by key range: split + join vs copying through to_array
+static void run_split_join(const size_t n, uint64_t *seed) {
+  const int rounds = 1000;
+  rbtree *t = random_tree(n, seed);
+
+  uint64_t start = now_ns();
+  for (int i = 0; i < rounds; i++) {
+    const key_t key = (key_t)(bench_rand(seed) >> 33);
+    rbtree *lo, *hi;
+    rbtree_split(t, key, &lo, &hi);
+    t = rbtree_join(lo, key, hi);
+  }
+  bench_report("rbtree", "split + join", rounds, now_ns() - start);
+  delete_rbtree(t);
+
+  // the old way, once: copy out and insert both halves again
+  t = random_tree(n, seed);
+  key_t *arr = malloc(n * sizeof(key_t));
+  start = now_ns();
+  rbtree_to_array(t, arr, n);
+  rbtree *lo = new_rbtree(), *hi = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(i < n / 2 ? lo : hi, arr[i]);
+  }
+  bench_report("rbtree", "to_array + insert split", 1, now_ns() - start);
+  free(arr);
+  delete_rbtree(lo);
+  delete_rbtree(hi);
+  delete_rbtree(t);
+}
+
+// n keys in [0, 2^30), plus 2^30 if upper
+static rbtree *half_tree(const size_t n, const int upper, uint64_t *seed) {
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)((bench_rand(seed) >> 34) + (upper ? 1u << 30 : 0)));
+  }
+  return t;
+}
+
+// join of two trees built on their own pools: merging a pool no other tree
+// uses, against the copying fallback when both pools have another tree on
+// them (the smaller side's n / 2 keys are rebuilt)
+static void run_cross_pool_join(const size_t n, uint64_t *seed) {
+  const int rounds = 10;
+  uint64_t merge_ns = 0, copy_ns = 0;
+  for (int i = 0; i < rounds; i++) {
+    rbtree *lo = half_tree(n / 2, 0, seed), *hi = half_tree(n / 2, 1, seed);
+    uint64_t start = now_ns();
+    rbtree *t = rbtree_join(lo, 1 << 30, hi);
+    merge_ns += now_ns() - start;
+    delete_rbtree(t);
+
+    lo = half_tree(n / 2, 0, seed);
+    hi = half_tree(n / 2, 1, seed);
+    rbtree *lo_other = new_rbtree_shared(lo), *hi_other = new_rbtree_shared(hi);
+    start = now_ns();
+    t = rbtree_join(lo, 1 << 30, hi);
+    copy_ns += now_ns() - start;
+    delete_rbtree(t);
+    delete_rbtree(lo_other);
+    delete_rbtree(hi_other);
+  }
+  bench_report("rbtree", "join, pool merged", rounds, merge_ns);
+  bench_report("rbtree", "join, pools shared", rounds, copy_ns);
+}
+
+// union of a large tree with trees of m keys: O(m log(n / m + 1)) vs m inserts
+static void run_union(const size_t n, uint64_t *seed) {
+  char op[64];
+  for (size_t m = 16; m <= n; m *= 16) {
+    rbtree *large = random_tree(n, seed);
+    rbtree *small = new_rbtree_shared(large);
+    for (size_t i = 0; i < m; i++) {
+      rbtree_insert(small, (key_t)(bench_rand(seed) >> 33));
+    }
+    uint64_t start = now_ns();
+    large = rbtree_union(large, small);
+    snprintf(op, sizeof(op), "union m=%zu", m);
+    bench_report("rbtree", op, 1, now_ns() - start);
+
+    key_t *arr = malloc(m * sizeof(key_t));
+    for (size_t i = 0; i < m; i++) {
+      arr[i] = (key_t)(bench_rand(seed) >> 33);
+    }
+    start = now_ns();
+    for (size_t i = 0; i < m; i++) {
+      rbtree_insert(large, arr[i]);
+    }
+    snprintf(op, sizeof(op), "insert loop m=%zu", m);
+    bench_report("rbtree", op, 1, now_ns() - start);
+    free(arr);
+    delete_rbtree(large);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  run_split_join(n, &seed);
+  run_cross_pool_join(n, &seed);
+  run_union(n, &seed);
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include <rbtree.h>
+#include <rbtree_wide.h>
+
+#include "bench.h"
+
+static volatile size_t sink;
+
+// even keys below 2^30, so odd probes always miss
+static void fill_keys(key_t *keys, const size_t n) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)((bench_rand(&seed) >> 35) << 1);
+  }
+}
+
+// find-heavy: n random finds, half of them misses. mixed: one insert and one
+// erase for every two finds, keeping the size at n.
+int main(int argc, char *argv[]) {
+  const size_t n = bench_size(argc, argv, 1000000);
+  const size_t ops = 1000000;
+  const char *wide = wide_rbtree_engine();
+  uint64_t seed = 0x2545f4914f6cdd1dull;
+  key_t *keys = malloc(n * sizeof(key_t));
+  fill_keys(keys, n);
+  key_t *probes = malloc(ops * sizeof(key_t));
+  for (size_t i = 0; i < ops; i++) {
+    probes[i] = keys[bench_rand(&seed) % n] | (key_t)(i & 1);
+  }
+  key_t *arr = malloc(n * sizeof(key_t));
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  bench_report("rbtree", "insert", n, now_ns() - start);
+  wide_rbtree *w = new_wide_rbtree();
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    wide_rbtree_insert(w, keys[i]);
+  }
+  bench_report(wide, "insert", n, now_ns() - start);
+
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    sink += rbtree_find(t, probes[i]) != NULL;
+  }
+  bench_report("rbtree", "find", ops, now_ns() - start);
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    sink += wide_rbtree_find(w, probes[i]) != NULL;
+  }
+  bench_report(wide, "find", ops, now_ns() - start);
+
+  start = now_ns();
+  rbtree_to_array(t, arr, n);
+  bench_report("rbtree", "to_array", n, now_ns() - start);
+  start = now_ns();
+  wide_rbtree_to_array(w, arr, n);
+  bench_report(wide, "to_array", n, now_ns() - start);
+
+  // keys[i] leaves and an even probe takes its place, so erases always hit
+  start = now_ns();
+  for (size_t i = 0; i < ops; i += 4) {
+    sink += rbtree_find(t, probes[i]) != NULL;
+    sink += rbtree_find(t, probes[i + 1]) != NULL;
+    rbtree_erase(t, rbtree_find(t, keys[i % n]));
+    rbtree_insert(t, probes[i + 2]);
+    keys[i % n] = probes[i + 2];
+  }
+  bench_report("rbtree", "mixed", ops, now_ns() - start);
+  fill_keys(keys, n);
+  start = now_ns();
+  for (size_t i = 0; i < ops; i += 4) {
+    sink += wide_rbtree_find(w, probes[i]) != NULL;
+    sink += wide_rbtree_find(w, probes[i + 1]) != NULL;
+    wide_rbtree_erase(w, keys[i % n]);
+    wide_rbtree_insert(w, probes[i + 2]);
+    keys[i % n] = probes[i + 2];
+  }
+  bench_report(wide, "mixed", ops, now_ns() - start);
+
+  printf("%-10s %-24s n=%-10zu %10.1f bytes/key\n", wide, "memory", n,
+         (double)wide_rbtree_memory(w) / (double)n);
+
+  delete_wide_rbtree(w);
+  delete_rbtree(t);
+  free(arr);
+  free(probes);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64: fast, reproducible keys independent of libc rand()
+static inline uint64_t bench_rand(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+static inline size_t bench_size(int argc, char *argv[], size_t def) {
+  return argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : def;
+}
+
+static inline void bench_report(const char *variant, const char *op,
+                                size_t n, uint64_t ns) {
+  printf("%-10s %-24s n=%-10zu %10.1f ns/op\n", variant, op, n,
+         n ? (double)ns / (double)n : 0.0);
+}
+
+#endif  // _BENCH_H_
@@ -1,5 +1,493 @@
 #include "rbtree.h"
 
+#include <bench.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Benchmark driver: runs every public operation over configurable sizes and
+// key distributions for the rbtree (plain and counted) and for a sorted-array
+// baseline, and prints one CSV row per (impl, op, dist, n).
+//
+//   driver [-n 1000,100000] [-d random,sorted,reverse,dup]
+//          [-i rbtree,counted,array]
+//
+// Latency percentiles come from batches of LAT_BATCH ops (timer overhead
+// would dominate single ops). Each (impl, dist, n) runs in a forked child so
+// peak_rss_kb is that run's own high-water mark. A run's rows are printed only
+// if its child exits with status 0; otherwise the driver reports the run on
+// stderr and exits non-zero once every run is done.
+//
+// Built with -DRBTREE_STATS (make -C ../bench suite-stats) every row also
+// gets the tree's counters for that op, per op, and the max insert depth.
+
+#define LAT_BATCH 8
+#define MAX_ROWS 16
+#define ARRAY_MAX_SLOW_OPS 20000  // cap for the baseline's O(n) insert/erase
+#define DUP_DISTINCT 64
+
+typedef struct {
+  const char *op;
+  size_t ops;
+  double ns_per_op, p50, p90, p99;
+#ifdef RBTREE_STATS
+  rbtree_stats_t stats;
+#endif
+} row_t;
+
+typedef struct {
+  const char *impl, *dist;
+  size_t n;
+  key_t *keys;   // keys in insertion order
+  key_t *probe;  // the same keys in random order
+  uint64_t seed;
+  row_t rows[MAX_ROWS];
+  int nrows;
+  // latency samples of the op being measured
+  double *samples;
+  size_t nsamples;
+#ifdef RBTREE_STATS
+  rbtree *tree;  // counters are reset per op (NULL for the array baseline)
+#endif
+} run_t;
+
+static int comp_key(const void *p1, const void *p2) {
+  const key_t k1 = *(const key_t *)p1, k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+static int comp_double(const void *p1, const void *p2) {
+  const double d1 = *(const double *)p1, d2 = *(const double *)p2;
+  return (d1 > d2) - (d1 < d2);
+}
+
+static void make_keys(run_t *r) {
+  const size_t n = r->n;
+  for (size_t i = 0; i < n; i++) {
+    if (strcmp(r->dist, "sorted") == 0) {
+      r->keys[i] = (key_t)i;
+    } else if (strcmp(r->dist, "reverse") == 0) {
+      r->keys[i] = (key_t)(n - i);
+    } else if (strcmp(r->dist, "dup") == 0) {
+      r->keys[i] = (key_t)(bench_rand(&r->seed) % DUP_DISTINCT);
+    } else {
+      r->keys[i] = (key_t)bench_rand(&r->seed);
+    }
+    r->probe[i] = r->keys[i];
+  }
+  for (size_t i = n; i > 1; i--) {
+    const size_t j = bench_rand(&r->seed) % i;
+    const key_t tmp = r->probe[i - 1];
+    r->probe[i - 1] = r->probe[j];
+    r->probe[j] = tmp;
+  }
+}
+
+// Measurement: begin_op, then sample() after every op, then end_op.
+static uint64_t op_start, batch_start;
+static size_t batch_ops;
+
+static void begin_op(run_t *r) {
+#ifdef RBTREE_STATS
+  if (r->tree != NULL) {
+    rbtree_stats_reset(r->tree);
+  }
+#endif
+  r->nsamples = 0;
+  batch_ops = 0;
+  op_start = batch_start = now_ns();
+}
+
+static inline void sample(run_t *r) {
+  if (++batch_ops < LAT_BATCH) {
+    return;
+  }
+  const uint64_t t = now_ns();
+  r->samples[r->nsamples++] = (double)(t - batch_start) / LAT_BATCH;
+  batch_start = t;
+  batch_ops = 0;
+}
+
+static void end_op(run_t *r, const char *op, size_t ops) {
+  const uint64_t total = now_ns() - op_start;
+  row_t *row = &r->rows[r->nrows++];
+  row->op = op;
+  row->ops = ops;
+  row->ns_per_op = ops ? (double)total / (double)ops : 0.0;
+  row->p50 = row->p90 = row->p99 = row->ns_per_op;
+  if (r->nsamples > 0) {
+    qsort(r->samples, r->nsamples, sizeof(double), comp_double);
+    row->p50 = r->samples[r->nsamples * 50 / 100];
+    row->p90 = r->samples[r->nsamples * 90 / 100];
+    row->p99 = r->samples[r->nsamples * 99 / 100];
+  }
+#ifdef RBTREE_STATS
+  memset(&row->stats, 0, sizeof(row->stats));
+  if (r->tree != NULL) {
+    row->stats = r->tree->stats;
+  }
+#endif
+}
+
+static volatile size_t sink;
+
+static void bench_rbtree(run_t *r) {
+  const size_t n = r->n;
+  rbtree *t = strcmp(r->impl, "counted") == 0 ? new_rbtree_counted() : new_rbtree();
+#ifdef RBTREE_STATS
+  r->tree = t;
+#endif
+
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, r->keys[i]);
+    sample(r);
+  }
+  end_op(r, "insert", n);
+
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    sink += rbtree_find(t, r->probe[i]) != NULL;
+    sample(r);
+  }
+  end_op(r, "find", n);
+
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    sink += (size_t)(i % 2 ? rbtree_max(t) : rbtree_min(t));
+    sample(r);
+  }
+  end_op(r, "min_max", n);
+
+  key_t *arr = malloc(n * sizeof(key_t));
+  begin_op(r);
+  rbtree_to_array(t, arr, n);
+  end_op(r, "to_array", n);
+  sink += (size_t)arr[n / 2];
+  free(arr);
+
+  // steady-state mix: 50% find, 25% insert, 25% find + erase
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t x = bench_rand(&r->seed);
+    const key_t key = r->probe[x % n];
+    if (x & 2) {
+      sink += rbtree_find(t, key) != NULL;
+    } else if (x & 1) {
+      rbtree_insert(t, key);
+    } else {
+      node_t *p = rbtree_find(t, key);
+      if (p != NULL) {
+        rbtree_erase(t, p);
+      }
+    }
+    sample(r);
+  }
+  end_op(r, "mixed", n);
+
+  begin_op(r);
+  size_t erased = 0;
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find(t, r->probe[i]);
+    if (p != NULL) {
+      rbtree_erase(t, p);
+      erased++;
+    }
+    sample(r);
+  }
+  end_op(r, "find_erase", n);
+  sink += erased;
+
+  // refill, then pop n keys from the cached min as a priority queue would
+  // (the mixed phase leaves extra keys, so the tree holds more than n)
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, r->keys[i]);
+  }
+  begin_op(r);
+  size_t popped = 0;
+  key_t key;
+  while (popped < n && rbtree_pop_min(t, &key) == 0) {
+    sink += (size_t)key;
+    popped++;
+    sample(r);
+  }
+  end_op(r, "pop_min", popped);
+
+#ifdef RBTREE_STATS
+  r->tree = NULL;
+#endif
+  delete_rbtree(t);
+}
+
+// Baseline: a sorted array with binary search.
+static size_t lower_bound_array(const key_t *a, size_t len, key_t key) {
+  size_t lo = 0, hi = len;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static void insert_array(key_t *a, size_t *len, key_t key) {
+  const size_t pos = lower_bound_array(a, *len, key);
+  memmove(a + pos + 1, a + pos, (*len - pos) * sizeof(key_t));
+  a[pos] = key;
+  (*len)++;
+}
+
+static int erase_array(key_t *a, size_t *len, key_t key) {
+  const size_t pos = lower_bound_array(a, *len, key);
+  if (pos == *len || a[pos] != key) {
+    return 0;
+  }
+  memmove(a + pos, a + pos + 1, (*len - pos - 1) * sizeof(key_t));
+  (*len)--;
+  return 1;
+}
+
+static void bench_array(run_t *r) {
+  const size_t n = r->n;
+  const size_t slow = n < ARRAY_MAX_SLOW_OPS ? n : ARRAY_MAX_SLOW_OPS;
+  key_t *a = malloc((n + slow + 1) * sizeof(key_t));
+  size_t len = 0;
+
+  // one insert at a time is O(n) per key, so only the first slow keys go in
+  // that way and the rest are appended and sorted
+  begin_op(r);
+  for (size_t i = 0; i < slow; i++) {
+    insert_array(a, &len, r->keys[i]);
+    sample(r);
+  }
+  end_op(r, "insert", slow);
+
+  begin_op(r);
+  memcpy(a + len, r->keys + slow, (n - slow) * sizeof(key_t));
+  len = n;
+  qsort(a, len, sizeof(key_t), comp_key);
+  end_op(r, "build_sort", n);
+
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    const size_t pos = lower_bound_array(a, len, r->probe[i]);
+    sink += pos < len && a[pos] == r->probe[i];
+    sample(r);
+  }
+  end_op(r, "find", n);
+
+  begin_op(r);
+  for (size_t i = 0; i < n; i++) {
+    sink += (size_t)(i % 2 ? a[len - 1] : a[0]);
+    sample(r);
+  }
+  end_op(r, "min_max", n);
+
+  key_t *arr = malloc(n * sizeof(key_t));
+  begin_op(r);
+  memcpy(arr, a, n * sizeof(key_t));
+  end_op(r, "to_array", n);
+  sink += (size_t)arr[n / 2];
+  free(arr);
+
+  begin_op(r);
+  for (size_t i = 0; i < slow; i++) {
+    const uint64_t x = bench_rand(&r->seed);
+    const key_t key = r->probe[x % n];
+    if (x & 2) {
+      const size_t pos = lower_bound_array(a, len, key);
+      sink += pos < len && a[pos] == key;
+    } else if (x & 1) {
+      insert_array(a, &len, key);
+    } else {
+      erase_array(a, &len, key);
+    }
+    sample(r);
+  }
+  end_op(r, "mixed", slow);
+
+  begin_op(r);
+  for (size_t i = 0; i < slow; i++) {
+    sink += erase_array(a, &len, r->probe[i]);
+    sample(r);
+  }
+  end_op(r, "find_erase", slow);
+
+  free(a);
+}
+
+static void run_child(run_t *r) {
+  r->keys = malloc(r->n * sizeof(key_t));
+  r->probe = malloc(r->n * sizeof(key_t));
+  r->samples = malloc((r->n / LAT_BATCH + 1) * sizeof(double));
+  make_keys(r);
+  if (strcmp(r->impl, "array") == 0) {
+    bench_array(r);
+  } else {
+    bench_rbtree(r);
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  for (int i = 0; i < r->nrows; i++) {
+    const row_t *row = &r->rows[i];
+    printf("%s,%s,%s,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%ld", r->impl, row->op,
+           r->dist, r->n, row->ops, row->ns_per_op, row->p50, row->p90,
+           row->p99, usage.ru_maxrss);
+#ifdef RBTREE_STATS
+    const rbtree_stats_t *st = &row->stats;
+    const double ops = row->ops ? (double)row->ops : 1.0;
+    printf(",%.2f,%.3f,%.3f,%.3f,%.3f,%zu", (double)st->comparisons / ops,
+           (double)st->rotations / ops, (double)st->recolors / ops,
+           (double)(st->insert_fixup[0] + st->insert_fixup[1] +
+                    st->insert_fixup[2]) / ops,
+           (double)(st->erase_fixup[0] + st->erase_fixup[1] +
+                    st->erase_fixup[2] + st->erase_fixup[3]) / ops,
+           st->max_height);
+#endif
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+// runs r in a forked child with its stdout on a pipe, and copies the child's
+// rows to stdout only if it exited cleanly; -1 if it could not run or failed
+static int run_forked(run_t *r) {
+  int fds[2];
+  if (pipe(fds) < 0) {
+    perror("pipe");
+    return -1;
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    run_child(r);
+    exit(0);
+  }
+
+  close(fds[1]);
+  size_t len = 0, cap = 4096;
+  char *out = malloc(cap);
+  ssize_t got;
+  while ((got = read(fds[0], out + len, cap - len)) > 0) {
+    len += (size_t)got;
+    if (len == cap) {
+      out = realloc(out, cap *= 2);
+    }
+  }
+  close(fds[0]);
+
+  int status;
+  const int ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+                 WEXITSTATUS(status) == 0;
+  if (ok) {
+    fwrite(out, 1, len, stdout);
+    fflush(stdout);
+  } else {
+    fprintf(stderr, "%s %s n=%zu failed, no rows recorded\n", r->impl,
+            r->dist, r->n);
+  }
+  free(out);
+  return ok ? 0 : -1;
+}
+
+// splits a comma-separated option value in place
+static int split(char *s, char **out, int max) {
+  int count = 0;
+  for (char *tok = strtok(s, ","); tok != NULL && count < max;
+       tok = strtok(NULL, ",")) {
+    out[count++] = tok;
+  }
+  return count;
+}
+
+// 1 if name is in the NULL-terminated list
+static int is_known(const char *name, const char *const *known) {
+  for (; *known != NULL; known++) {
+    if (strcmp(name, *known) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static const char *const known_impls[] = {"rbtree", "counted", "array", NULL};
+static const char *const known_dists[] = {"random", "sorted", "reverse", "dup",
+                                          NULL};
+
+static int usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-n sizes] [-d dists] [-i impls]\n"
+          "  dists: random,sorted,reverse,dup\n"
+          "  impls: rbtree,counted,array\n",
+          prog);
+  return 1;
+}
+
 int main(int argc, char *argv[]) {
+  char sizes_opt[256] = "1000,100000,1000000";
+  char dists_opt[256] = "random,sorted,reverse,dup";
+  char impls_opt[256] = "rbtree,counted,array";
+  int opt;
+  while ((opt = getopt(argc, argv, "n:d:i:")) != -1) {
+    if (opt == '?') {
+      return usage(argv[0]);
+    }
+    char *dst = opt == 'n' ? sizes_opt : opt == 'd' ? dists_opt : impls_opt;
+    snprintf(dst, sizeof(sizes_opt), "%s", optarg);
+  }
+
+  char *sizes[16], *dists[8], *impls[4];
+  const int nsizes = split(sizes_opt, sizes, 16);
+  const int ndists = split(dists_opt, dists, 8);
+  const int nimpls = split(impls_opt, impls, 4);
+  for (int i = 0; i < nimpls; i++) {
+    if (!is_known(impls[i], known_impls)) {
+      fprintf(stderr, "%s: unknown impl '%s'\n", argv[0], impls[i]);
+      return usage(argv[0]);
+    }
+  }
+  for (int d = 0; d < ndists; d++) {
+    if (!is_known(dists[d], known_dists)) {
+      fprintf(stderr, "%s: unknown dist '%s'\n", argv[0], dists[d]);
+      return usage(argv[0]);
+    }
+  }
 
-}
\ No newline at end of file
+  printf("impl,op,dist,n,ops,ns_per_op,p50_ns,p90_ns,p99_ns,peak_rss_kb");
+#ifdef RBTREE_STATS
+  printf(",cmp_per_op,rot_per_op,recolor_per_op,insert_fixup_per_op,"
+         "erase_fixup_per_op,max_height");
+#endif
+  printf("\n");
+  fflush(stdout);
+  int failed = 0;
+  for (int s = 0; s < nsizes; s++) {
+    for (int d = 0; d < ndists; d++) {
+      for (int i = 0; i < nimpls; i++) {
+        run_t r = {.impl = impls[i], .dist = dists[d],
+                   .n = strtoull(sizes[s], NULL, 10),
+                   .seed = 0x9e3779b97f4a7c15ull};
+        if (r.n == 0) {
+          continue;
+        }
+        if (run_forked(&r) < 0) {
+          failed = 1;
+        }
+      }
+    }
+  }
+  return failed;
+}
@@ -1,397 +1,1605 @@
 #include "rbtree.h"
 
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+// -DRBTREE_STATS일 때만 tree->stats를 세고, 아니면 아무 코드도 만들지 않는다
+// (find처럼 const tree를 받는 함수에서도 세므로 const를 뗀다)
+#ifdef RBTREE_STATS
+#define STAT_ADD(tree, field, n) (((rbtree *)(tree))->stats.field += (n))
+#define STAT_DEPTH(tree, p) stats_note_depth(tree, p)
+#else
+#define STAT_ADD(tree, field, n) ((void)0)
+#define STAT_DEPTH(tree, p) ((void)0)
+#endif
+
+// -DRBTREE_MT_ATOMIC으로 빌드하면 lock 없는 reader(rbtree_mt.c)가 따라가는 link와
+// root, 끝 node cache를 release store로 써서 reader가 완성된 node만 보게 한다
+#ifdef RBTREE_MT_ATOMIC
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#else
+#define STORE(x, v) ((x) = (v))
+#endif
+
+// slab chunk 하나에 들어가는 node 개수
+#ifndef RBTREE_CHUNK_NODES
+#define RBTREE_CHUNK_NODES 512
+#endif
+
+// 모든 tree가 같이 쓰는 sentinel. 어느 tree의 node든 같은 nil을 가리키므로 pool이 다른
+// tree끼리도 node를 그대로 옮길 수 있다. 여러 thread의 tree가 공유하므로 절대 쓰지 않으며,
+// 읽기 전용 영역에 두어 실수로 쓰면 바로 crash가 나게 한다
+static const node_t shared_nil = {.color = RBTREE_BLACK};
 
 rbtree *new_rbtree(void)
 {
+  rbtree_pool_t *pool = (rbtree_pool_t *)calloc(1, sizeof(rbtree_pool_t));
+  pool->refs = 1;
+
   rbtree *tree = (rbtree *)calloc(1, sizeof(rbtree));
-  node_t *nil = (node_t *)calloc(1, sizeof(node_t));
-  nil->color = RBTREE_BLACK;
-  tree->nil = nil;
-  tree->root = nil;
+  tree->pool = pool;
+  tree->nil = (node_t *)&shared_nil;
+  tree->root = tree->nil;
+  tree->leftmost = tree->rightmost = tree->nil;
 
   return tree;
 }
 
+rbtree *new_rbtree_counted(void)
+{
+  rbtree *tree = new_rbtree();
+  tree->counted = 1;
+  return tree;
+}
+
+rbtree *new_rbtree_shared(rbtree *other)
+{
+  rbtree *tree = (rbtree *)calloc(1, sizeof(rbtree));
+  tree->pool = other->pool;
+  tree->pool->refs++;
+  tree->nil = other->nil;
+  tree->root = tree->nil;
+  tree->leftmost = tree->rightmost = tree->nil;
+  tree->counted = other->counted;
+
+  return tree;
+}
+
+// p가 subtree size에 더하는 개수 (insert_hint가 아직 size에 넣지 않은 node는 0)
+size_t node_weight(const node_t *p)
+{
+  return p->size - p->left->size - p->right->size;
+}
+
+size_t rbtree_node_count(const node_t *p)
+{
+  // counted mode의 node는 1개 이상이므로 0은 아직 size에 넣지 않은 plain node다
+  const size_t count = node_weight(p);
+  return (count != 0) ? count : 1;
+}
+
 // 현재 노드가 부모 노드의 왼쪽 자식인지 판별하는 함수
 int is_node_left(node_t *p)
 {
   return (p->parent->left == p);
 }
 
-// 두 노드의 color를 바꿔주는 함수
-void exchange_color(node_t *p1, node_t *p2)
+// capacity개의 node를 담는 chunk를 새로 할당해 chunk list 앞에 붙이는 함수
+// lock 없이 읽는 reader(rbtree_mt.c)가 초기화 중인 node에서 쓰레기 pointer를
+// 읽지 않도록 0으로 채워서 할당한다
+node_chunk_t *new_chunk(rbtree *tree, size_t capacity)
 {
-  int tmp_color = p1->color;
-  p1->color = p2->color;
-  p2->color = (tmp_color == RBTREE_BLACK) ? RBTREE_BLACK : RBTREE_RED;
+  node_chunk_t *chunk = (node_chunk_t *)calloc(1, sizeof(node_chunk_t) + capacity * sizeof(node_t));
+  chunk->capacity = capacity;
+  chunk->used = 0;
+  chunk->next = tree->pool->chunks;
+  if (chunk->next == NULL)
+    tree->pool->last_chunk = chunk;
+  tree->pool->chunks = chunk;
+  return chunk;
 }
 
-// node의 메모리를 해제하는 함수
-void node_is_free(rbtree *tree, node_t *p)
+// free list에서 꺼내거나 현재 chunk에서 잘라 node 하나를 할당하는 함수
+node_t *alloc_node(rbtree *tree)
 {
-  if (p->left != tree->nil)
-    node_is_free(tree, p->left);
-  if (p->right != tree->nil)
-    node_is_free(tree, p->right);
+#ifdef RBTREE_MALLOC_NODES
+  (void)tree;
+  return (node_t *)malloc(sizeof(node_t));
+#else
+  node_t *node = tree->pool->free_list;
+  if (node != NULL)
+  {
+    tree->pool->free_list = node->right;
+    return node;
+  }
+
+  node_chunk_t *chunk = tree->pool->chunks;
+  if (chunk == NULL || chunk->used == chunk->capacity)
+    chunk = new_chunk(tree, RBTREE_CHUNK_NODES);
+  return &chunk->nodes[chunk->used++];
+#endif
+}
+
+// 삭제된 node를 free list에 돌려주는 함수
+void rbtree_release_node(rbtree *tree, node_t *p)
+{
+#ifdef RBTREE_MALLOC_NODES
+  (void)tree;
   free(p);
+#else
+  p->right = tree->pool->free_list;
+  if (p->right == NULL)
+    tree->pool->free_tail = p;
+  tree->pool->free_list = p;
+#endif
+}
+
+// erase에서 빠진 node를 처리하는 함수 (retire hook이 있으면 해제를 미룸)
+void free_node(rbtree *tree, node_t *p)
+{
+  if (tree->retire != NULL)
+  {
+    tree->retire(tree->retire_ctx, p);
+    return;
+  }
+  rbtree_release_node(tree, p);
+}
+
+// p를 root로 하는 subtree의 node를 모두 release로 넘기는 함수
+// 재귀 없이 parent pointer로 올라가며 leaf부터 해제하므로 추가 공간이 O(1)
+void node_is_free(rbtree *tree, node_t *p, void (*release)(rbtree *, node_t *))
+{
+  while (p != tree->nil)
+  {
+    if (p->left != tree->nil)
+      p = p->left;
+    else if (p->right != tree->nil)
+      p = p->right;
+    else
+    {
+      node_t *parent_node = p->parent;
+      if (parent_node != tree->nil)
+      {
+        if (parent_node->left == p)
+          parent_node->left = tree->nil;
+        else
+          parent_node->right = tree->nil;
+      }
+      release(tree, p);
+      p = parent_node;
+    }
+  }
+}
+
+// tree가 pool을 놓는 함수 (마지막 tree면 pool을 해제한다)
+void leave_pool(rbtree *tree)
+{
+  rbtree_pool_t *pool = tree->pool;
+#ifndef RBTREE_MALLOC_NODES
+  // pool을 같이 쓰는 tree가 남아 있으면 node를 free list에 돌려준다
+  if (pool->refs > 1)
+#endif
+    node_is_free(tree, tree->root, rbtree_release_node);
+  tree->root = tree->nil;
+  tree->leftmost = tree->rightmost = tree->nil;
+
+  if (--pool->refs == 0)
+  {
+    // 남은 node는 모두 chunk 안에 있으므로 chunk만 해제하면 된다
+    node_chunk_t *chunk = pool->chunks;
+    while (chunk != NULL)
+    {
+      node_chunk_t *next = chunk->next;
+      free(chunk);
+      chunk = next;
+    }
+    free(pool);
+  }
 }
 
 void delete_rbtree(rbtree *tree)
 {
-  node_t *start = tree->root;
-  if (start != tree->nil)
-    node_is_free(tree, start);
-  free(tree->nil);
+  leave_pool(tree);
+  free(tree->unsized);
   free(tree);
 }
 
-// inorder 순서로 현재 노드의 다음 노드를 찾아주는 함수
-node_t *get_successor(const rbtree *tree, node_t *p)
+// n개의 node를 pool의 chunk 하나로 잡아 주는 함수 (node를 직접 잇는 builder용)
+node_t *rbtree_reserve_nodes(rbtree *tree, const size_t n)
 {
-  if (p == rbtree_max(tree))
+#ifdef RBTREE_MALLOC_NODES
+  (void)tree;
+  (void)n;
+  return NULL;
+#else
+  // n개짜리 chunk를 통째로 쓰고, 기존 bump chunk는 계속 앞에 둔다
+  node_chunk_t *bump_chunk = tree->pool->chunks;
+  node_chunk_t *chunk = new_chunk(tree, n);
+  chunk->used = n;
+  if (bump_chunk != NULL)
+  {
+    tree->pool->chunks = bump_chunk;
+    chunk->next = bump_chunk->next;
+    bump_chunk->next = chunk;
+    if (tree->pool->last_chunk == bump_chunk)
+      tree->pool->last_chunk = chunk;
+  }
+  return chunk->nodes;
+#endif
+}
+
+// 정렬된 arr[lo, hi)의 가운데 key를 root로 하는 subtree를 nodes[lo, hi)에 만드는 함수
+// red_depth 깊이의 노드만 red로 칠하면 모든 경로의 black 개수가 같아진다
+// prefix가 있으면 arr[i]가 prefix[i + 1] - prefix[i]개씩 있는 것으로 size를 채운다
+node_t *build_subtree(rbtree *tree, node_t *nodes, const key_t *arr, const size_t *prefix,
+                      size_t lo, size_t hi, node_t *parent, int depth, int red_depth)
+{
+  if (lo >= hi)
     return tree->nil;
-  node_t *current_node;
-  if (p->right == tree->nil)
+
+  size_t mid = lo + (hi - lo) / 2;
+#ifdef RBTREE_MALLOC_NODES
+  node_t *node = alloc_node(tree);
+#else
+  node_t *node = &nodes[mid];
+#endif
+  node->key = arr[mid];
+  node->color = (depth == red_depth) ? RBTREE_RED : RBTREE_BLACK;
+  node->parent = parent;
+  node->size = (prefix != NULL) ? prefix[hi] - prefix[lo] : hi - lo;
+  node->left = build_subtree(tree, nodes, arr, prefix, lo, mid, node, depth + 1, red_depth);
+  node->right = build_subtree(tree, nodes, arr, prefix, mid + 1, hi, node, depth + 1, red_depth);
+  return node;
+}
+
+// 정렬된 keys[0, m)로 tree의 pool에 균형 잡힌 subtree를 만들어 root를 반환하는 함수
+// prefix가 있으면 서로 다른 keys[i]가 prefix[i + 1] - prefix[i]개씩 있는 것으로 size를 채운다
+node_t *build_runs(rbtree *tree, const key_t *keys, const size_t *prefix, const size_t m)
+{
+  if (m == 0)
+    return tree->nil;
+
+  // 가운데 분할로 만든 tree는 leaf 깊이 차이가 1 이하이므로,
+  // 꽉 찬 깊이 floor(log2(m + 1)) 아래에 매달린 노드만 red가 된다
+  int red_depth = 0;
+  while (((size_t)2 << red_depth) <= m + 1)
+    red_depth++;
+
+  node_t *nodes = rbtree_reserve_nodes(tree, m);
+  return build_subtree(tree, nodes, keys, prefix, 0, m, tree->nil, 0, red_depth);
+}
+
+// 정렬된 arr로 tree의 pool에 균형 잡힌 subtree를 만들어 root를 반환하는 함수
+// counted mode면 같은 key를 node 하나로 모은다
+node_t *build_sorted(rbtree *tree, const key_t *arr, const size_t n)
+{
+  if (!tree->counted || n == 0)
+    return build_runs(tree, arr, NULL, n);
+
+  key_t *distinct = (key_t *)malloc(n * sizeof(key_t));
+  size_t *prefix = (size_t *)malloc((n + 1) * sizeof(size_t));
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++)
   {
-    current_node = p;
-    while (1)
+    if (m == 0 || distinct[m - 1] != arr[i])
     {
-      if (is_node_left(current_node))
-        return current_node->parent;
-      else
-        current_node = current_node->parent;
+      distinct[m] = arr[i];
+      prefix[m++] = i;
     }
   }
-  current_node = p->right;
+  prefix[m] = n;
+  node_t *root = build_runs(tree, distinct, prefix, m);
+  free(distinct);
+  free(prefix);
+  return root;
+}
 
-  while (current_node->left != tree->nil)
+// root를 통째로 바꾼 뒤 캐시된 min, max node를 다시 찾는 함수 (O(log n))
+void refresh_extremes(rbtree *tree)
+{
+  node_t *current_node = tree->root;
+  while (current_node != tree->nil && current_node->left != tree->nil)
     current_node = current_node->left;
+  tree->leftmost = current_node;
 
-  return current_node;
+  current_node = tree->root;
+  while (current_node != tree->nil && current_node->right != tree->nil)
+    current_node = current_node->right;
+  tree->rightmost = current_node;
 }
 
-void right_rotate(rbtree *tree, node_t *node)
+rbtree *rbtree_from_sorted_runs(const key_t *keys, const size_t *prefix, const size_t m,
+                                const int counted)
 {
-  node_t *parent_node = node->parent;
-  node_t *right_child = node->right;
-  node_t *grand_parent_node = parent_node->parent;
-
-  parent_node->left = right_child;
-  right_child->parent = parent_node;
-
-  if (parent_node == tree->root)
-    tree->root = node;
-  else if (parent_node != tree->root)
+  rbtree *tree = counted ? new_rbtree_counted() : new_rbtree();
+  if (counted || prefix == NULL || prefix[m] == m)
   {
-    if (is_node_left(parent_node))
-      grand_parent_node->left = node;
-    else
-      grand_parent_node->right = node;
-    node->parent = grand_parent_node;
+    tree->root = build_runs(tree, keys, counted ? prefix : NULL, m);
+    refresh_extremes(tree);
+    return tree;
   }
 
-  parent_node->parent = node;
-  node->right = parent_node;
+  // plain tree는 반복되는 key를 펼쳐 copy마다 node를 하나씩 만든다
+  key_t *arr = (key_t *)malloc(prefix[m] * sizeof(key_t));
+  for (size_t i = 0; i < m; i++)
+    for (size_t j = prefix[i]; j < prefix[i + 1]; j++)
+      arr[j] = keys[i];
+  tree->root = build_runs(tree, arr, NULL, prefix[m]);
+  refresh_extremes(tree);
+  free(arr);
+  return tree;
+}
+
+rbtree *rbtree_from_sorted_array(const key_t *arr, const size_t n)
+{
+  rbtree *tree = new_rbtree();
+  tree->root = build_sorted(tree, arr, n);
+  refresh_extremes(tree);
+  return tree;
 }
 
-void left_rotate(rbtree *tree, node_t *node)
+int compare_key(const void *p1, const void *p2)
 {
-  node_t *parent_node = node->parent;
-  node_t *left_child = node->left;
-  node_t *grand_parent_node = parent_node->parent;
+  key_t k1 = *(const key_t *)p1;
+  key_t k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
 
-  parent_node->right = left_child;
-  left_child->parent = parent_node;
+rbtree *rbtree_from_array(const key_t *arr, const size_t n)
+{
+  size_t i = 1;
+  while (i < n && arr[i - 1] <= arr[i])
+    i++;
+  if (i >= n)
+    return rbtree_from_sorted_array(arr, n);
 
-  if (parent_node == tree->root)
-    tree->root = node;
-  else if (parent_node != tree->root)
-  {
-    if (is_node_left(parent_node))
-      grand_parent_node->left = node;
-    else
-      grand_parent_node->right = node;
+  // 정렬되지 않은 입력은 복사본을 정렬해서 사용
+  key_t *sorted = (key_t *)malloc(n * sizeof(key_t));
+  for (i = 0; i < n; i++)
+    sorted[i] = arr[i];
+  qsort(sorted, n, sizeof(key_t), compare_key);
+  rbtree *tree = rbtree_from_sorted_array(sorted, n);
+  free(sorted);
+  return tree;
+}
 
-    node->parent = grand_parent_node;
+// inorder 순서로 현재 노드의 다음 노드를 찾아주는 함수 (마지막 노드면 nil)
+node_t *get_successor(const rbtree *tree, node_t *p)
+{
+  node_t *current_node;
+  if (p->right != tree->nil)
+  {
+    current_node = p->right;
+    while (current_node->left != tree->nil)
+      current_node = current_node->left;
+    return current_node;
   }
 
-  node->left = parent_node;
-  parent_node->parent = node;
+  // 왼쪽 자식으로 올라오는 첫 조상이 successor
+  current_node = p;
+  while (current_node->parent != tree->nil && !is_node_left(current_node))
+    current_node = current_node->parent;
+  return current_node->parent;
 }
 
-// insert 리밸런싱 함수
-void rbtree_insert_fixup(rbtree *tree, node_t *node)
+// inorder 순서로 현재 노드의 이전 노드를 찾아주는 함수 (첫 노드면 nil)
+node_t *get_predecessor(const rbtree *tree, node_t *p)
 {
-  if (node == tree->root)
+  node_t *current_node;
+  if (p->left != tree->nil)
   {
-    node->color = RBTREE_BLACK;
-    return;
+    current_node = p->left;
+    while (current_node->right != tree->nil)
+      current_node = current_node->right;
+    return current_node;
   }
 
-  node_t *parent_node = node->parent;
-  node_t *grand_parent_node = parent_node->parent;
-  node_t *uncle_node;
+  current_node = p;
+  while (current_node->parent != tree->nil && is_node_left(current_node))
+    current_node = current_node->parent;
+  return current_node->parent;
+}
+
+// 자식들의 subtree size와 p 자신의 key 개수로 p의 size를 다시 계산하는 함수
+void update_size(node_t *p, size_t count)
+{
+  p->size = p->left->size + p->right->size + count;
+}
+
+// p부터 stop 직전까지 경로의 size를 amount만큼 줄이는 함수 (stop이 nil이면 root까지)
+void shrink_size_to(node_t *p, node_t *stop, size_t amount)
+{
+  for (; p != stop; p = p->parent)
+    p->size -= amount;
+}
+
+// p부터 root까지 경로의 size를 amount만큼 늘리는 함수
+void grow_size_to_root(rbtree *tree, node_t *p, size_t amount)
+{
+  for (; p != tree->nil; p = p->parent)
+    p->size += amount;
+}
+
+// subtree size를 모두 자식들의 size + 1로 다시 계산하는 함수 (plain tree, 후위 순회)
+void recount_sizes(rbtree *tree)
+{
+  node_t *p = tree->root;
+  while (p != tree->nil)
+  {
+    // p의 subtree에서 후위 순회의 첫 node까지 내려간다
+    while (p->left != tree->nil || p->right != tree->nil)
+      p = (p->left != tree->nil) ? p->left : p->right;
+    update_size(p, 1);
+    // 왼쪽 subtree를 마친 parent는 오른쪽 subtree로, 아니면 parent 자신을 계산한다
+    node_t *parent_node = p->parent;
+    while (parent_node != tree->nil &&
+           (p == parent_node->right || parent_node->right == tree->nil))
+    {
+      update_size(parent_node, 1);
+      p = parent_node;
+      parent_node = p->parent;
+    }
+    p = (parent_node != tree->nil) ? parent_node->right : tree->nil;
+  }
+}
 
-  if (parent_node->color == RBTREE_BLACK)
+void rbtree_settle_sizes(const rbtree *const_tree)
+{
+  // size는 node에 캐시된 값이므로 const tree에서도 고쳐 쓴다
+  rbtree *tree = (rbtree *)const_tree;
+  if (tree->unsized_count == 0)
     return;
 
-  // uncle node 설정
-  if (is_node_left(parent_node))
-    uncle_node = grand_parent_node->right;
+  // 경로 하나의 길이로 node마다 root까지 올라가는 비용을 어림해 O(n) 재계산과 비교한다
+  size_t depth = 0;
+  for (node_t *p = tree->unsized[0]; p != tree->nil; p = p->parent)
+    depth++;
+  if (tree->unsized_count * depth < rbtree_size(tree))
+    for (size_t i = 0; i < tree->unsized_count; i++)
+      grow_size_to_root(tree, tree->unsized[i], 1);
   else
-    uncle_node = grand_parent_node->left;
+    recount_sizes(tree);
 
-  if (uncle_node->color == RBTREE_RED)
+  free(tree->unsized);
+  tree->unsized = NULL;
+  tree->unsized_count = tree->unsized_capacity = 0;
+}
+
+// p가 nil이 아니면 p의 parent를 바꾸는 함수 (공유 nil에는 쓰지 않는다)
+void set_parent(rbtree *tree, node_t *p, node_t *parent)
+{
+  if (p != tree->nil)
+    STORE(p->parent, parent);
+}
+
+// rotate로 new가 old 위로 올라간 뒤 size를 고치는 함수
+// new는 old의 subtree를 그대로 물려받고, old는 new의 subtree 대신 안쪽 자식만 갖는다
+// (key 개수를 다시 세지 않으므로 counted mode에서도 맞다)
+void rotate_size(node_t *old, node_t *new)
+{
+  node_t *inner = (old == new->left) ? old->right : old->left;
+  const size_t size = old->size;
+  old->size -= new->size - inner->size;
+  new->size = size;
+}
+
+// int key tree는 rbtree_map.h와 같은 core template의 instantiation이다:
+// 탐색과 삽입 위치 찾기, rotate와 insert, erase 리밸런싱을 모두 core가 만든다
+// (공유 nil에는 쓰지 않고, lock 없는 reader가 따라가는 link와 root는 STORE로 쓴다)
+// 새 node의 size에는 그 node의 개수를 담아 두고, 내려가며 지나는 node마다 더한다
+#define RBCORE_NAME core
+#define RBCORE_TREE rbtree
+#define RBCORE_NODE node_t
+#define RBCORE_ROOT(tree) ((tree)->root)
+#define RBCORE_NIL(tree) ((tree)->nil)
+#define RBCORE_STORE(x, v) STORE(x, v)
+#define RBCORE_STAT(tree, field, n) STAT_ADD(tree, field, n)
+#define RBCORE_AUGMENT_ROTATE(tree, old, new) rotate_size(old, new)
+#define RBCORE_AUGMENT_COPY(tree, old, new) ((new)->size = (old)->size)
+#define RBCORE_KEY_T key_t
+#define RBCORE_KEY(p) ((p)->key)
+#define RBCORE_AUGMENT_DESCEND(tree, p, node) ((p)->size += (node)->size)
+#include "rbtree_core.h"
+
+#ifdef RBTREE_STATS
+// 새로 넣은 node의 깊이로 max_height를 갱신하는 함수
+void stats_note_depth(rbtree *tree, node_t *p)
+{
+  size_t depth = 0;
+  for (; p != tree->nil; p = p->parent)
+    depth++;
+  if (depth > tree->stats.max_height)
+    tree->stats.max_height = depth;
+}
+#endif
+
+// start의 subtree 안에서 key의 자리를 찾아 새 node를 붙이고 리밸런싱하는 함수
+// 새 node는 size에 weight (1, 또는 settle까지 미루면 0)만큼 더하고,
+// start 위 조상들의 size는 호출하는 쪽에서 미리 늘려 둔다
+node_t *insert_below(rbtree *tree, node_t *start, const key_t key, const size_t weight)
+{
+  node_t *node = alloc_node(tree);
+  node->key = key;
+  node->size = weight;
+
+  // 삽입할 위치 찾기 (지나가는 노드마다 subtree size에 weight를 더한다)
+  int dir;
+  node_t *parent_node = core_descend(tree, start, node, &dir);
+  core_link(tree, parent_node, dir, node);
+
+  // 새 node는 한쪽 끝 node의 바깥쪽 자식으로 붙을 때만 새 min, max가 된다
+  if (parent_node == tree->nil)
   {
-    grand_parent_node->color = RBTREE_RED;
-    parent_node->color = RBTREE_BLACK;
-    uncle_node->color = RBTREE_BLACK;
-    rbtree_insert_fixup(tree, grand_parent_node);
+    STORE(tree->leftmost, node);
+    STORE(tree->rightmost, node);
   }
-  else if (uncle_node->color == RBTREE_BLACK)
+  else if (parent_node == tree->leftmost && dir == 0)
+    STORE(tree->leftmost, node);
+  else if (parent_node == tree->rightmost && dir == 1)
+    STORE(tree->rightmost, node);
+  STAT_DEPTH(tree, node);
+  tree->finger = node;
+
+  // 삽입 이후 리밸런싱
+  core_insert_fixup(tree, node);
+  return node;
+}
+
+node_t *rbtree_insert(rbtree *tree, const key_t key)
+{
+  if (tree->counted)
   {
-    if (is_node_left(parent_node) && is_node_left(node))
-    {
-      right_rotate(tree, node->parent);
-      node->parent->color = RBTREE_BLACK;
-      node->parent->right->color = RBTREE_RED;
-    }
-    else if (is_node_left(parent_node) && !is_node_left(node))
+    // 이미 있는 key면 그 node의 개수만 늘린다
+    node_t *existing = rbtree_find(tree, key);
+    if (existing != NULL)
     {
-      left_rotate(tree, node);
-      right_rotate(tree, node);
-      node->color = RBTREE_BLACK;
-      node->right->color = RBTREE_RED;
+      grow_size_to_root(tree, existing, 1);
+      return existing;
     }
-    else if (!is_node_left(parent_node) && is_node_left(node))
+  }
+  return insert_below(tree, tree->root, key, 1);
+}
+
+node_t *rbtree_find(const rbtree *tree, const key_t key)
+{
+  node_t *p = core_find(tree, tree->root, key);
+  return (p != tree->nil) ? p : NULL;
+}
+
+// finger에서 위로 올라가며 key의 자리를 subtree 안에 둔 가장 낮은 node를 찾는 함수
+// node x의 key 구간은 x가 오른쪽 subtree에 속한 가장 가까운 조상의 key (lo)부터
+// 왼쪽 subtree에 속한 가장 가까운 조상의 key (hi)까지다.
+// is_insert면 lo <= key < hi (같은 key는 오른쪽으로 가므로), 아니면 lo < key < hi를 찾는다
+node_t *finger_climb(const rbtree *tree, node_t *finger, const key_t key, const int is_insert)
+{
+  node_t *x = finger;
+  const int go_right = key >= finger->key;
+  // 끝 node의 바깥쪽 구간은 끝이 없으므로 spine을 올라가 볼 필요가 없다
+  if (go_right ? finger == tree->rightmost : finger == tree->leftmost)
+    return x;
+  while (x != tree->root)
+  {
+    // 같은 방향의 간선은 x의 구간 경계를 바꾸지 않으므로 한 번에 지나간다
+    node_t *y = x;
+    while (y != tree->root && is_node_left(y) != go_right)
+      y = y->parent;
+    if (y == tree->root)
+      return x;
+    const key_t bound = y->parent->key;
+    STAT_ADD(tree, comparisons, 1);
+    if (go_right ? key < bound : (is_insert ? key >= bound : key > bound))
+      return x;
+    x = y->parent;
+  }
+  return x;
+}
+
+node_t *rbtree_find_from(const rbtree *tree, node_t *finger, const key_t key)
+{
+  if (finger == NULL)
+    finger = tree->finger;
+  if (finger == NULL)
+    return rbtree_find(tree, key);
+
+  node_t *p = core_find(tree, finger_climb(tree, finger, key, 0), key);
+  return (p != tree->nil) ? p : NULL;
+}
+
+node_t *rbtree_insert_hint(rbtree *tree, node_t *hint, const key_t key)
+{
+  if (hint == NULL)
+    hint = tree->finger;
+  if (hint == NULL)
+    return rbtree_insert(tree, key);
+
+  if (tree->counted)
+  {
+    node_t *existing = rbtree_find_from(tree, hint, key);
+    if (existing != NULL)
     {
-      right_rotate(tree, node);
-      left_rotate(tree, node);
-      node->color = RBTREE_BLACK;
-      node->left->color = RBTREE_RED;
+      grow_size_to_root(tree, existing, 1);
+      tree->finger = existing;
+      return existing;
     }
-    else if (!is_node_left(parent_node) && !is_node_left(node))
+  }
+
+  node_t *start = finger_climb(tree, hint, key, 1);
+  if (tree->counted)
+  {
+    grow_size_to_root(tree, start->parent, 1);
+    return insert_below(tree, start, key, 1);
+  }
+
+  // plain tree는 root까지 size를 늘리지 않고 새 node를 0개로 걸어 두었다가 settle에서 더한다
+  if (tree->unsized_count == tree->unsized_capacity)
+  {
+    tree->unsized_capacity = tree->unsized_capacity ? tree->unsized_capacity * 2 : 64;
+    tree->unsized = (node_t **)realloc(tree->unsized, tree->unsized_capacity * sizeof(node_t *));
+  }
+  node_t *node = insert_below(tree, start, key, 0);
+  tree->unsized[tree->unsized_count++] = node;
+  return node;
+}
+
+// rbtree_find_many에서 동시에 진행하는 탐색 개수와 경로 stack 깊이
+#define FIND_LANES 8
+#define FIND_MAX_DEPTH 128
+// 이보다 작은 batch는 정렬 비용이 더 크므로 rbtree_find를 반복
+#define FIND_MANY_MIN_BATCH 16
+
+typedef struct
+{
+  key_t key;
+  size_t index;
+} find_query_t;
+
+// 탐색 경로 위의 노드와, 그 노드를 지나게 되는 key의 열린 구간 (lo, hi)
+typedef struct
+{
+  node_t *node;
+  long long lo, hi;
+} find_frame_t;
+
+typedef struct
+{
+  size_t pos, end;  // 이 lane이 맡은 정렬된 query 구간
+  node_t *node;     // 다음에 방문할 노드
+  long long lo, hi;
+  int depth;
+  find_frame_t path[FIND_MAX_DEPTH];
+} find_lane_t;
+
+int compare_query(const void *p1, const void *p2)
+{
+  key_t k1 = ((const find_query_t *)p1)->key;
+  key_t k2 = ((const find_query_t *)p2)->key;
+  return (k1 > k2) - (k1 < k2);
+}
+
+// 다음 key의 탐색을 시작할 위치를 정하는 함수
+// 이전 경로에서 key를 열린 구간 안에 두는 가장 깊은 노드부터 다시 내려가면
+// root부터 내려가는 것과 같은 노드에 도달한다
+void lane_resume(const rbtree *tree, find_lane_t *lane, key_t key)
+{
+  while (lane->depth > 0)
+  {
+    find_frame_t *top = &lane->path[lane->depth - 1];
+    if (top->lo < key && key < top->hi)
+      break;
+    lane->depth--;
+  }
+  if (lane->depth == 0)
+  {
+    lane->node = tree->root;
+    lane->lo = LLONG_MIN;
+    lane->hi = LLONG_MAX;
+    return;
+  }
+  find_frame_t *top = &lane->path[--lane->depth];
+  lane->node = top->node;
+  lane->lo = top->lo;
+  lane->hi = top->hi;
+}
+
+void rbtree_find_many(const rbtree *tree, const key_t *keys, const size_t n, node_t **out)
+{
+  if (n < FIND_MANY_MIN_BATCH)
+  {
+    for (size_t i = 0; i < n; i++)
+      out[i] = rbtree_find(tree, keys[i]);
+    return;
+  }
+
+  // batch를 정렬해서 이웃한 key끼리 탐색 경로의 앞부분을 공유
+  find_query_t *queries = (find_query_t *)malloc(n * sizeof(find_query_t));
+  for (size_t i = 0; i < n; i++)
+  {
+    queries[i].key = keys[i];
+    queries[i].index = i;
+  }
+  qsort(queries, n, sizeof(find_query_t), compare_query);
+
+  // 정렬된 batch를 lane마다 연속 구간으로 나누고, 한 단계씩 번갈아 진행하며
+  // 다음 노드를 prefetch해서 메모리 지연을 겹친다
+  find_lane_t *lanes = (find_lane_t *)malloc(FIND_LANES * sizeof(find_lane_t));
+  int active = 0;
+  for (int i = 0; i < FIND_LANES; i++)
+  {
+    find_lane_t *lane = &lanes[active];
+    lane->pos = n * i / FIND_LANES;
+    lane->end = n * (i + 1) / FIND_LANES;
+    lane->depth = 0;
+    if (lane->pos == lane->end)
+      continue;
+    lane_resume(tree, lane, queries[lane->pos].key);
+    active++;
+  }
+
+  while (active > 0)
+  {
+    for (int i = 0; i < active; i++)
     {
-      left_rotate(tree, node->parent);
-      node->parent->color = RBTREE_BLACK;
-      node->parent->left->color = RBTREE_RED;
+      find_lane_t *lane = &lanes[i];
+      key_t key = queries[lane->pos].key;
+      node_t *node = lane->node;
+      node_t *found = NULL;
+      int done = (node == tree->nil);
+
+      if (!done)
+      {
+        lane->path[lane->depth].node = node;
+        lane->path[lane->depth].lo = lane->lo;
+        lane->path[lane->depth].hi = lane->hi;
+        lane->depth++;
+        STAT_ADD(tree, comparisons, 1);
+        if (key == node->key)
+        {
+          found = node;
+          done = 1;
+        }
+        else if (key < node->key)
+        {
+          lane->node = node->left;
+          lane->hi = node->key;
+        }
+        else
+        {
+          lane->node = node->right;
+          lane->lo = node->key;
+        }
+        PREFETCH(lane->node);
+      }
+      if (!done)
+        continue;
+
+      out[queries[lane->pos].index] = found;
+      if (++lane->pos == lane->end)
+      {
+        lanes[i--] = lanes[--active];
+        continue;
+      }
+      lane_resume(tree, lane, queries[lane->pos].key);
     }
   }
+
+  free(lanes);
+  free(queries);
 }
 
-node_t *rbtree_insert(rbtree *tree, const key_t key)
+node_t *rbtree_min(const rbtree *tree)
 {
-  node_t *node = (node_t *)malloc(sizeof(node_t));
-  node_t *current_node = tree->root;
+  return tree->leftmost;
+}
 
-  node->key = key;
-  node->color = RBTREE_RED;
-  node->left = node->right = tree->nil;
+node_t *rbtree_max(const rbtree *tree)
+{
+  return tree->rightmost;
+}
+
+// p를 tree에서 떼어내고 리밸런싱하는 함수 (다른 node의 key와 위치는 바뀌지 않는다)
+// counted mode의 key 개수는 size에만 들어 있어 떼어낸 뒤에는 다시 계산할 수 없으므로,
+// 빠지는 개수를 미리 경로에서 빼 두고 core의 erase는 size를 옮기기만 한다
+void unlink_node(rbtree *tree, node_t *p)
+{
+  const size_t count = node_weight(p);
+
+  // 자식이 둘이면 successor가 p 자리로 올라가므로 그 사이 경로는 successor의 개수만큼 줄어든다
+  if (p->left != tree->nil && p->right != tree->nil)
+  {
+    node_t *successor = get_successor(tree, p);
+    shrink_size_to(successor->parent, p, node_weight(successor));
+  }
+  // p와 그 위로는 p의 개수만큼 줄어들고, successor는 줄어든 p의 size를 물려받는다
+  shrink_size_to(p, tree->nil, count);
+  core_erase(tree, p);
+}
+
+int rbtree_erase(rbtree *tree, node_t *p)
+{
+  rbtree_settle_sizes(tree);
+  // counted mode에서 남은 개수가 있으면 하나만 뺀다
+  if (rbtree_node_count(p) > 1)
+  {
+    shrink_size_to(p, tree->nil, 1);
+    return 0;
+  }
+  // 끝 node를 지우면 그 이웃이 새 끝이 된다 (unlink 전에 찾아야 한다)
+  if (p == tree->leftmost)
+    STORE(tree->leftmost, get_successor(tree, p));
+  if (p == tree->rightmost)
+    STORE(tree->rightmost, get_predecessor(tree, p));
+  unlink_node(tree, p);
+  if (p == tree->finger)
+    tree->finger = NULL;
+  free_node(tree, p);
+  return 0;
+}
+
+// min(is_min)이나 max node의 key 하나를 꺼내는 함수
+// 끝 node는 안쪽 자식이 없고 바깥쪽 자식은 있어도 red leaf 하나뿐이므로
+// successor를 찾거나 옮기지 않고 그 자리에서 떼어낸다
+int pop_end_node(rbtree *tree, const int is_min, key_t *key)
+{
+  rbtree_settle_sizes(tree);
+  node_t *p = is_min ? tree->leftmost : tree->rightmost;
+  if (p == tree->nil)
+    return -1;
+  if (key != NULL)
+    *key = p->key;
+  if (rbtree_node_count(p) > 1)
+  {
+    shrink_size_to(p, tree->nil, 1);
+    return 0;
+  }
+
+  node_t *child = is_min ? p->right : p->left;
+  node_t *parent_node = p->parent;
+  shrink_size_to(parent_node, tree->nil, 1);
 
-  // 삽입할 위치 찾기
+  // 새 끝은 바깥쪽 자식이 있으면 그 자식, 없으면 parent다
+  // lock 없는 reader가 끝 node를 바로 읽으므로 떼어내기 전에 옮겨 둔다 (rbtree_erase와 같다)
+  node_t *next_end = (child != tree->nil) ? child : parent_node;
+  if (p == tree->leftmost)
+    STORE(tree->leftmost, next_end);
+  if (p == tree->rightmost)
+    STORE(tree->rightmost, next_end);
+
+  // p 자리에 child를 거는 것도 insert, erase와 같이 STORE로 publish한다
+  core_replace_child(tree, parent_node, p, child);
+  if (child != tree->nil)
+  {
+    child->color = RBTREE_BLACK;
+    STAT_ADD(tree, recolors, 1);
+  }
+  else if (p->color == RBTREE_BLACK && parent_node != tree->nil)
+    core_erase_fixup(tree, parent_node, is_min);
+
+  if (p == tree->finger)
+    tree->finger = NULL;
+  free_node(tree, p);
+  return 0;
+}
+
+int rbtree_pop_min(rbtree *tree, key_t *key)
+{
+  return pop_end_node(tree, 1, key);
+}
+
+int rbtree_pop_max(rbtree *tree, key_t *key)
+{
+  return pop_end_node(tree, 0, key);
+}
+
+size_t rbtree_size(const rbtree *tree)
+{
+  // settle하지 않은 node는 size에 0개로 들어 있다
+  return tree->root->size + tree->unsized_count;
+}
+
+// key보다 작은 key의 개수를 구하는 함수
+size_t rbtree_rank(const rbtree *tree, const key_t key)
+{
+  rbtree_settle_sizes(tree);
+  node_t *current_node = tree->root;
+  size_t rank = 0;
   while (current_node != tree->nil)
   {
-    if (current_node->key <= key)
+    STAT_ADD(tree, comparisons, 1);
+    if (current_node->key < key)
     {
-      if (current_node->right == tree->nil)
-      {
-        current_node->right = node;
-        break;
-      }
+      rank += current_node->size - current_node->right->size;
       current_node = current_node->right;
     }
     else
+      current_node = current_node->left;
+  }
+  return rank;
+}
+
+// inorder 순서로 k번째 (0부터 시작) key를 가진 노드를 찾는 함수
+node_t *rbtree_select(const rbtree *tree, const size_t k)
+{
+  rbtree_settle_sizes(tree);
+  node_t *current_node = tree->root;
+  size_t index = k;
+  if (index >= current_node->size)
+    return NULL;
+
+  while (1)
+  {
+    if (index < current_node->left->size)
     {
-      if (current_node->left == tree->nil)
-      {
-        current_node->left = node;
-        break;
-      }
       current_node = current_node->left;
+      continue;
     }
+    // [left size, size - right size)가 이 node의 key 자리
+    const size_t end = current_node->size - current_node->right->size;
+    if (index < end)
+      return current_node;
+    index -= end;
+    current_node = current_node->right;
   }
-  node->parent = current_node;
+}
 
-  if (current_node == tree->nil)
-    tree->root = node;
+size_t rbtree_count_range(const rbtree *tree, const key_t lo, const key_t hi)
+{
+  if (lo >= hi)
+    return 0;
+  return rbtree_rank(tree, hi) - rbtree_rank(tree, lo);
+}
 
-  // 삽입 이후 리밸런싱
-  rbtree_insert_fixup(tree, node);
-  return node;
+// subtree의 black height를 구하는 함수 (nil은 0)
+int black_height(const rbtree *tree, node_t *p)
+{
+  int height = 0;
+  for (; p != tree->nil; p = p->left)
+    if (p->color == RBTREE_BLACK)
+      height++;
+  return height;
 }
 
-node_t *rbtree_find(const rbtree *tree, const key_t key)
+// split/join이 주고받는 subtree (root의 parent는 nil)와 그 black height
+typedef struct
 {
-  node_t *current_node = tree->root;
-  while (key != current_node->key && current_node != tree->nil)
+  node_t *root;
+  int bh;
+} subtree_t;
+
+// root를 떼어낸 subtree로 만드는 함수
+subtree_t make_subtree(rbtree *tree, node_t *root)
+{
+  set_parent(tree, root, tree->nil);
+  return (subtree_t){root, black_height(tree, root)};
+}
+
+// subtree를 tree 전체로 거는 함수
+void set_root(rbtree *tree, subtree_t t)
+{
+  // 이전 node들이 다른 tree로 옮겨졌을 수 있다
+  tree->finger = NULL;
+  tree->root = t.root;
+  if (tree->root != tree->nil)
   {
-    if (key < current_node->key)
-      current_node = current_node->left;
+    tree->root->parent = tree->nil;
+    tree->root->color = RBTREE_BLACK;
+  }
+  refresh_extremes(tree);
+}
+
+// 두 subtree를 pivot 아래로 잇는 함수 (left의 key <= pivot->key <= right의 key)
+// 낮은 쪽을 높은 쪽 spine에서 같은 black height인 node 자리에 붙이고 insert fixup을 돌리므로
+// O(black height 차이 + 1). pivot->size에는 pivot 자신의 key 개수를 담아 넘긴다
+subtree_t join_subtrees(rbtree *tree, subtree_t left, node_t *pivot, subtree_t right)
+{
+  const size_t count = pivot->size;
+  // root를 black으로 만들어 두면 fixup이 root 위의 nil을 보지 않는다
+  if (left.root->color == RBTREE_RED)
+  {
+    left.root->color = RBTREE_BLACK;
+    left.bh++;
+  }
+  if (right.root->color == RBTREE_RED)
+  {
+    right.root->color = RBTREE_BLACK;
+    right.bh++;
+  }
+  set_parent(tree, left.root, tree->nil);
+  set_parent(tree, right.root, tree->nil);
+
+  if (left.bh == right.bh)
+  {
+    pivot->color = RBTREE_BLACK;
+    pivot->parent = tree->nil;
+    pivot->left = left.root;
+    pivot->right = right.root;
+    set_parent(tree, left.root, pivot);
+    set_parent(tree, right.root, pivot);
+    update_size(pivot, count);
+    return (subtree_t){pivot, left.bh + 1};
+  }
+
+  // left가 낮으면 right의 왼쪽 spine을, 아니면 left의 오른쪽 spine을 내려간다
+  int is_left = left.bh < right.bh;
+  subtree_t high = is_left ? right : left;
+  node_t *other = is_left ? left.root : right.root;
+  const int target_bh = is_left ? left.bh : right.bh;
+  int height = high.bh;
+  // current_node가 nil일 수 있으므로 parent는 따로 기억한다
+  node_t *parent_node = tree->nil;
+  node_t *current_node = high.root;
+  while (current_node->color == RBTREE_RED || height > target_bh)
+  {
+    if (current_node->color == RBTREE_BLACK)
+      height--;
+    parent_node = current_node;
+    current_node = is_left ? current_node->left : current_node->right;
+  }
+
+  pivot->color = RBTREE_RED;
+  pivot->parent = parent_node;
+  if (is_left)
+  {
+    parent_node->left = pivot;
+    pivot->left = other;
+    pivot->right = current_node;
+  }
+  else
+  {
+    parent_node->right = pivot;
+    pivot->left = current_node;
+    pivot->right = other;
+  }
+  set_parent(tree, current_node, pivot);
+  set_parent(tree, other, pivot);
+  update_size(pivot, count);
+  grow_size_to_root(tree, parent_node, other->size + count);
+
+  tree->root = high.root;
+  const int grown = core_insert_fixup(tree, pivot);
+  return (subtree_t){tree->root, high.bh + grown};
+}
+
+// split에서 내려가는 경로 stack 깊이 (red-black tree의 높이는 2 log2(n + 1) 이하)
+#define SPLIT_MAX_DEPTH 128
+
+// split 기준: key 미만 / key 이하 / inorder 앞쪽 rank개가 lo로 간다
+// SPLIT_RANK는 node 하나를 가르지 못하므로 counted mode에서는 쓰지 않는다
+typedef enum { SPLIT_BELOW, SPLIT_UP_TO, SPLIT_RANK } split_mode_t;
+
+// subtree t를 기준에 따라 lo와 hi 두 subtree로 나누는 함수
+// 내려간 경로를 아래부터 join하면 join 비용의 합이 telescoping되어 O(log n)
+void split_subtree(rbtree *tree, subtree_t t, split_mode_t mode, const key_t key, size_t rank,
+                   subtree_t *lo, subtree_t *hi)
+{
+  node_t *path[SPLIT_MAX_DEPTH];
+  int path_bh[SPLIT_MAX_DEPTH];
+  size_t path_count[SPLIT_MAX_DEPTH];
+  char is_lower[SPLIT_MAX_DEPTH];
+  int depth = 0;
+
+  node_t *current_node = t.root;
+  int height = t.bh;
+  while (current_node != tree->nil)
+  {
+    int lower;
+    if (mode == SPLIT_RANK)
+    {
+      lower = current_node->left->size < rank;
+      if (lower)
+        rank -= current_node->left->size + 1;
+    }
     else
-      current_node = current_node->right;
+    {
+      lower = (mode == SPLIT_BELOW) ? current_node->key < key : current_node->key <= key;
+      STAT_ADD(tree, comparisons, 1);
+    }
+
+    path[depth] = current_node;
+    path_bh[depth] = height;
+    // 아래쪽 join이 자식의 size를 바꾸기 전에 key 개수를 기억해 둔다
+    path_count[depth] = tree->counted ? rbtree_node_count(current_node) : 1;
+    is_lower[depth++] = lower;
+    if (current_node->color == RBTREE_BLACK)
+      height--;
+    current_node = lower ? current_node->right : current_node->left;
+  }
+
+  subtree_t left = {tree->nil, 0}, right = {tree->nil, 0};
+  while (depth > 0)
+  {
+    node_t *p = path[--depth];
+    const int child_bh = path_bh[depth] - (p->color == RBTREE_BLACK);
+    p->size = path_count[depth];
+    if (is_lower[depth])
+      left = join_subtrees(tree, (subtree_t){p->left, child_bh}, p, left);
+    else
+      right = join_subtrees(tree, right, p, (subtree_t){p->right, child_bh});
   }
+  *lo = left;
+  *hi = right;
+}
 
-  return (current_node != tree->nil) ? current_node : NULL;
+// subtree에서 min이나 max node p를 떼어내는 함수
+// 자식이 하나 이하인 node는 successor와 key를 바꾸지 않고 그대로 떨어져 나온다
+void detach_end_node(rbtree *tree, subtree_t *t, node_t *p)
+{
+  const size_t count = rbtree_node_count(p);
+  tree->root = t->root;
+  unlink_node(tree, p);
+  p->size = count;
+  *t = make_subtree(tree, tree->root);
 }
 
-node_t *rbtree_min(const rbtree *tree)
+// pivot 없이 두 subtree를 잇는 함수 (right의 min node를 떼어 pivot으로 쓴다)
+subtree_t join_two(rbtree *tree, subtree_t left, subtree_t right)
 {
-  node_t *current_node = tree->root;
-  while (current_node != tree->nil && current_node->left != tree->nil)
-    current_node = current_node->left;
+  if (right.root == tree->nil)
+    return left;
+  if (left.root == tree->nil)
+    return right;
 
-  return current_node;
+  node_t *pivot = right.root;
+  while (pivot->left != tree->nil)
+    pivot = pivot->left;
+  detach_end_node(tree, &right, pivot);
+  return join_subtrees(tree, left, pivot, right);
 }
 
-node_t *rbtree_max(const rbtree *tree)
+// left, mid, right를 순서대로 잇는 함수 (mid의 max node를 pivot으로 쓴다)
+subtree_t join_three(rbtree *tree, subtree_t left, subtree_t mid, subtree_t right)
 {
-  node_t *current_node = tree->root;
-  while (current_node != tree->nil && current_node->right != tree->nil)
-    current_node = current_node->right;
+  if (mid.root == tree->nil)
+    return join_two(tree, left, right);
 
-  return current_node;
+  node_t *pivot = mid.root;
+  while (pivot->right != tree->nil)
+    pivot = pivot->right;
+  detach_end_node(tree, &mid, pivot);
+  return join_subtrees(tree, join_two(tree, left, mid), pivot, right);
 }
 
-// erase 리밸런싱 함수
-void rbtree_erase_fixup(rbtree *tree, node_t *parent_node, int is_left)
+// [lo, hi) 안의 node를 inorder 순서로 visit에 넘기는 함수
+// visit이 0이 아닌 값을 반환하면 멈추고, 방문한 node 개수를 반환
+size_t rbtree_foreach_range(const rbtree *tree, const key_t lo, const key_t hi,
+                            int (*visit)(node_t *, void *), void *ctx)
 {
-  // is_left를 통해 extra black의 위치 확인
-  node_t *sibling_node = is_left ? parent_node->right : parent_node->left;
-  node_t *outside_child = is_left ? sibling_node->right : sibling_node->left; // sibling node의 바깥쪽 자식
-  node_t *inside_child = is_left ? sibling_node->left : sibling_node->right;  // sibling node의 안쪽 자식
+  size_t count = 0;
+  for (node_t *p = rbtree_lower_bound(tree, lo); p != NULL && p->key < hi; p = rbtree_iter_next(tree, p))
+  {
+    count++;
+    if (visit(p, ctx))
+      break;
+  }
+  return count;
+}
+
+// 이보다 적은 key는 split/join보다 하나씩 지우는 편이 빠르다 (bench-range 기준)
+#define ERASE_RANGE_MIN_SPLIT 4
 
-  if (sibling_node->color == RBTREE_RED)
+// [lo, hi) 안의 key를 모두 지우고 지운 개수를 반환하는 함수
+// lo와 hi에서 split해 가운데 subtree를 통째로 해제하고 양쪽을 join하므로 O(log n + k)
+size_t rbtree_erase_range(rbtree *tree, const key_t lo, const key_t hi)
+{
+  rbtree_settle_sizes(tree);
+  const size_t range_size = rbtree_count_range(tree, lo, hi);
+  if (range_size <= ERASE_RANGE_MIN_SPLIT)
   {
-    if (is_left)
-      left_rotate(tree, sibling_node);
-    else
-      right_rotate(tree, sibling_node);
-    exchange_color(sibling_node, parent_node);
-    rbtree_erase_fixup(tree, parent_node, is_left);
+    for (size_t i = 0; i < range_size; i++)
+      rbtree_erase(tree, rbtree_lower_bound(tree, lo));
+    return range_size;
   }
-  else if (sibling_node->color == RBTREE_BLACK)
+
+  subtree_t lower, middle, upper;
+  split_subtree(tree, make_subtree(tree, tree->root), SPLIT_BELOW, lo, 0, &lower, &middle);
+  split_subtree(tree, middle, SPLIT_BELOW, hi, 0, &middle, &upper);
+  node_is_free(tree, middle.root, free_node);
+  set_root(tree, join_two(tree, lower, upper));
+  return range_size;
+}
+
+// from pool의 chunk와 free list를 모두 into pool로 옮기고 from pool을 해제하는 함수
+// 두 list의 끝을 기억하고 있으므로 O(1). from의 bump chunk에 남은 자리는 쓰지 않고 둔다
+void merge_pool(rbtree_pool_t *into, rbtree_pool_t *from)
+{
+  if (from->chunks != NULL)
   {
-    if (outside_child->color == RBTREE_RED)
-    {
-      if (is_left)
-        left_rotate(tree, sibling_node);
-      else
-        right_rotate(tree, sibling_node);
-      exchange_color(sibling_node, parent_node);
-      outside_child->color = RBTREE_BLACK;
-    }
-    else if (outside_child->color == RBTREE_BLACK && inside_child->color == RBTREE_RED)
+    // into의 bump chunk는 계속 맨 앞에 둔다
+    if (into->chunks == NULL)
     {
-      if (is_left)
-        right_rotate(tree, inside_child);
-      else
-        left_rotate(tree, inside_child);
-      exchange_color(sibling_node, inside_child);
-      rbtree_erase_fixup(tree, parent_node, is_left);
+      into->chunks = from->chunks;
+      into->last_chunk = from->last_chunk;
     }
-    else if (outside_child->color == RBTREE_BLACK && inside_child->color == RBTREE_BLACK)
+    else
     {
-      sibling_node->color = RBTREE_RED;
-      if (parent_node == tree->root)
-        return;
-      rbtree_erase_fixup(tree, parent_node->parent, is_node_left(parent_node));
+      from->last_chunk->next = into->chunks->next;
+      into->chunks->next = from->chunks;
+      if (into->last_chunk == into->chunks)
+        into->last_chunk = from->last_chunk;
     }
   }
+  if (from->free_list != NULL)
+  {
+    from->free_tail->right = into->free_list;
+    if (into->free_list == NULL)
+      into->free_tail = from->free_tail;
+    into->free_list = from->free_list;
+  }
+  free(from);
 }
 
-// remove node를 successor로 대체하는 함수
-node_t *replace_to_successor(rbtree *tree, node_t *p, node_t *successor, node_t *removed_node_parent)
+// 두 tree를 같은 pool에 두는 함수
+// nil은 모든 tree가 같이 쓰므로 node는 그대로 두고 pool만 합치면 된다.
+// 한쪽 pool을 그 tree 혼자 쓰면 그 pool을 다른 pool에 합친다 (O(1))
+// 둘 다 다른 tree와 나눠 쓰는 pool이면 그 tree들의 pool pointer를 바꿀 수 없으므로
+// 작은 쪽의 key를 큰 쪽 pool에 새로 만들어 옮긴다 (O(작은 쪽 크기))
+void share_pool(rbtree *tree1, rbtree *tree2)
 {
-  node_t *replace_node = successor->right;
+  if (tree1->pool == tree2->pool)
+    return;
 
-  p->key = successor->key;
-  if (is_node_left(successor))
-    removed_node_parent->left = successor->right;
-  else if (!is_node_left(successor))
-    removed_node_parent->right = successor->right;
-  successor->right->parent = removed_node_parent;
+  if (tree1->pool->refs == 1 || tree2->pool->refs == 1)
+  {
+    rbtree *alone = (tree2->pool->refs == 1) ? tree2 : tree1;
+    rbtree *other = (alone == tree1) ? tree2 : tree1;
+    merge_pool(other->pool, alone->pool);
+    alone->pool = other->pool;
+    alone->pool->refs++;
+    return;
+  }
 
-  return replace_node;
+  rbtree *from = (rbtree_size(tree1) < rbtree_size(tree2)) ? tree1 : tree2;
+  rbtree *to = (from == tree1) ? tree2 : tree1;
+  const size_t n = rbtree_size(from);
+  key_t *keys = (key_t *)malloc((n + 1) * sizeof(key_t));
+  rbtree_to_array(from, keys, n);
+
+  leave_pool(from);
+  from->pool = to->pool;
+  from->pool->refs++;
+  from->root = build_sorted(from, keys, n);
+  from->finger = NULL;
+  refresh_extremes(from);
+  free(keys);
 }
 
-// remove node를 child로 대체하는 함수
-node_t *replace_to_child(rbtree *tree, node_t *p, node_t *removed_node_parent)
+void rbtree_split(rbtree *tree, const key_t key, rbtree **lo, rbtree **hi)
 {
-  node_t *left_node = p->left;
-  node_t *right_node = p->right;
-  node_t *replace_node;
+  rbtree_settle_sizes(tree);
+  subtree_t lower, upper;
+  split_subtree(tree, make_subtree(tree, tree->root), SPLIT_BELOW, key, 0, &lower, &upper);
 
-  replace_node = right_node;
-  if (left_node != tree->nil)
-    replace_node = left_node;
+  *hi = new_rbtree_shared(tree);
+  set_root(*hi, upper);
+  set_root(tree, lower);
+  *lo = tree;
+}
 
-  if (is_node_left(p))
-    removed_node_parent->left = replace_node;
-  else
-    removed_node_parent->right = replace_node;
-  replace_node->parent = removed_node_parent;
-  free(p);
-  return replace_node;
+rbtree *rbtree_join(rbtree *left, const key_t key, rbtree *right)
+{
+  rbtree_settle_sizes(left);
+  rbtree_settle_sizes(right);
+  share_pool(left, right);
+  node_t *pivot = alloc_node(left);
+  pivot->key = key;
+  pivot->size = 1;
+  subtree_t joined = join_subtrees(left, make_subtree(left, left->root), pivot,
+                                   make_subtree(left, right->root));
+  set_root(left, joined);
+
+  right->root = right->nil;
+  delete_rbtree(right);
+  return left;
 }
 
-int rbtree_erase(rbtree *tree, node_t *p)
+typedef enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE } set_op_t;
+
+// 첫 번째, 두 번째 tree에 count1, count2개 있는 key를 결과에 몇 개 남길지 정하는 함수
+size_t set_op_count(set_op_t op, size_t count1, size_t count2)
 {
-  node_t *right_node = p->right;
-  node_t *left_node = p->left;
-  node_t *removed_node_parent, *successor_node, *replace_node;
+  if (op == SET_UNION)
+    return (count1 > count2) ? count1 : count2;
+  if (op == SET_INTERSECTION)
+    return (count1 < count2) ? count1 : count2;
+  return (count1 > count2) ? count1 - count2 : 0;
+}
 
-  int is_removed_black;
-  int is_left;
+// a의 root key로 b를 split해 양쪽을 재귀로 계산하고 join하는 함수
+// is_swapped면 a가 두 번째 tree이다. a가 작은 쪽이면 O(m log(n / m + 1))
+subtree_t set_op_subtree(rbtree *tree, set_op_t op, int is_swapped, subtree_t a, subtree_t b)
+{
+  if (a.root == tree->nil || b.root == tree->nil)
+  {
+    // 한쪽이 비면 남은 쪽은 전부 남거나 전부 지워진다
+    int is_a_left = (a.root != tree->nil);
+    subtree_t rest = is_a_left ? a : b;
+    int is_first = is_a_left != is_swapped;
+    if (set_op_count(op, is_first, !is_first) > 0)
+      return rest;
+    node_is_free(tree, rest.root, free_node);
+    return (subtree_t){tree->nil, 0};
+  }
+
+  node_t *pivot = a.root;
+  const key_t key = pivot->key;
+  const int child_bh = a.bh - (pivot->color == RBTREE_BLACK);
+  pivot->size = rbtree_node_count(pivot);
+  subtree_t a_left = {pivot->left, child_bh}, a_right = {pivot->right, child_bh};
+  set_parent(tree, a_left.root, tree->nil);
+  set_parent(tree, a_right.root, tree->nil);
+
+  // 같은 key가 a의 양쪽 subtree 끝에 더 있을 수 있으므로 pivot과 함께 모은다
+  subtree_t run_left = {tree->nil, 0}, run_right = {tree->nil, 0};
+  node_t *p = a_left.root;
+  while (p != tree->nil && p->right != tree->nil)
+    p = p->right;
+  if (p != tree->nil && p->key == key)
+    split_subtree(tree, a_left, SPLIT_BELOW, key, 0, &a_left, &run_left);
+  p = a_right.root;
+  while (p != tree->nil && p->left != tree->nil)
+    p = p->left;
+  if (p != tree->nil && p->key == key)
+    split_subtree(tree, a_right, SPLIT_UP_TO, key, 0, &run_right, &a_right);
+  subtree_t b_left, b_run = {tree->nil, 0}, b_right;
+  split_subtree(tree, b, SPLIT_BELOW, key, 0, &b_left, &b_right);
+  p = b_right.root;
+  while (p != tree->nil && p->left != tree->nil)
+    p = p->left;
+  if (p != tree->nil && p->key == key)
+    split_subtree(tree, b_right, SPLIT_UP_TO, key, 0, &b_run, &b_right);
 
-  // 삭제할 노드가 자식이 둘인 경우
-  if (right_node != tree->nil && left_node != tree->nil)
+  // key를 남길 개수만큼만 run에 두고 나머지 node는 해제
+  const size_t count_a = run_left.root->size + pivot->size + run_right.root->size;
+  const size_t count_b = b_run.root->size;
+  const size_t keep = is_swapped ? set_op_count(op, count_b, count_a) : set_op_count(op, count_a, count_b);
+  subtree_t run = {tree->nil, 0};
+  if (tree->counted)
   {
-    successor_node = get_successor(tree, p);
-    is_left = is_node_left(successor_node);
-    is_removed_black = successor_node->color ? 1 : 0;
-    removed_node_parent = successor_node->parent;
-    replace_node = replace_to_successor(tree, p, successor_node, removed_node_parent);
-    free(successor_node);
+    // counted mode에서는 pivot 하나에 개수를 모두 싣는다
+    node_is_free(tree, run_left.root, free_node);
+    node_is_free(tree, run_right.root, free_node);
+    node_is_free(tree, b_run.root, free_node);
+    if (keep == 0)
+      free_node(tree, pivot);
+    else
+    {
+      pivot->left = pivot->right = tree->nil;
+      pivot->size = keep;
+      run = join_subtrees(tree, run, pivot, run);
+    }
   }
-  // 삭제할 노드가 자식이 하나거나 없는 경우
-  else if (right_node == tree->nil || left_node == tree->nil)
+  else
   {
-    if (p == tree->root)
+    run = join_subtrees(tree, run_left, pivot, run_right);
+    run = join_two(tree, run, b_run);
+    if (keep < run.root->size)
     {
-      tree->root = (left_node == tree->nil) ? right_node : left_node;
-      tree->root->color = RBTREE_BLACK;
-      free(p);
-      return 0;
+      subtree_t dropped;
+      split_subtree(tree, run, SPLIT_RANK, key, keep, &run, &dropped);
+      node_is_free(tree, dropped.root, free_node);
     }
-    is_left = is_node_left(p);
-    is_removed_black = p->color ? 1 : 0;
-    removed_node_parent = p->parent;
-    replace_node = replace_to_child(tree, p, removed_node_parent);
   }
-  if (is_removed_black && replace_node->color == RBTREE_RED)
+
+  subtree_t left = set_op_subtree(tree, op, is_swapped, a_left, b_left);
+  subtree_t right = set_op_subtree(tree, op, is_swapped, a_right, b_right);
+  return join_three(tree, left, run, right);
+}
+
+// 작은 쪽이 이 비율보다 작으면 union은 key를 하나씩 넣는 편이 빠르다 (bench-split 기준)
+#define UNION_MIN_SPLIT_RATIO 256
+
+// other에 있는 key 중 tree에 부족한 개수만큼 tree에 넣는 함수 (union의 작은 입력용)
+void union_by_insert(rbtree *tree, const rbtree *other)
+{
+  node_t *p = rbtree_iter_begin(other);
+  while (p != NULL)
   {
-    replace_node->color = RBTREE_BLACK;
-    return 0;
+    const key_t key = p->key;
+    size_t count = 0;
+    for (; p != NULL && p->key == key; p = rbtree_iter_next(other, p))
+      count += rbtree_node_count(p);
+
+    size_t present = 0;
+    for (node_t *q = rbtree_lower_bound(tree, key); q != NULL && q->key == key && present < count;
+         q = rbtree_iter_next(tree, q))
+      present += rbtree_node_count(q);
+    if (present >= count)
+      continue;
+    if (tree->counted)
+    {
+      // 한 번 넣은 node에 나머지 개수를 한꺼번에 더한다
+      node_t *q = rbtree_insert(tree, key);
+      grow_size_to_root(tree, q, count - present - 1);
+    }
+    else
+      for (; present < count; present++)
+        rbtree_insert(tree, key);
   }
-  else if (is_removed_black && replace_node->color == RBTREE_BLACK)
-    rbtree_erase_fixup(tree, removed_node_parent, is_left);
-  return 0;
+}
+
+// 작은 tree의 root부터 나누며 집합 연산을 하고 결과를 tree1에 담는 함수
+rbtree *set_operation(rbtree *tree1, rbtree *tree2, set_op_t op)
+{
+  rbtree_settle_sizes(tree1);
+  rbtree_settle_sizes(tree2);
+  share_pool(tree1, tree2);
+  const int is_swapped = rbtree_size(tree2) < rbtree_size(tree1);
+  rbtree *small = is_swapped ? tree2 : tree1;
+  rbtree *large = is_swapped ? tree1 : tree2;
+
+  subtree_t result;
+  if (op == SET_UNION && rbtree_size(small) * UNION_MIN_SPLIT_RATIO < rbtree_size(large))
+  {
+    union_by_insert(large, small);
+    node_is_free(small, small->root, free_node);
+    result = (subtree_t){large->root, 0};
+  }
+  else
+    result = set_op_subtree(tree1, op, is_swapped, make_subtree(tree1, small->root),
+                            make_subtree(tree1, large->root));
+
+  tree2->root = tree2->nil;
+  set_root(tree1, result);
+  delete_rbtree(tree2);
+  return tree1;
+}
+
+rbtree *rbtree_union(rbtree *tree1, rbtree *tree2)
+{
+  return set_operation(tree1, tree2, SET_UNION);
+}
+
+rbtree *rbtree_intersection(rbtree *tree1, rbtree *tree2)
+{
+  return set_operation(tree1, tree2, SET_INTERSECTION);
+}
+
+rbtree *rbtree_difference(rbtree *tree1, rbtree *tree2)
+{
+  return set_operation(tree1, tree2, SET_DIFFERENCE);
+}
+
+node_t *rbtree_iter_begin(const rbtree *tree)
+{
+  return (tree->root != tree->nil) ? rbtree_min(tree) : NULL;
+}
+
+node_t *rbtree_iter_end(const rbtree *tree)
+{
+  (void)tree;
+  return NULL;
+}
+
+node_t *rbtree_iter_next(const rbtree *tree, node_t *p)
+{
+  if (p == NULL)
+    return NULL;
+  node_t *next_node = get_successor(tree, p);
+  return (next_node != tree->nil) ? next_node : NULL;
+}
+
+// end(NULL)에서 prev를 부르면 마지막 노드부터 역순으로 순회할 수 있다
+node_t *rbtree_iter_prev(const rbtree *tree, node_t *p)
+{
+  if (p == NULL)
+    return (tree->root != tree->nil) ? rbtree_max(tree) : NULL;
+  node_t *prev_node = get_predecessor(tree, p);
+  return (prev_node != tree->nil) ? prev_node : NULL;
+}
+
+// key 이상인 첫 노드를 찾는 함수 (중복 key가 있으면 inorder 상 가장 앞의 노드)
+node_t *rbtree_lower_bound(const rbtree *tree, const key_t key)
+{
+  node_t *bound = core_lower_bound(tree, key);
+  return (bound != tree->nil) ? bound : NULL;
 }
 
 int rbtree_to_array(const rbtree *tree, key_t *arr, const size_t n)
 {
-  node_t *current_node = rbtree_min(tree);
+  rbtree_cursor_t cursor;
+  rbtree_cursor_begin(tree, &cursor);
+  rbtree_cursor_read(tree, &cursor, arr, n);
+  return 0;
+}
+
+void rbtree_cursor_begin(const rbtree *tree, rbtree_cursor_t *cursor)
+{
+  cursor->next = rbtree_iter_begin(tree);
+  cursor->done = 0;
+}
+
+// cursor가 가리키는 곳부터 최대 n개의 key를 buf에 채우고 다음 위치를 cursor에 남기는 함수
+size_t rbtree_cursor_read(const rbtree *tree, rbtree_cursor_t *cursor, key_t *buf, const size_t n)
+{
+  size_t i = 0;
+  node_t *p = cursor->next;
+  if (tree->counted)
+  {
+    // node마다 개수만큼 key를 펼치고, 중간에 멈추면 펼친 개수를 기억한다
+    size_t done = cursor->done;
+    while (p != NULL && i < n)
+    {
+      const size_t count = rbtree_node_count(p);
+      for (; done < count && i < n; done++)
+        buf[i++] = p->key;
+      if (done < count)
+        break;
+      p = rbtree_iter_next(tree, p);
+      done = 0;
+    }
+    cursor->done = done;
+  }
+  else
+  {
+    for (; p != NULL && i < n; p = rbtree_iter_next(tree, p))
+      buf[i++] = p->key;
+  }
+  cursor->next = p;
+  return i;
+}
 
-  arr[0] = current_node->key;
-  for (int i = 1; i < n; i++)
+// rbtree_write_fd가 한 번에 write하는 key 개수 (64KB)
+#define EXPORT_BLOCK_KEYS 16384
+
+// buf의 len byte를 fd에 모두 쓰는 함수 (짧은 write와 signal에 의한 중단은 이어서 쓴다)
+int write_all(int fd, const char *buf, size_t len)
+{
+  while (len > 0)
   {
-    if (current_node == tree->nil)
-      break;
-    current_node = get_successor(tree, current_node);
-    if (current_node == tree->nil)
-      break;
-    arr[i] = current_node->key;
+    const ssize_t written = write(fd, buf, len);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += written;
+    len -= (size_t)written;
   }
   return 0;
 }
+
+int rbtree_write_fd(const rbtree *tree, int fd)
+{
+  key_t *block = (key_t *)malloc(EXPORT_BLOCK_KEYS * sizeof(key_t));
+  if (block == NULL)
+    return -1;
+
+  rbtree_cursor_t cursor;
+  rbtree_cursor_begin(tree, &cursor);
+  int result = 0;
+  size_t n;
+  while (result == 0 && (n = rbtree_cursor_read(tree, &cursor, block, EXPORT_BLOCK_KEYS)) > 0)
+    result = write_all(fd, (const char *)block, n * sizeof(key_t));
+
+  free(block);
+  return result;
+}
+
+#ifdef RBTREE_STATS
+void rbtree_stats_reset(rbtree *tree)
+{
+  memset(&tree->stats, 0, sizeof(tree->stats));
+}
+
+void rbtree_stats_dump(const rbtree *tree, FILE *out)
+{
+  const rbtree_stats_t *stats = &tree->stats;
+  fprintf(out, "comparisons   %zu\n", stats->comparisons);
+  fprintf(out, "rotations     %zu\n", stats->rotations);
+  fprintf(out, "recolors      %zu\n", stats->recolors);
+  fprintf(out, "insert fixup  red uncle %zu, outer %zu, inner %zu\n", stats->insert_fixup[0],
+          stats->insert_fixup[1], stats->insert_fixup[2]);
+  fprintf(out, "erase fixup   red sibling %zu, red outer %zu, red inner %zu, black %zu\n",
+          stats->erase_fixup[0], stats->erase_fixup[1], stats->erase_fixup[2], stats->erase_fixup[3]);
+  fprintf(out, "max height    %zu\n", stats->max_height);
+}
+#endif
@@ -11,22 +11,194 @@ typedef struct node_t {
   color_t color;
   key_t key;
   struct node_t *parent, *left, *right;
+  size_t size;  // number of keys in this subtree (0 for nil)
 } node_t;
 
+// fixed-size slab chunk that a tree carves its nodes out of
+typedef struct node_chunk_t {
+  struct node_chunk_t *next;
+  size_t capacity, used;
+  node_t nodes[];
+} node_chunk_t;
+
+// node storage. Every tree uses the same read-only nil, so nodes can move
+// between trees as they are; the pool only decides who frees them. Split and
+// join on one pool never copy, and a pool with a single tree can be merged
+// into another one in O(1).
+typedef struct {
+  node_chunk_t *chunks;      // slab chunk list (head is the bump chunk)
+  node_chunk_t *last_chunk;  // tail of chunks
+  node_t *free_list;         // erased nodes, linked through ->right
+  node_t *free_tail;         // tail of free_list (stale when it is empty)
+  size_t refs;               // trees using the pool
+} rbtree_pool_t;
+
+#ifdef RBTREE_STATS
+#include <stdio.h>
+
+// per-tree counters, only compiled in with -DRBTREE_STATS (the default build
+// has neither the field nor the increments). Not atomic: concurrent readers
+// of one tree make the find counts approximate.
+typedef struct {
+  size_t comparisons;      // nodes compared against by descents
+  size_t rotations;
+  size_t recolors;         // color changes made by rebalancing
+  size_t insert_fixup[3];  // red uncle, outer (1 rotation), inner (2)
+  size_t erase_fixup[4];   // red sibling, red outer / inner nephew, black
+  size_t max_height;       // deepest node an insert has created
+} rbtree_stats_t;
+#endif
+
 typedef struct {
   node_t *root;
-  node_t *nil;  // for sentinel
+  node_t *nil;  // sentinel shared by every tree, read-only
+  rbtree_pool_t *pool;
+  int counted;  // see new_rbtree_counted
+  node_t *finger;  // last inserted node, see rbtree_insert_hint
+  // nodes rbtree_insert_hint has linked without growing their ancestors'
+  // sizes (plain trees only), see rbtree_settle_sizes
+  node_t **unsized;
+  size_t unsized_count, unsized_capacity;
+  node_t *leftmost, *rightmost;  // min and max node (nil when empty)
+  // if set, erased nodes are handed here instead of being freed; the owner
+  // gives them back with rbtree_release_node once nobody can reach them
+  void (*retire)(void *, node_t *);
+  void *retire_ctx;
+#ifdef RBTREE_STATS
+  rbtree_stats_t stats;
+#endif
 } rbtree;
 
 rbtree *new_rbtree(void);
+// empty tree on the same pool as the given one; trees on one pool must not
+// be modified from different threads at the same time
+rbtree *new_rbtree_shared(rbtree *);
 void delete_rbtree(rbtree *);
 
+// counted mode: one node per distinct key with a multiplicity. insert of a
+// key that is already there bumps its count and returns the existing node,
+// erase drops one copy and frees the node with the last one. Sizes, ranks,
+// select, ranges and to_array count every copy. The count is not stored
+// separately, it is size minus the children's sizes, so nodes stay as small
+// as in a plain tree. A join can leave one key in two neighbouring nodes.
+rbtree *new_rbtree_counted(void);
+// copies of p->key held by p (always 1 in a plain tree)
+size_t rbtree_node_count(const node_t *);
+
+// O(n) bulk build into one contiguous chunk; from_array sorts a copy first
+rbtree *rbtree_from_sorted_array(const key_t *, const size_t);
+rbtree *rbtree_from_array(const key_t *, const size_t);
+// O(total) build from m strictly ascending keys where keys[i] occurs
+// prefix[i + 1] - prefix[i] times (prefix[0] == 0; NULL means once each).
+// A counted tree gets one node per key, a plain tree one node per copy.
+rbtree *rbtree_from_sorted_runs(const key_t *, const size_t *, const size_t,
+                                const int);
+
+void rbtree_release_node(rbtree *, node_t *);
+// n uninitialized nodes in one block of the tree's pool, for builders that
+// link the nodes themselves (see rbtree_par.h). With RBTREE_MALLOC_NODES it
+// returns NULL and every node must be malloc'd on its own.
+node_t *rbtree_reserve_nodes(rbtree *, const size_t);
+
 node_t *rbtree_insert(rbtree *, const key_t);
 node_t *rbtree_find(const rbtree *, const key_t);
+// out[i] = rbtree_find(tree, keys[i]) for a whole batch
+void rbtree_find_many(const rbtree *, const key_t *, const size_t, node_t **);
+// O(1): insert and erase keep the two end nodes cached
 node_t *rbtree_min(const rbtree *);
 node_t *rbtree_max(const rbtree *);
+// erase relinks the successor into p's place instead of copying its key, so a
+// node_t * stays valid and keeps its key until that node itself is erased.
+// Rebalancing, split and join move nodes whole as well, except for the
+// copying case of a join across pools described below.
 int rbtree_erase(rbtree *, node_t *);
+// erase one copy of the min / max key and store it in *key (if not NULL);
+// 0 on success, -1 if the tree is empty. The end node has at most one child,
+// so this skips the successor search and fixes colors from its parent.
+int rbtree_pop_min(rbtree *, key_t *);
+int rbtree_pop_max(rbtree *, key_t *);
+
+// finger search: start from a node of the tree near key instead of the root
+// (NULL means the last inserted node). They climb only as far as the lowest
+// ancestor whose key range holds key, so comparisons are O(log d) for a key
+// d places away in a typical tree, and O(1) past either end. In a plain tree
+// insert_hint does not walk to the root to grow the subtree sizes either: the
+// new node counts 0 in them until the sizes are settled, and rotations keep
+// that consistent. Ascending inserts with a NULL hint are amortized O(1)
+// apart from the rebalancing. A counted tree still grows the sizes at once.
+node_t *rbtree_insert_hint(rbtree *, node_t *, const key_t);
+node_t *rbtree_find_from(const rbtree *, node_t *, const key_t);
+
+// adds the nodes insert_hint left out back into the subtree sizes, either
+// one path to the root per node or, once that would cost more, in one O(n)
+// pass. Order statistics, erase, split, join, the set operations and
+// rbtree_par_to_array call it first, so only code that reads node sizes
+// itself needs to. It writes the sizes even through a const tree, so call it before
+// sharing a tree between reader threads.
+void rbtree_settle_sizes(const rbtree *);
 
 int rbtree_to_array(const rbtree *, key_t *, const size_t);
 
+// resumable export: each read copies the next keys in order into the buffer
+// and returns how many it wrote (0 once everything has been read). A cursor
+// stays valid between reads as long as the tree is not modified.
+typedef struct {
+  node_t *next;  // node the next read starts at (NULL at the end)
+  size_t done;   // copies of next->key already read (counted mode)
+} rbtree_cursor_t;
+
+void rbtree_cursor_begin(const rbtree *, rbtree_cursor_t *);
+size_t rbtree_cursor_read(const rbtree *, rbtree_cursor_t *, key_t *,
+                          const size_t);
+// streams every key to fd as raw key_t values in large blocks, without
+// building the whole array; 0 on success, -1 with errno set if a write fails
+int rbtree_write_fd(const rbtree *, int);
+
+// order statistics, all O(log n); ranks count keys strictly below key and
+// ranges are half-open [lo, hi)
+size_t rbtree_size(const rbtree *);
+size_t rbtree_rank(const rbtree *, const key_t);
+node_t *rbtree_select(const rbtree *, const size_t);
+size_t rbtree_count_range(const rbtree *, const key_t, const key_t);
+
+// range operations on [lo, hi), both O(log n + k) and returning the number
+// of nodes visited / keys erased. visit gets every node in order until it
+// returns nonzero and must not modify the tree. erase_range splits the tree at
+// lo and hi, drops the middle part as a whole and joins the rest (a handful
+// of keys are simply erased one by one).
+size_t rbtree_foreach_range(const rbtree *, const key_t, const key_t,
+                            int (*)(node_t *, void *), void *);
+size_t rbtree_erase_range(rbtree *, const key_t, const key_t);
+
+// O(log n) partitioning without copying nodes. split leaves the keys below
+// key in tree (*lo == tree) and moves the rest to a new tree on the same
+// pool. join links left, a new pivot node and right (left keys <= pivot <=
+// right keys) into left, frees the right struct and returns left. If the
+// trees are on different pools and one of them is the only tree on its pool,
+// that pool is merged into the other and the join stays O(log n). If both
+// pools have other trees on them (from split or new_rbtree_shared), the
+// smaller tree's keys are copied into the other pool first, in O(min(m, n)).
+// The set operations below share pools the same way.
+void rbtree_split(rbtree *, const key_t, rbtree **, rbtree **);
+rbtree *rbtree_join(rbtree *, const key_t, rbtree *);
+
+// set operations in O(m log(n / m + 1)) for sizes m <= n. They consume both
+// trees and return the result in one of them. With duplicates a key is kept
+// max(c1, c2), min(c1, c2) or max(c1 - c2, 0) times (as std::set_union etc.)
+rbtree *rbtree_union(rbtree *, rbtree *);
+rbtree *rbtree_intersection(rbtree *, rbtree *);
+rbtree *rbtree_difference(rbtree *, rbtree *);
+
+// in-order iteration: end is NULL, prev(end) is the max node
+node_t *rbtree_iter_begin(const rbtree *);
+node_t *rbtree_iter_end(const rbtree *);
+node_t *rbtree_iter_next(const rbtree *, node_t *);
+node_t *rbtree_iter_prev(const rbtree *, node_t *);
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+
+#ifdef RBTREE_STATS
+void rbtree_stats_reset(rbtree *);
+void rbtree_stats_dump(const rbtree *, FILE *);
+#endif
+
 #endif  // _RBTREE_H_
@@ -0,0 +1,422 @@
+#include "rbtree_compact.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RED_BIT 0x80000000u
+#define INDEX_MASK 0x7fffffffu
+#define NIL 0u
+
+// 2^31개 미만의 노드로 만든 RB tree의 높이는 62를 넘지 않는다
+// (erase case 1에서 경로가 한 칸 늘어나는 것까지 여유를 둠)
+#define MAX_PATH 96
+
+static inline cnode_t *node_at(const compact_rbtree *tree, uint32_t x)
+{
+  return &tree->nodes[x];
+}
+
+static inline uint32_t index_of(const compact_rbtree *tree, const cnode_t *p)
+{
+  return (uint32_t)(p - tree->nodes);
+}
+
+static inline uint32_t child(const compact_rbtree *tree, uint32_t x, int dir)
+{
+  return tree->nodes[x].link[dir] & INDEX_MASK;
+}
+
+// color bit를 보존하면서 x의 dir 방향 자식을 c로 바꾸는 함수
+static inline void set_child(compact_rbtree *tree, uint32_t x, int dir, uint32_t c)
+{
+  tree->nodes[x].link[dir] = (tree->nodes[x].link[dir] & RED_BIT) | c;
+#ifdef RBTREE_COMPACT_PARENT
+  tree->nodes[c].parent = x;
+#endif
+}
+
+static inline int is_red(const compact_rbtree *tree, uint32_t x)
+{
+  return (tree->nodes[x].link[0] & RED_BIT) != 0;
+}
+
+static inline void set_red(compact_rbtree *tree, uint32_t x)
+{
+  tree->nodes[x].link[0] |= RED_BIT;
+}
+
+static inline void set_black(compact_rbtree *tree, uint32_t x)
+{
+  tree->nodes[x].link[0] &= INDEX_MASK;
+}
+
+// path[depth - 1]의 dirs[depth - 1] 자리 (depth가 0이면 root)를 x로 바꾸는 함수
+static inline void replace_at(compact_rbtree *tree, const uint32_t *path, const int *dirs, int depth, uint32_t x)
+{
+  if (depth == 0)
+  {
+    tree->root = x;
+#ifdef RBTREE_COMPACT_PARENT
+    tree->nodes[x].parent = NIL;
+#endif
+  }
+  else
+    set_child(tree, path[depth - 1], dirs[depth - 1], x);
+}
+
+// x를 dir 방향으로 회전하고 새 subtree root를 돌려주는 함수 (부모와의 연결은 호출하는 쪽에서)
+static uint32_t rotate(compact_rbtree *tree, uint32_t x, int dir)
+{
+  uint32_t y = child(tree, x, !dir);
+  set_child(tree, x, !dir, child(tree, y, dir));
+  set_child(tree, y, dir, x);
+  return y;
+}
+
+compact_rbtree *new_compact_rbtree(void)
+{
+  compact_rbtree *tree = (compact_rbtree *)calloc(1, sizeof(compact_rbtree));
+  tree->capacity = 16;
+  tree->nodes = (cnode_t *)calloc(tree->capacity, sizeof(cnode_t));
+  tree->used = 1;
+  tree->root = NIL;
+  tree->free_list = NIL;
+  return tree;
+}
+
+void delete_compact_rbtree(compact_rbtree *tree)
+{
+  free(tree->nodes);
+  free(tree);
+}
+
+// free list나 배열 끝에서 slot 하나를 할당하는 함수 (배열이 꽉 차면 두 배로 늘림)
+static uint32_t alloc_slot(compact_rbtree *tree)
+{
+  uint32_t x = tree->free_list;
+  if (x != NIL)
+  {
+    tree->free_list = tree->nodes[x].link[1];
+    return x;
+  }
+
+  if (tree->used == tree->capacity)
+  {
+    uint32_t capacity = tree->capacity * 2;
+    if (capacity > INDEX_MASK || capacity < tree->capacity)
+      capacity = INDEX_MASK;
+    if (tree->used == capacity)
+      return NIL;
+    tree->nodes = (cnode_t *)realloc(tree->nodes, (size_t)capacity * sizeof(cnode_t));
+    tree->capacity = capacity;
+  }
+  return tree->used++;
+}
+
+cnode_t *compact_rbtree_insert(compact_rbtree *tree, const key_t key)
+{
+  uint32_t path[MAX_PATH];
+  int dirs[MAX_PATH];
+  int depth = 0;
+
+  // 삽입할 위치 찾기 (같은 key는 오른쪽으로)
+  uint32_t x = tree->root;
+  while (x != NIL)
+  {
+    path[depth] = x;
+    dirs[depth] = (node_at(tree, x)->key <= key);
+    x = child(tree, x, dirs[depth]);
+    depth++;
+  }
+
+  uint32_t new_node = alloc_slot(tree);
+  if (new_node == NIL)
+    return NULL;
+  cnode_t *node = node_at(tree, new_node);
+  node->key = key;
+  node->link[0] = NIL | RED_BIT;
+  node->link[1] = NIL;
+  replace_at(tree, path, dirs, depth, new_node);
+  tree->count++;
+
+  // 삽입 이후 리밸런싱: path[depth]가 red인 현재 노드
+  path[depth] = new_node;
+  while (depth >= 2 && is_red(tree, path[depth - 1]))
+  {
+    uint32_t parent = path[depth - 1];
+    uint32_t grand_parent = path[depth - 2];
+    int parent_dir = dirs[depth - 2];
+    uint32_t uncle = child(tree, grand_parent, !parent_dir);
+
+    if (is_red(tree, uncle))
+    {
+      set_black(tree, parent);
+      set_black(tree, uncle);
+      set_red(tree, grand_parent);
+      depth -= 2;
+      continue;
+    }
+
+    // 안쪽 자식이면 parent를 돌려 바깥쪽으로 만든다
+    if (dirs[depth - 1] != parent_dir)
+    {
+      parent = rotate(tree, parent, parent_dir);
+      set_child(tree, grand_parent, parent_dir, parent);
+    }
+    uint32_t top = rotate(tree, grand_parent, !parent_dir);
+    replace_at(tree, path, dirs, depth - 2, top);
+    set_black(tree, top);
+    set_red(tree, grand_parent);
+    break;
+  }
+  set_black(tree, tree->root);
+
+  return node_at(tree, new_node);
+}
+
+cnode_t *compact_rbtree_find(const compact_rbtree *tree, const key_t key)
+{
+  uint32_t x = tree->root;
+  while (x != NIL)
+  {
+    const cnode_t *node = node_at(tree, x);
+    if (key == node->key)
+      return node_at(tree, x);
+    x = child(tree, x, key > node->key);
+  }
+  return NULL;
+}
+
+cnode_t *compact_rbtree_min(const compact_rbtree *tree)
+{
+  uint32_t x = tree->root;
+  if (x == NIL)
+    return NULL;
+  while (child(tree, x, 0) != NIL)
+    x = child(tree, x, 0);
+  return node_at(tree, x);
+}
+
+cnode_t *compact_rbtree_max(const compact_rbtree *tree)
+{
+  uint32_t x = tree->root;
+  if (x == NIL)
+    return NULL;
+  while (child(tree, x, 1) != NIL)
+    x = child(tree, x, 1);
+  return node_at(tree, x);
+}
+
+// key와 같은 key 중 inorder 상 가장 앞의 node까지의 경로를 path에 채우고
+// 길이(그 node 포함)를 돌려주는 함수 (없으면 -1)
+// 같은 key는 양쪽 subtree에 흩어질 수 있으므로 lower_bound처럼 내려가며 마지막으로 만난 같은 key를 기억한다
+static int find_path(const compact_rbtree *tree, key_t key, uint32_t *path, int *dirs)
+{
+  int depth = 0, found = -1;
+  uint32_t x = tree->root;
+  while (x != NIL)
+  {
+    key_t node_key = node_at(tree, x)->key;
+    path[depth] = x;
+    if (key == node_key)
+      found = depth + 1;
+    dirs[depth] = (node_key < key);
+    x = child(tree, x, dirs[depth]);
+    depth++;
+  }
+  return found;
+}
+
+int compact_rbtree_erase(compact_rbtree *tree, cnode_t *p)
+{
+  uint32_t path[MAX_PATH];
+  int dirs[MAX_PATH];
+  int depth = find_path(tree, p->key, path, dirs);
+  if (depth < 0)
+    return -1;
+  uint32_t target = path[depth - 1];
+  p = node_at(tree, target);
+
+  // 자식이 둘이면 successor의 key를 옮기고 successor를 대신 삭제
+  uint32_t removed = target;
+  if (child(tree, target, 0) != NIL && child(tree, target, 1) != NIL)
+  {
+    dirs[depth - 1] = 1;
+    removed = child(tree, target, 1);
+    path[depth++] = removed;
+    while (child(tree, removed, 0) != NIL)
+    {
+      dirs[depth - 1] = 0;
+      removed = child(tree, removed, 0);
+      path[depth++] = removed;
+    }
+    p->key = node_at(tree, removed)->key;
+  }
+
+  // removed는 자식이 하나 이하: 그 자식으로 대체
+  depth--;
+  uint32_t replace_node = child(tree, removed, child(tree, removed, 0) == NIL);
+  int is_removed_black = !is_red(tree, removed);
+  replace_at(tree, path, dirs, depth, replace_node);
+
+  node_at(tree, removed)->link[1] = tree->free_list;
+  tree->free_list = removed;
+  tree->count--;
+
+  if (!is_removed_black)
+    return 0;
+  if (is_red(tree, replace_node))
+  {
+    set_black(tree, replace_node);
+    return 0;
+  }
+
+  // erase 리밸런싱: path[i]의 dir 방향에 extra black이 있다
+  int i = depth - 1;
+  while (i >= 0)
+  {
+    uint32_t parent = path[i];
+    int dir = dirs[i];
+    uint32_t sibling = child(tree, parent, !dir);
+
+    if (is_red(tree, sibling))
+    {
+      set_black(tree, sibling);
+      set_red(tree, parent);
+      replace_at(tree, path, dirs, i, rotate(tree, parent, dir));
+      // sibling이 parent 위로 올라왔으므로 경로에 끼워 넣는다
+      path[i] = sibling;
+      dirs[i] = dir;
+      path[i + 1] = parent;
+      dirs[i + 1] = dir;
+      i++;
+      sibling = child(tree, parent, !dir);
+    }
+
+    if (!is_red(tree, child(tree, sibling, 0)) && !is_red(tree, child(tree, sibling, 1)))
+    {
+      set_red(tree, sibling);
+      if (is_red(tree, parent))
+      {
+        set_black(tree, parent);
+        break;
+      }
+      i--;
+      continue;
+    }
+
+    if (!is_red(tree, child(tree, sibling, !dir)))
+    {
+      set_black(tree, child(tree, sibling, dir));
+      set_red(tree, sibling);
+      sibling = rotate(tree, sibling, !dir);
+      set_child(tree, parent, !dir, sibling);
+    }
+
+    if (is_red(tree, parent))
+      set_red(tree, sibling);
+    else
+      set_black(tree, sibling);
+    set_black(tree, parent);
+    set_black(tree, child(tree, sibling, !dir));
+    replace_at(tree, path, dirs, i, rotate(tree, parent, dir));
+    break;
+  }
+  set_black(tree, tree->root);
+  return 0;
+}
+
+int compact_rbtree_to_array(const compact_rbtree *tree, key_t *arr, const size_t n)
+{
+  uint32_t stack[MAX_PATH];
+  int top = 0;
+  size_t i = 0;
+  uint32_t x = tree->root;
+
+  while (i < n && (x != NIL || top > 0))
+  {
+    while (x != NIL)
+    {
+      stack[top++] = x;
+      x = child(tree, x, 0);
+    }
+    x = stack[--top];
+    arr[i++] = node_at(tree, x)->key;
+    x = child(tree, x, 1);
+  }
+  return 0;
+}
+
+size_t compact_rbtree_size(const compact_rbtree *tree)
+{
+  return tree->count;
+}
+
+cnode_t *compact_rbtree_lower_bound(const compact_rbtree *tree, const key_t key)
+{
+  uint32_t x = tree->root;
+  uint32_t bound = NIL;
+  while (x != NIL)
+  {
+    if (node_at(tree, x)->key >= key)
+    {
+      bound = x;
+      x = child(tree, x, 0);
+    }
+    else
+      x = child(tree, x, 1);
+  }
+  return (bound != NIL) ? node_at(tree, bound) : NULL;
+}
+
+size_t compact_rbtree_memory(const compact_rbtree *tree)
+{
+  return sizeof(compact_rbtree) + (size_t)tree->capacity * sizeof(cnode_t);
+}
+
+#ifdef RBTREE_COMPACT_PARENT
+// dir 방향으로 inorder 다음 노드를 찾는 함수 (dir이 1이면 successor)
+static uint32_t step(const compact_rbtree *tree, uint32_t x, int dir)
+{
+  if (child(tree, x, dir) != NIL)
+  {
+    x = child(tree, x, dir);
+    while (child(tree, x, !dir) != NIL)
+      x = child(tree, x, !dir);
+    return x;
+  }
+  uint32_t parent = node_at(tree, x)->parent;
+  while (parent != NIL && child(tree, parent, dir) == x)
+  {
+    x = parent;
+    parent = node_at(tree, x)->parent;
+  }
+  return parent;
+}
+
+cnode_t *compact_rbtree_iter_begin(const compact_rbtree *tree)
+{
+  return compact_rbtree_min(tree);
+}
+
+cnode_t *compact_rbtree_iter_end(const compact_rbtree *tree)
+{
+  return NULL;
+}
+
+cnode_t *compact_rbtree_iter_next(const compact_rbtree *tree, cnode_t *p)
+{
+  if (p == NULL)
+    return NULL;
+  uint32_t x = step(tree, index_of(tree, p), 1);
+  return (x != NIL) ? node_at(tree, x) : NULL;
+}
+
+cnode_t *compact_rbtree_iter_prev(const compact_rbtree *tree, cnode_t *p)
+{
+  if (p == NULL)
+    return compact_rbtree_max(tree);
+  uint32_t x = step(tree, index_of(tree, p), 0);
+  return (x != NIL) ? node_at(tree, x) : NULL;
+}
+#endif
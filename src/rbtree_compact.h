@@ -0,0 +1,61 @@
+#ifndef _RBTREE_COMPACT_H_
+#define _RBTREE_COMPACT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// Compact variant of rbtree.h: nodes live in one array owned by the tree and
+// link to each other by 32-bit indices. Index 0 is the nil sentinel, and the
+// color is packed into the top bit of the left link, so a node is 12 bytes
+// (16 with -DRBTREE_COMPACT_PARENT, which also enables iter_next/iter_prev).
+//
+// The array grows by realloc, so a cnode_t * returned by insert/find/min/max
+// is only valid until the next insert.
+
+typedef struct {
+  uint32_t link[2];  // left, right; bit 31 of link[0] is set for red
+#ifdef RBTREE_COMPACT_PARENT
+  uint32_t parent;
+#endif
+  key_t key;
+} cnode_t;
+
+typedef struct {
+  cnode_t *nodes;      // nodes[0] is nil
+  uint32_t root;
+  uint32_t capacity;   // slots allocated in nodes
+  uint32_t used;       // slots handed out so far, including nil
+  uint32_t free_list;  // erased slots, linked through link[1]
+  size_t count;
+} compact_rbtree;
+
+compact_rbtree *new_compact_rbtree(void);
+void delete_compact_rbtree(compact_rbtree *);
+
+cnode_t *compact_rbtree_insert(compact_rbtree *, const key_t);
+cnode_t *compact_rbtree_find(const compact_rbtree *, const key_t);
+cnode_t *compact_rbtree_min(const compact_rbtree *);
+cnode_t *compact_rbtree_max(const compact_rbtree *);
+// removes one copy of p->key in O(log n): with duplicates it is the first copy
+// in order, not necessarily p (copies are interchangeable; erase moves keys
+// between slots anyway). -1 if the key is not in the tree.
+int compact_rbtree_erase(compact_rbtree *, cnode_t *);
+
+int compact_rbtree_to_array(const compact_rbtree *, key_t *, const size_t);
+
+size_t compact_rbtree_size(const compact_rbtree *);
+cnode_t *compact_rbtree_lower_bound(const compact_rbtree *, const key_t);
+
+// bytes owned by the tree, for memory-per-key reports
+size_t compact_rbtree_memory(const compact_rbtree *);
+
+#ifdef RBTREE_COMPACT_PARENT
+cnode_t *compact_rbtree_iter_begin(const compact_rbtree *);
+cnode_t *compact_rbtree_iter_end(const compact_rbtree *);
+cnode_t *compact_rbtree_iter_next(const compact_rbtree *, cnode_t *);
+cnode_t *compact_rbtree_iter_prev(const compact_rbtree *, cnode_t *);
+#endif
+
+#endif  // _RBTREE_COMPACT_H_
@@ -0,0 +1,441 @@
+// Red-black rebalancing template shared by rbtree.c and rbtree_intrusive.c.
+// Define the parameters and include this header once per instantiation:
+//
+//   #define RBCORE_NAME link_core                 // prefix of every name
+//   #define RBCORE_TREE intrusive_rbtree          // passed to every function
+//   #define RBCORE_NODE rbtree_link_t             // parent, left, right, color
+//   #define RBCORE_ROOT(tree) ((tree)->root)      // lvalue of the root
+//   #define RBCORE_NIL(tree) ((tree)->nil)        // optional: sentinel leaf
+//   #define RBCORE_STORE(x, v) ((x) = (v))        // optional: link and root stores
+//   #define RBCORE_STAT(tree, field, n) ...       // optional: rbtree_stats_t counts
+//   #include "rbtree_core.h"
+//
+// This defines static inline functions link_core_left_rotate,
+// link_core_right_rotate, link_core_insert_fixup, link_core_erase_fixup and
+// link_core_erase. Leaves are NULL unless RBCORE_NIL names a black sentinel.
+// The sentinel is only read, never written, so one sentinel can be shared by
+// every tree. Linking a new node is left to the caller, which has done the
+// descent anyway. Colors are the color_t of rbtree.h, included beforehand.
+//
+// Augmentation follows the kernel's rb_augment_callbacks. A node can cache a
+// value computed from its subtree (a size, the max end of an interval, ...)
+// and the tree keeps it up to date through three optional hooks:
+//
+//   RBCORE_AUGMENT_ROTATE(tree, old, new)       // new was rotated above old:
+//                                               // new takes old's value and
+//                                               // old is recomputed
+//   RBCORE_AUGMENT_COPY(tree, old, new)         // erase moves new into old's
+//                                               // place: new takes its value
+//   RBCORE_AUGMENT_PROPAGATE(tree, node, stop)  // recompute node and its
+//                                               // ancestors below stop
+//
+// Insert only rotates, so the caller brings the new node's ancestors up to
+// date before calling insert_fixup. Erase copies and propagates along the
+// path it relinks, and its fixup only rotates.
+//
+// With a key type the template also generates the ordered descents, so a
+// tree instantiated for any key compares inline with no function pointer:
+//
+//   #define RBCORE_KEY_T key_t                     // key type
+//   #define RBCORE_KEY(p) ((p)->key)               // key of a node
+//   #define RBCORE_CMP(a, b) ...                   // optional: <0, 0, >0
+//   #define RBCORE_AUGMENT_DESCEND(tree, p, node)  // optional: an insert of
+//                                                  // node passes p on its way
+//                                                  // down
+//
+// This adds find, lower_bound, descend and link (link_core_find, ...). Both
+// searches return the leaf when nothing matches. Without RBCORE_CMP keys
+// are compared with == and <, which compiles to one compare per level; a
+// materialized three-way value would sit on the path of the child choice.
+// An insert is descend, then link, then insert_fixup: equal keys go right
+// so they keep insertion order, and the caller can update its own state (end
+// nodes, counts) in between. DESCEND lets a subtree size grow on the way
+// down, as the kernel's augmented insert does.
+
+#if !defined(RBCORE_NAME) || !defined(RBCORE_TREE) || !defined(RBCORE_NODE) || !defined(RBCORE_ROOT)
+#error "define RBCORE_NAME, RBCORE_TREE, RBCORE_NODE and RBCORE_ROOT before including rbtree_core.h"
+#endif
+
+// sentinel은 black이므로 색을 바로 읽고, NULL leaf면 먼저 확인한다
+#ifdef RBCORE_NIL
+#define RBCORE_IS_RED(tree, p) ((p)->color == RBTREE_RED)
+#else
+#define RBCORE_NIL(tree) NULL
+#define RBCORE_IS_RED(tree, p) ((p) != NULL && (p)->color == RBTREE_RED)
+#endif
+
+#ifndef RBCORE_STORE
+#define RBCORE_STORE(x, v) ((x) = (v))
+#endif
+
+#ifndef RBCORE_STAT
+#define RBCORE_STAT(tree, field, n) ((void)0)
+#endif
+
+#ifndef RBCORE_AUGMENT_ROTATE
+#define RBCORE_AUGMENT_ROTATE(tree, old, new) ((void)0)
+#endif
+
+#ifndef RBCORE_AUGMENT_COPY
+#define RBCORE_AUGMENT_COPY(tree, old, new) ((void)0)
+#endif
+
+#ifndef RBCORE_AUGMENT_PROPAGATE
+#define RBCORE_AUGMENT_PROPAGATE(tree, node, stop) ((void)0)
+#endif
+
+#define RBCORE_CAT(a, b) a##_##b
+#define RBCORE_XCAT(a, b) RBCORE_CAT(a, b)
+#define RBCORE_(name) RBCORE_XCAT(RBCORE_NAME, name)
+
+// p가 leaf가 아니면 p의 parent를 바꾸는 함수 (sentinel에는 쓰지 않는다)
+static inline void RBCORE_(set_parent)(RBCORE_TREE *tree, RBCORE_NODE *p, RBCORE_NODE *parent)
+{
+  (void)tree;
+  if (p != RBCORE_NIL(tree))
+    RBCORE_STORE(p->parent, parent);
+}
+
+// parent에서 old를 가리키던 link (parent가 leaf면 root)를 new로 바꾸는 함수
+static inline void RBCORE_(replace_child)(RBCORE_TREE *tree, RBCORE_NODE *parent, RBCORE_NODE *old,
+                                          RBCORE_NODE *new)
+{
+  if (parent == RBCORE_NIL(tree))
+    RBCORE_STORE(RBCORE_ROOT(tree), new);
+  else if (parent->left == old)
+    RBCORE_STORE(parent->left, new);
+  else
+    RBCORE_STORE(parent->right, new);
+  RBCORE_(set_parent)(tree, new, parent);
+}
+
+// x의 오른쪽 자식을 x 자리로 올리는 함수
+static inline void RBCORE_(left_rotate)(RBCORE_TREE *tree, RBCORE_NODE *x)
+{
+  RBCORE_NODE *y = x->right;
+  RBCORE_STAT(tree, rotations, 1);
+
+  RBCORE_STORE(x->right, y->left);
+  RBCORE_(set_parent)(tree, y->left, x);
+  RBCORE_(replace_child)(tree, x->parent, x, y);
+  RBCORE_STORE(y->left, x);
+  RBCORE_STORE(x->parent, y);
+  RBCORE_AUGMENT_ROTATE(tree, x, y);
+}
+
+// x의 왼쪽 자식을 x 자리로 올리는 함수
+static inline void RBCORE_(right_rotate)(RBCORE_TREE *tree, RBCORE_NODE *x)
+{
+  RBCORE_NODE *y = x->left;
+  RBCORE_STAT(tree, rotations, 1);
+
+  RBCORE_STORE(x->left, y->right);
+  RBCORE_(set_parent)(tree, y->right, x);
+  RBCORE_(replace_child)(tree, x->parent, x, y);
+  RBCORE_STORE(y->right, x);
+  RBCORE_STORE(x->parent, y);
+  RBCORE_AUGMENT_ROTATE(tree, x, y);
+}
+
+// 새로 건 red node에서 시작하는 insert 리밸런싱 함수 (red-red 충돌을 위로 올리며 반복)
+// 마지막에 red인 root를 black으로 바꿔 black height가 1 늘었으면 1을 반환
+static inline int RBCORE_(insert_fixup)(RBCORE_TREE *tree, RBCORE_NODE *node)
+{
+  while (RBCORE_IS_RED(tree, node->parent))
+  {
+    RBCORE_NODE *parent_node = node->parent;
+    RBCORE_NODE *grand_parent_node = parent_node->parent;  // red인 parent는 root가 아니므로 있다
+    const int parent_is_left = (grand_parent_node->left == parent_node);
+    RBCORE_NODE *uncle_node = parent_is_left ? grand_parent_node->right : grand_parent_node->left;
+
+    if (RBCORE_IS_RED(tree, uncle_node))
+    {
+      grand_parent_node->color = RBTREE_RED;
+      parent_node->color = RBTREE_BLACK;
+      uncle_node->color = RBTREE_BLACK;
+      RBCORE_STAT(tree, insert_fixup[0], 1);
+      RBCORE_STAT(tree, recolors, 3);
+      node = grand_parent_node;
+      continue;
+    }
+
+    // 안쪽 손자면 먼저 parent를 돌려 바깥쪽으로 만든다
+    if (parent_is_left && node == parent_node->right)
+    {
+      RBCORE_(left_rotate)(tree, parent_node);
+      parent_node = node;
+      RBCORE_STAT(tree, insert_fixup[2], 1);
+    }
+    else if (!parent_is_left && node == parent_node->left)
+    {
+      RBCORE_(right_rotate)(tree, parent_node);
+      parent_node = node;
+      RBCORE_STAT(tree, insert_fixup[2], 1);
+    }
+    else
+      RBCORE_STAT(tree, insert_fixup[1], 1);
+    parent_node->color = RBTREE_BLACK;
+    grand_parent_node->color = RBTREE_RED;
+    if (parent_is_left)
+      RBCORE_(right_rotate)(tree, grand_parent_node);
+    else
+      RBCORE_(left_rotate)(tree, grand_parent_node);
+    RBCORE_STAT(tree, recolors, 2);
+    break;
+  }
+  RBCORE_NODE *root = RBCORE_ROOT(tree);
+  const int is_root_red = root->color == RBTREE_RED;
+  root->color = RBTREE_BLACK;
+  RBCORE_STAT(tree, recolors, is_root_red);
+  return is_root_red;
+}
+
+// parent_node의 is_left 쪽 자식 자리에 extra black이 있을 때의 erase 리밸런싱 함수
+// (그 자리는 leaf일 수 있으므로 자식 대신 parent와 방향을 받는다)
+static inline void RBCORE_(erase_fixup)(RBCORE_TREE *tree, RBCORE_NODE *parent_node, int is_left)
+{
+  while (1)
+  {
+    RBCORE_NODE *sibling_node = is_left ? parent_node->right : parent_node->left;
+
+    if (RBCORE_IS_RED(tree, sibling_node))
+    {
+      sibling_node->color = RBTREE_BLACK;
+      parent_node->color = RBTREE_RED;
+      if (is_left)
+        RBCORE_(left_rotate)(tree, parent_node);
+      else
+        RBCORE_(right_rotate)(tree, parent_node);
+      RBCORE_STAT(tree, erase_fixup[0], 1);
+      RBCORE_STAT(tree, recolors, 2);
+      continue;
+    }
+
+    RBCORE_NODE *outside_child = is_left ? sibling_node->right : sibling_node->left;
+    RBCORE_NODE *inside_child = is_left ? sibling_node->left : sibling_node->right;
+    if (RBCORE_IS_RED(tree, outside_child))
+    {
+      sibling_node->color = parent_node->color;
+      parent_node->color = RBTREE_BLACK;
+      outside_child->color = RBTREE_BLACK;
+      if (is_left)
+        RBCORE_(left_rotate)(tree, parent_node);
+      else
+        RBCORE_(right_rotate)(tree, parent_node);
+      RBCORE_STAT(tree, erase_fixup[1], 1);
+      RBCORE_STAT(tree, recolors, 3);
+      return;
+    }
+
+    // 안쪽 조카만 red면 sibling을 돌려 바깥쪽 조카가 red인 경우로 만든다
+    if (RBCORE_IS_RED(tree, inside_child))
+    {
+      inside_child->color = RBTREE_BLACK;
+      sibling_node->color = RBTREE_RED;
+      if (is_left)
+        RBCORE_(right_rotate)(tree, sibling_node);
+      else
+        RBCORE_(left_rotate)(tree, sibling_node);
+      RBCORE_STAT(tree, erase_fixup[2], 1);
+      RBCORE_STAT(tree, recolors, 2);
+      continue;
+    }
+
+    sibling_node->color = RBTREE_RED;
+    RBCORE_STAT(tree, erase_fixup[3], 1);
+    RBCORE_STAT(tree, recolors, 1);
+    // 부모가 red면 extra black을 흡수하고 종료
+    if (parent_node->color == RBTREE_RED)
+    {
+      parent_node->color = RBTREE_BLACK;
+      RBCORE_STAT(tree, recolors, 1);
+      return;
+    }
+    if (parent_node == RBCORE_ROOT(tree))
+      return;
+    is_left = (parent_node->parent->left == parent_node);
+    parent_node = parent_node->parent;
+  }
+}
+
+// z를 tree에서 떼어내고 리밸런싱하는 함수
+// 자식이 둘이면 successor를 z 자리로 옮겨 걸므로 다른 node의 위치와 내용은 바뀌지 않는다
+static inline void RBCORE_(erase)(RBCORE_TREE *tree, RBCORE_NODE *z)
+{
+  RBCORE_NODE *nil = RBCORE_NIL(tree);
+  RBCORE_NODE *child, *parent_node;  // 빈 자리를 채운 node (leaf일 수 있다)와 그 parent
+  int is_left;
+  color_t removed_color;
+
+  if (z->left == nil || z->right == nil)
+  {
+    child = (z->left == nil) ? z->right : z->left;
+    parent_node = z->parent;
+    is_left = (parent_node != nil && parent_node->left == z);
+    removed_color = z->color;
+    RBCORE_(replace_child)(tree, parent_node, z, child);
+    RBCORE_AUGMENT_PROPAGATE(tree, parent_node, nil);
+  }
+  else
+  {
+    RBCORE_NODE *successor = z->right;
+    while (successor->left != nil)
+      successor = successor->left;
+    child = successor->right;
+    removed_color = successor->color;
+    if (successor->parent == z)
+    {
+      // z의 오른쪽 자식이면 successor의 오른쪽이 그대로 빈 자리가 된다
+      parent_node = successor;
+      is_left = 0;
+      RBCORE_AUGMENT_COPY(tree, z, successor);
+    }
+    else
+    {
+      // 더 아래의 successor는 항상 부모의 왼쪽 자식이다
+      parent_node = successor->parent;
+      is_left = 1;
+      RBCORE_STORE(parent_node->left, child);
+      RBCORE_(set_parent)(tree, child, parent_node);
+      RBCORE_STORE(successor->right, z->right);
+      RBCORE_STORE(z->right->parent, successor);
+      RBCORE_AUGMENT_COPY(tree, z, successor);
+      RBCORE_AUGMENT_PROPAGATE(tree, parent_node, successor);
+    }
+    RBCORE_STORE(successor->left, z->left);
+    RBCORE_STORE(z->left->parent, successor);
+    successor->color = z->color;
+    RBCORE_(replace_child)(tree, z->parent, z, successor);
+    RBCORE_AUGMENT_PROPAGATE(tree, successor, nil);
+  }
+
+  if (removed_color == RBTREE_RED)
+    return;
+  if (RBCORE_IS_RED(tree, child))
+  {
+    child->color = RBTREE_BLACK;
+    RBCORE_STAT(tree, recolors, 1);
+  }
+  else if (parent_node != nil)
+    RBCORE_(erase_fixup)(tree, parent_node, is_left);
+}
+
+#ifdef RBCORE_KEY_T
+
+#ifndef RBCORE_AUGMENT_DESCEND
+#define RBCORE_AUGMENT_DESCEND(tree, p, node) ((void)0)
+#endif
+
+// start의 subtree에서 key와 같은 node를 찾는 함수 (없으면 leaf)
+// level마다 비교는 한 번: RBCORE_CMP가 있으면 3-way 결과를 한 번 구해 두 판단에 쓰고,
+// 기본 비교는 ==와 <를 그대로 써서 컴파일러가 cmp 하나로 합치고 자식 선택을 cmov로 만든다
+static inline RBCORE_NODE *RBCORE_(find)(const RBCORE_TREE *tree, RBCORE_NODE *start, const RBCORE_KEY_T key)
+{
+  (void)tree;
+  RBCORE_NODE *nil = RBCORE_NIL(tree);
+  RBCORE_NODE *current_node = start;
+  while (current_node != nil)
+  {
+    RBCORE_STAT(tree, comparisons, 1);
+#ifdef RBCORE_CMP
+    const int cmp = RBCORE_CMP(key, RBCORE_KEY(current_node));
+    if (cmp == 0)
+      break;
+    current_node = (cmp < 0) ? current_node->left : current_node->right;
+#else
+    const RBCORE_KEY_T node_key = RBCORE_KEY(current_node);
+    if (key == node_key)
+      break;
+    current_node = (key < node_key) ? current_node->left : current_node->right;
+#endif
+  }
+  return current_node;
+}
+
+// key 이상인 첫 node를 찾는 함수 (같은 key가 여럿이면 inorder 상 가장 앞, 없으면 leaf)
+static inline RBCORE_NODE *RBCORE_(lower_bound)(const RBCORE_TREE *tree, const RBCORE_KEY_T key)
+{
+  RBCORE_NODE *nil = RBCORE_NIL(tree);
+  RBCORE_NODE *current_node = RBCORE_ROOT(tree);
+  RBCORE_NODE *bound = nil;
+  while (current_node != nil)
+  {
+    RBCORE_STAT(tree, comparisons, 1);
+#ifdef RBCORE_CMP
+    const int is_below = RBCORE_CMP(RBCORE_KEY(current_node), key) < 0;
+#else
+    const int is_below = RBCORE_KEY(current_node) < key;
+#endif
+    if (!is_below)
+    {
+      bound = current_node;
+      current_node = current_node->left;
+    }
+    else
+      current_node = current_node->right;
+  }
+  return bound;
+}
+
+// start의 subtree에서 node가 들어갈 leaf 자리를 찾아 그 parent를 반환하는 함수
+// (start가 leaf면 leaf), *dir에는 왼쪽(0)인지 오른쪽(1)인지를 남긴다
+static inline RBCORE_NODE *RBCORE_(descend)(RBCORE_TREE *tree, RBCORE_NODE *start, RBCORE_NODE *node, int *dir)
+{
+  (void)tree;
+  RBCORE_NODE *nil = RBCORE_NIL(tree);
+  RBCORE_NODE *parent_node = nil;
+  RBCORE_NODE *current_node = start;
+  const RBCORE_KEY_T key = RBCORE_KEY(node);
+  int is_right = 0;
+  while (current_node != nil)
+  {
+    RBCORE_AUGMENT_DESCEND(tree, current_node, node);
+    RBCORE_STAT(tree, comparisons, 1);
+#ifdef RBCORE_CMP
+    is_right = RBCORE_CMP(key, RBCORE_KEY(current_node)) >= 0;
+#else
+    is_right = !(key < RBCORE_KEY(current_node));
+#endif
+    parent_node = current_node;
+    current_node = is_right ? current_node->right : current_node->left;
+  }
+  *dir = is_right;
+  return parent_node;
+}
+
+// node를 parent의 dir 쪽 leaf 자리 (parent가 leaf면 root)에 red leaf로 거는 함수
+// node의 link를 먼저 다 쓰고 나서 parent 쪽 link로 publish한다
+static inline void RBCORE_(link)(RBCORE_TREE *tree, RBCORE_NODE *parent_node, const int dir, RBCORE_NODE *node)
+{
+  RBCORE_NODE *nil = RBCORE_NIL(tree);
+  node->left = node->right = nil;
+  node->color = RBTREE_RED;
+  RBCORE_STORE(node->parent, parent_node);
+  if (parent_node == nil)
+    RBCORE_STORE(RBCORE_ROOT(tree), node);
+  else if (dir == 0)
+    RBCORE_STORE(parent_node->left, node);
+  else
+    RBCORE_STORE(parent_node->right, node);
+}
+
+#endif  // RBCORE_KEY_T
+
+#undef RBCORE_
+#undef RBCORE_XCAT
+#undef RBCORE_CAT
+#undef RBCORE_IS_RED
+#undef RBCORE_NAME
+#undef RBCORE_TREE
+#undef RBCORE_NODE
+#undef RBCORE_ROOT
+#undef RBCORE_NIL
+#undef RBCORE_STORE
+#undef RBCORE_STAT
+#undef RBCORE_AUGMENT_ROTATE
+#undef RBCORE_AUGMENT_COPY
+#undef RBCORE_AUGMENT_PROPAGATE
+#undef RBCORE_AUGMENT_DESCEND
+#undef RBCORE_KEY_T
+#undef RBCORE_KEY
+#undef RBCORE_CMP
@@ -0,0 +1,155 @@
+#include "rbtree_frozen.h"
+
+#include <stdlib.h>
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+// cache line 하나에 들어가는 key 개수 (= 4단계 아래 자손의 수)
+#define FROZEN_LINE_KEYS (64 / sizeof(key_t))
+// freeze에서 rbtree_cursor_read로 한 번에 읽는 key 개수
+#define FREEZE_BLOCK_KEYS 4096
+
+// k의 subtree에서 in-order로 처음 오는 index
+static size_t leftmost_index(size_t k, const size_t n)
+{
+  while (2 * k <= n)
+    k = 2 * k;
+  return k;
+}
+
+// k의 subtree에서 in-order로 마지막에 오는 index
+static size_t rightmost_index(size_t k, const size_t n)
+{
+  while (2 * k + 1 <= n)
+    k = 2 * k + 1;
+  return k;
+}
+
+// in-order 다음 index를 구하는 함수 (없으면 0)
+// 오른쪽 subtree가 없으면 오른쪽 자식(홀수)인 동안 올라간 뒤 그 부모가 다음이다
+static size_t next_index(size_t k, const size_t n)
+{
+  if (2 * k + 1 <= n)
+    return leftmost_index(2 * k + 1, n);
+  while (k & 1)
+    k >>= 1;
+  return k >> 1;
+}
+
+// in-order 이전 index를 구하는 함수 (없으면 0)
+static size_t prev_index(size_t k, const size_t n)
+{
+  if (2 * k <= n)
+    return rightmost_index(2 * k, n);
+  while (k > 1 && !(k & 1))
+    k >>= 1;
+  return k >> 1;
+}
+
+// key 이상인 첫 key의 index를 찾는 함수 (없으면 0)
+// 비교 결과로 분기하지 않고 index를 계산하며 내려가고, 4단계 아래를 미리 읽어 둔다
+static size_t lower_bound_index(const rbtree_frozen_t *frozen, const key_t key)
+{
+  const key_t *keys = frozen->keys;
+  size_t k = 1;
+  while (k <= frozen->n)
+  {
+    PREFETCH(keys + k * FROZEN_LINE_KEYS);
+    k = 2 * k + (keys[k] < key);
+  }
+  // 마지막으로 왼쪽으로 내려간 node가 답이다: 그 뒤로 오른쪽으로 간 1 bit들과 0 하나를 떼어낸다
+  while (k & 1)
+    k >>= 1;
+  return k >> 1;
+}
+
+rbtree_frozen_t *rbtree_freeze(const rbtree *tree)
+{
+  rbtree_frozen_t *frozen = (rbtree_frozen_t *)calloc(1, sizeof(rbtree_frozen_t));
+  const size_t n = rbtree_size(tree);
+  frozen->n = n;
+  // keys[0]은 비워 두고, 자손 16개가 cache line 하나에 모이도록 64 byte에 맞춘다
+  const size_t bytes = ((n + 1) * sizeof(key_t) + 63) / 64 * 64;
+  frozen->keys = (key_t *)aligned_alloc(64, bytes);
+  if (n == 0)
+    return frozen;
+
+  // cursor가 in-order로 주는 key를 in-order index 순서대로 채운다
+  key_t *block = (key_t *)malloc(FREEZE_BLOCK_KEYS * sizeof(key_t));
+  rbtree_cursor_t cursor;
+  rbtree_cursor_begin(tree, &cursor);
+  size_t k = leftmost_index(1, n);
+  size_t got;
+  while ((got = rbtree_cursor_read(tree, &cursor, block, FREEZE_BLOCK_KEYS)) > 0)
+  {
+    for (size_t i = 0; i < got; i++)
+    {
+      frozen->keys[k] = block[i];
+      k = next_index(k, n);
+    }
+  }
+  free(block);
+  return frozen;
+}
+
+void delete_rbtree_frozen(rbtree_frozen_t *frozen)
+{
+  free(frozen->keys);
+  free(frozen);
+}
+
+size_t rbtree_frozen_size(const rbtree_frozen_t *frozen)
+{
+  return frozen->n;
+}
+
+const key_t *rbtree_frozen_lower_bound(const rbtree_frozen_t *frozen, const key_t key)
+{
+  const size_t k = lower_bound_index(frozen, key);
+  return (k != 0) ? &frozen->keys[k] : NULL;
+}
+
+const key_t *rbtree_frozen_find(const rbtree_frozen_t *frozen, const key_t key)
+{
+  const size_t k = lower_bound_index(frozen, key);
+  return (k != 0 && frozen->keys[k] == key) ? &frozen->keys[k] : NULL;
+}
+
+const key_t *rbtree_frozen_min(const rbtree_frozen_t *frozen)
+{
+  return (frozen->n > 0) ? &frozen->keys[leftmost_index(1, frozen->n)] : NULL;
+}
+
+const key_t *rbtree_frozen_max(const rbtree_frozen_t *frozen)
+{
+  return (frozen->n > 0) ? &frozen->keys[rightmost_index(1, frozen->n)] : NULL;
+}
+
+const key_t *rbtree_frozen_next(const rbtree_frozen_t *frozen, const key_t *p)
+{
+  const size_t k = next_index((size_t)(p - frozen->keys), frozen->n);
+  return (k != 0) ? &frozen->keys[k] : NULL;
+}
+
+const key_t *rbtree_frozen_prev(const rbtree_frozen_t *frozen, const key_t *p)
+{
+  const size_t k = prev_index((size_t)(p - frozen->keys), frozen->n);
+  return (k != 0) ? &frozen->keys[k] : NULL;
+}
+
+size_t rbtree_frozen_foreach_range(const rbtree_frozen_t *frozen, const key_t lo, const key_t hi,
+                                   int (*visit)(const key_t *, void *), void *ctx)
+{
+  size_t count = 0;
+  for (size_t k = lower_bound_index(frozen, lo); k != 0 && frozen->keys[k] < hi; k = next_index(k, frozen->n))
+  {
+    count++;
+    if (visit(&frozen->keys[k], ctx))
+      break;
+  }
+  return count;
+}
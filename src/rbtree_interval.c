@@ -0,0 +1,161 @@
+#include "rbtree_interval.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+// 빈 subtree의 max는 어떤 key보다도 작게 보아 max 계산과 가지치기에서 건너뛴다
+#define NIL_MAX INT_MIN
+
+// link의 subtree max (NULL이면 NIL_MAX)
+static inline key_t link_max(const rbtree_link_t *p)
+{
+  return (p != NULL) ? interval_rbtree_entry(p)->max : NIL_MAX;
+}
+
+// 자식들의 max와 p 자신의 hi로 p의 max를 다시 계산하는 함수
+static inline void update_max(inode_t *p)
+{
+  key_t max = p->hi;
+  if (link_max(p->link.left) > max)
+    max = link_max(p->link.left);
+  if (link_max(p->link.right) > max)
+    max = link_max(p->link.right);
+  p->max = max;
+}
+
+// p부터 stop 직전까지 경로의 max를 다시 계산하는 augment callback
+static void max_propagate(rbtree_link_t *p, rbtree_link_t *stop)
+{
+  for (; p != stop; p = p->parent)
+    update_max(interval_rbtree_entry(p));
+}
+
+// erase로 new가 old 자리에 들어가면 old의 subtree max를 물려받는다
+static void max_copy(rbtree_link_t *old, rbtree_link_t *new)
+{
+  interval_rbtree_entry(new)->max = interval_rbtree_entry(old)->max;
+}
+
+// rotate로 new가 old 위로 올라가면 new는 old의 subtree 전체를 물려받고 old만 다시 계산한다
+static void max_rotate(rbtree_link_t *old, rbtree_link_t *new)
+{
+  interval_rbtree_entry(new)->max = interval_rbtree_entry(old)->max;
+  update_max(interval_rbtree_entry(old));
+}
+
+static const rbtree_augment_t max_augment = {max_propagate, max_copy, max_rotate};
+
+interval_rbtree *new_interval_rbtree(void)
+{
+  interval_rbtree *tree = (interval_rbtree *)calloc(1, sizeof(interval_rbtree));
+  intrusive_rbtree_init(&tree->links);
+  return tree;
+}
+
+void delete_interval_rbtree(interval_rbtree *tree)
+{
+  // node는 모두 chunk 안에 있으므로 chunk만 해제하면 된다
+  inode_chunk_t *chunk = tree->chunks;
+  while (chunk != NULL)
+  {
+    inode_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(tree);
+}
+
+size_t interval_rbtree_size(const interval_rbtree *tree)
+{
+  return intrusive_rbtree_size(&tree->links);
+}
+
+// free list에서 꺼내거나 현재 chunk에서 잘라 node 하나를 할당하는 함수
+static inode_t *alloc_node(interval_rbtree *tree)
+{
+  inode_t *node = tree->free_list;
+  if (node != NULL)
+  {
+    tree->free_list = interval_rbtree_entry(node->link.right);
+    return node;
+  }
+
+  inode_chunk_t *chunk = tree->chunks;
+  if (chunk == NULL || chunk->used == INTERVAL_CHUNK_NODES)
+  {
+    chunk = (inode_chunk_t *)malloc(sizeof(inode_chunk_t));
+    chunk->used = 0;
+    chunk->next = tree->chunks;
+    tree->chunks = chunk;
+  }
+  return &chunk->nodes[chunk->used++];
+}
+
+inode_t *interval_rbtree_insert(interval_rbtree *tree, const key_t lo, const key_t hi)
+{
+  rbtree_link_t *parent = NULL;
+  rbtree_link_t *current = tree->links.root;
+  int dir = 0;
+  // 같은 lo는 오른쪽으로 보내 삽입 순서를 유지한다
+  while (current != NULL)
+  {
+    parent = current;
+    dir = lo >= interval_rbtree_entry(current)->lo;
+    current = dir ? current->right : current->left;
+  }
+
+  inode_t *node = alloc_node(tree);
+  node->lo = lo;
+  node->hi = hi;
+  // 새 node부터 root까지의 max는 core가 리밸런싱 전에 propagate로 맞춘다
+  intrusive_rbtree_insert_at_augmented(&tree->links, parent, dir, &node->link, &max_augment);
+  return node;
+}
+
+int interval_rbtree_erase(interval_rbtree *tree, inode_t *z)
+{
+  intrusive_rbtree_erase_augmented(&tree->links, &z->link, &max_augment);
+  z->link.right = (tree->free_list != NULL) ? &tree->free_list->link : NULL;
+  tree->free_list = z;
+  return 0;
+}
+
+// p의 subtree에서 [lo, hi]와 겹치는 interval을 lo 순서로 visit에 넘기는 함수
+// max가 lo보다 작은 subtree는 건너뛰고, lo가 hi보다 큰 node에서 오른쪽을 끊는다
+static size_t overlaps_below(rbtree_link_t *link, const key_t lo, const key_t hi,
+                             int (*visit)(inode_t *, void *), void *ctx, int *stop)
+{
+  size_t count = 0;
+  // lo가 INT_MIN이면 빈 subtree의 NIL_MAX도 통과하므로 NULL을 먼저 본다
+  while (link != NULL && link_max(link) >= lo)
+  {
+    inode_t *p = interval_rbtree_entry(link);
+    count += overlaps_below(link->left, lo, hi, visit, ctx, stop);
+    if (*stop || p->lo > hi)
+      break;
+    if (p->hi >= lo)
+    {
+      count++;
+      if (visit != NULL && visit(p, ctx))
+      {
+        *stop = 1;
+        break;
+      }
+    }
+    link = link->right;
+  }
+  return count;
+}
+
+size_t interval_rbtree_overlaps(const interval_rbtree *tree, const key_t lo, const key_t hi,
+                                int (*visit)(inode_t *, void *), void *ctx)
+{
+  int stop = 0;
+  return overlaps_below(tree->links.root, lo, hi, visit, ctx, &stop);
+}
+
+size_t interval_rbtree_stab(const interval_rbtree *tree, const key_t point,
+                            int (*visit)(inode_t *, void *), void *ctx)
+{
+  return interval_rbtree_overlaps(tree, point, point, visit, ctx);
+}
@@ -0,0 +1,67 @@
+#ifndef _RBTREE_INTERVAL_H_
+#define _RBTREE_INTERVAL_H_
+
+#include <stddef.h>
+
+#include "rbtree_intrusive.h"
+
+// Interval variant of rbtree.h: every node holds a closed interval [lo, hi],
+// the tree is ordered by lo, and each node also keeps the largest hi in its
+// subtree. The tree is an intrusive_rbtree with augment callbacks for that
+// max, so rotations and both fixups come from rbtree_core.h like everywhere
+// else; programs link rbtree_intrusive.o. A query skips every subtree whose
+// max is below the query's lo and stops at the first node whose lo is above
+// the query's hi. It visits O(log n) nodes plus the paths down to the k
+// results, so O(log n + k) for clustered results and never more than
+// O(min(n, k log n)).
+//
+// Like rbtree.h it is a multiset (equal lo go right), nodes come from slab
+// chunks of the tree, and erase relinks the successor, so an inode_t * stays
+// valid until that node itself is erased.
+
+typedef struct inode_t {
+  rbtree_link_t link;
+  key_t lo, hi;
+  key_t max;  // largest hi in this subtree
+} inode_t;
+
+#ifndef INTERVAL_CHUNK_NODES
+#define INTERVAL_CHUNK_NODES 512
+#endif
+
+typedef struct inode_chunk_t {
+  struct inode_chunk_t *next;
+  size_t used;
+  inode_t nodes[INTERVAL_CHUNK_NODES];
+} inode_chunk_t;
+
+typedef struct {
+  intrusive_rbtree links;
+  inode_chunk_t *chunks;  // head is the bump chunk
+  inode_t *free_list;     // erased nodes, linked through link.right
+} interval_rbtree;
+
+// the node a link belongs to (NULL for a NULL link)
+static inline inode_t *interval_rbtree_entry(const rbtree_link_t *link)
+{
+  return (link != NULL) ? rbtree_entry(link, inode_t, link) : NULL;
+}
+
+interval_rbtree *new_interval_rbtree(void);
+void delete_interval_rbtree(interval_rbtree *);
+
+// lo must not be above hi
+inode_t *interval_rbtree_insert(interval_rbtree *, const key_t, const key_t);
+int interval_rbtree_erase(interval_rbtree *, inode_t *);
+size_t interval_rbtree_size(const interval_rbtree *);
+
+// visits every interval that shares a point with [lo, hi] in order of lo
+// until visit returns nonzero and returns how many it visited; visit may be
+// NULL to just count, and must not modify the tree. stab is overlaps with
+// lo == hi: every interval that contains the point.
+size_t interval_rbtree_overlaps(const interval_rbtree *, const key_t, const key_t,
+                                int (*)(inode_t *, void *), void *);
+size_t interval_rbtree_stab(const interval_rbtree *, const key_t,
+                            int (*)(inode_t *, void *), void *);
+
+#endif  // _RBTREE_INTERVAL_H_
@@ -0,0 +1,175 @@
+#include "rbtree_intrusive.h"
+
+// rotate와 리밸런싱은 rbtree.c와 같은 core로 만든다 (augment 없는 것과 callback을 부르는 것 두 벌)
+#define RBCORE_NAME link_core
+#define RBCORE_TREE intrusive_rbtree
+#define RBCORE_NODE rbtree_link_t
+#define RBCORE_ROOT(tree) ((tree)->root)
+#include "rbtree_core.h"
+
+// augmented 함수들이 core에 넘기는 tree (callback을 같이 들고 다닌다)
+typedef struct
+{
+  intrusive_rbtree *tree;
+  const rbtree_augment_t *augment;
+} augmented_tree_t;
+
+#define RBCORE_NAME augmented_core
+#define RBCORE_TREE augmented_tree_t
+#define RBCORE_NODE rbtree_link_t
+#define RBCORE_ROOT(at) ((at)->tree->root)
+#define RBCORE_AUGMENT_ROTATE(at, old, new) ((at)->augment->rotate(old, new))
+#define RBCORE_AUGMENT_COPY(at, old, new) ((at)->augment->copy(old, new))
+#define RBCORE_AUGMENT_PROPAGATE(at, node, stop) ((at)->augment->propagate(node, stop))
+#include "rbtree_core.h"
+
+void intrusive_rbtree_init(intrusive_rbtree *tree)
+{
+  tree->root = NULL;
+  tree->count = 0;
+}
+
+size_t intrusive_rbtree_size(const intrusive_rbtree *tree)
+{
+  return tree->count;
+}
+
+// link를 parent의 dir 쪽 leaf 자리에 red node로 거는 함수
+static void link_node(intrusive_rbtree *tree, rbtree_link_t *parent, const int dir, rbtree_link_t *link)
+{
+  link->parent = parent;
+  link->left = link->right = NULL;
+  link->color = RBTREE_RED;
+  if (parent == NULL)
+    tree->root = link;
+  else if (dir == 0)
+    parent->left = link;
+  else
+    parent->right = link;
+  tree->count++;
+}
+
+void intrusive_rbtree_insert_at(intrusive_rbtree *tree, rbtree_link_t *parent, const int dir, rbtree_link_t *link)
+{
+  link_node(tree, parent, dir, link);
+  link_core_insert_fixup(tree, link);
+}
+
+void intrusive_rbtree_insert_at_augmented(intrusive_rbtree *tree, rbtree_link_t *parent, const int dir,
+                                          rbtree_link_t *link, const rbtree_augment_t *augment)
+{
+  augmented_tree_t at = {tree, augment};
+  link_node(tree, parent, dir, link);
+  // 새 link와 그 조상의 값을 먼저 맞춰 두면 리밸런싱은 rotate callback만 부르면 된다
+  augment->propagate(link, NULL);
+  augmented_core_insert_fixup(&at, link);
+}
+
+void intrusive_rbtree_insert(intrusive_rbtree *tree, rbtree_link_t *link,
+                             int (*cmp)(const rbtree_link_t *, const rbtree_link_t *))
+{
+  // 같은 link는 오른쪽으로 보내 삽입 순서를 유지한다
+  rbtree_link_t *parent = NULL;
+  rbtree_link_t *current = tree->root;
+  int dir = 0;
+  while (current != NULL)
+  {
+    parent = current;
+    dir = cmp(link, current) >= 0;
+    current = dir ? current->right : current->left;
+  }
+  intrusive_rbtree_insert_at(tree, parent, dir, link);
+}
+
+void intrusive_rbtree_erase(intrusive_rbtree *tree, rbtree_link_t *z)
+{
+  link_core_erase(tree, z);
+  tree->count--;
+}
+
+void intrusive_rbtree_erase_augmented(intrusive_rbtree *tree, rbtree_link_t *z, const rbtree_augment_t *augment)
+{
+  augmented_tree_t at = {tree, augment};
+  augmented_core_erase(&at, z);
+  tree->count--;
+}
+
+rbtree_link_t *intrusive_rbtree_lower_bound(const intrusive_rbtree *tree, const void *key,
+                                            int (*cmp)(const void *, const rbtree_link_t *))
+{
+  rbtree_link_t *current = tree->root;
+  rbtree_link_t *bound = NULL;
+  while (current != NULL)
+  {
+    if (cmp(key, current) <= 0)
+    {
+      bound = current;
+      current = current->left;
+    }
+    else
+      current = current->right;
+  }
+  return bound;
+}
+
+rbtree_link_t *intrusive_rbtree_find(const intrusive_rbtree *tree, const void *key,
+                                     int (*cmp)(const void *, const rbtree_link_t *))
+{
+  rbtree_link_t *current = tree->root;
+  while (current != NULL)
+  {
+    const int c = cmp(key, current);
+    if (c == 0)
+      return current;
+    current = (c < 0) ? current->left : current->right;
+  }
+  return NULL;
+}
+
+rbtree_link_t *intrusive_rbtree_first(const intrusive_rbtree *tree)
+{
+  rbtree_link_t *p = tree->root;
+  if (p == NULL)
+    return NULL;
+  while (p->left != NULL)
+    p = p->left;
+  return p;
+}
+
+rbtree_link_t *intrusive_rbtree_last(const intrusive_rbtree *tree)
+{
+  rbtree_link_t *p = tree->root;
+  if (p == NULL)
+    return NULL;
+  while (p->right != NULL)
+    p = p->right;
+  return p;
+}
+
+rbtree_link_t *intrusive_rbtree_next(const rbtree_link_t *p)
+{
+  if (p->right != NULL)
+  {
+    rbtree_link_t *q = p->right;
+    while (q->left != NULL)
+      q = q->left;
+    return q;
+  }
+  while (p->parent != NULL && p == p->parent->right)
+    p = p->parent;
+  return p->parent;
+}
+
+rbtree_link_t *intrusive_rbtree_prev(const rbtree_link_t *p)
+{
+  if (p->left != NULL)
+  {
+    rbtree_link_t *q = p->left;
+    while (q->right != NULL)
+      q = q->right;
+    return q;
+  }
+  while (p->parent != NULL && p == p->parent->left)
+    p = p->parent;
+  return p->parent;
+}
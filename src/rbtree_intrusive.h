@@ -0,0 +1,91 @@
+#ifndef _RBTREE_INTRUSIVE_H_
+#define _RBTREE_INTRUSIVE_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Intrusive red-black tree in the style of the Linux kernel rb_node: the
+// caller embeds an rbtree_link_t in its own struct and owns that memory. The
+// library only links, rebalances and unlinks, and never allocates.
+// rbtree_entry gets the containing struct back from a link. Leaf children are
+// NULL. An object can sit in several trees at once through several links.
+//
+// The caller can do the descent itself with inlined comparisons (as
+// rbtree_map.h does) and finish it with intrusive_rbtree_insert_at, or use
+// intrusive_rbtree_insert with a comparator. Like rbtree.h the tree is a
+// multiset, and erase relinks nodes, so a link keeps its place in the order
+// until it is erased itself.
+//
+// Linking and rebalancing come from the template in rbtree_core.h, which
+// rbtree.c instantiates on node_t as well.
+
+typedef struct rbtree_link_t {
+  struct rbtree_link_t *parent, *left, *right;
+  color_t color;
+} rbtree_link_t;
+
+typedef struct {
+  rbtree_link_t *root;
+  size_t count;
+} intrusive_rbtree;
+
+// the struct of the given type whose member field is the link ptr points to
+#define rbtree_entry(ptr, type, member) \
+  ((type *)((char *)(ptr) - offsetof(type, member)))
+
+void intrusive_rbtree_init(intrusive_rbtree *);
+
+// links link as the left (dir 0) or right (dir 1) child of parent, which
+// must be a leaf on that side (NULL parent for an empty tree), and rebalances
+void intrusive_rbtree_insert_at(intrusive_rbtree *, rbtree_link_t *,
+                                const int, rbtree_link_t *);
+// cmp(a, b) is <0, 0 or >0 as a sorts before, with or after b; a link equal
+// to others goes after them
+void intrusive_rbtree_insert(intrusive_rbtree *, rbtree_link_t *,
+                             int (*)(const rbtree_link_t *,
+                                     const rbtree_link_t *));
+void intrusive_rbtree_erase(intrusive_rbtree *, rbtree_link_t *);
+
+// Augmented trees, as the kernel's rb_augment_callbacks: the caller's struct
+// caches a value computed from its subtree (a size, the max end of an
+// interval, ...) and these keep it up to date. propagate(node, stop)
+// recomputes node and each ancestor below stop (NULL: up to the root). copy(old,
+// new) gives new the value of old, whose place it takes in an erase.
+// rotate(old, new) runs after new was rotated above old: new takes old's value
+// and old is recomputed. A tree must use the augmented calls throughout.
+typedef struct {
+  void (*propagate)(rbtree_link_t *, rbtree_link_t *);
+  void (*copy)(rbtree_link_t *, rbtree_link_t *);
+  void (*rotate)(rbtree_link_t *, rbtree_link_t *);
+} rbtree_augment_t;
+
+// insert_at and erase with the callbacks; insert propagates from the new link
+// (which need not be initialized) before rebalancing
+void intrusive_rbtree_insert_at_augmented(intrusive_rbtree *, rbtree_link_t *,
+                                          const int, rbtree_link_t *,
+                                          const rbtree_augment_t *);
+void intrusive_rbtree_erase_augmented(intrusive_rbtree *, rbtree_link_t *,
+                                      const rbtree_augment_t *);
+
+// cmp(key, link) compares a search key with a link the same way. find
+// returns some link equal to key (like rbtree_find), lower_bound the first
+// link not below key. Both call cmp once per level; a hot path can write the
+// same descent with the comparison inlined.
+rbtree_link_t *intrusive_rbtree_find(const intrusive_rbtree *, const void *,
+                                     int (*)(const void *,
+                                             const rbtree_link_t *));
+rbtree_link_t *intrusive_rbtree_lower_bound(const intrusive_rbtree *,
+                                            const void *,
+                                            int (*)(const void *,
+                                                    const rbtree_link_t *));
+
+// in-order walk; next and prev return NULL past the ends
+rbtree_link_t *intrusive_rbtree_first(const intrusive_rbtree *);
+rbtree_link_t *intrusive_rbtree_last(const intrusive_rbtree *);
+rbtree_link_t *intrusive_rbtree_next(const rbtree_link_t *);
+rbtree_link_t *intrusive_rbtree_prev(const rbtree_link_t *);
+
+size_t intrusive_rbtree_size(const intrusive_rbtree *);
+
+#endif  // _RBTREE_INTRUSIVE_H_
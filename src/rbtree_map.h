@@ -0,0 +1,200 @@
+// Key/value red-black tree template. Define the parameters and include this
+// header once per instantiation (it can be included any number of times):
+//
+//   #define RBMAP_NAME intmap                    // prefix of every name
+//   #define RBMAP_KEY int
+//   #define RBMAP_VALUE double
+//   #define RBMAP_CMP(a, b) (((a) > (b)) - ((a) < (b)))  // optional: <0, 0, >0
+//   #include "rbtree_map.h"
+//
+// This declares the tree type intmap, the node type intmap_node (with key and
+// value fields) and static inline functions intmap_new, intmap_delete,
+// intmap_insert, intmap_find, intmap_erase, intmap_min, intmap_max,
+// intmap_lower_bound, intmap_next, intmap_prev and intmap_size. RBMAP_CMP is
+// expanded in place, so comparisons are inlined, and a descent evaluates it
+// once per level; without it keys are compared with < and ==.
+//
+// Like rbtree.h the tree is a multiset: insert always adds a node and equal
+// keys keep insertion order. Nodes come from per-tree slab chunks. Erase
+// relinks nodes instead of copying keys and values, so a node pointer stays
+// valid until that node itself is erased.
+//
+// The map is an allocating layer over rbtree_intrusive.h: each node embeds an
+// rbtree_link_t, the descents are instantiated from rbtree_core.h with
+// RBMAP_CMP (the int tree of rbtree.h is the same template instantiated on
+// node_t with key_t), and linking, rebalancing and unlinking are done by
+// rbtree_intrusive.c, which the program links in.
+
+#include <stdlib.h>
+
+#include "rbtree_intrusive.h"
+
+#if !defined(RBMAP_NAME) || !defined(RBMAP_KEY) || !defined(RBMAP_VALUE)
+#error "define RBMAP_NAME, RBMAP_KEY and RBMAP_VALUE before including rbtree_map.h"
+#endif
+
+#ifndef RBMAP_CMP
+#define RBMAP_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+#define RBMAP_DEFAULT_CMP
+#endif
+
+#ifndef RBMAP_CHUNK_NODES
+#define RBMAP_CHUNK_NODES 512
+#endif
+
+#define RBMAP_CAT(a, b) a##_##b
+#define RBMAP_XCAT(a, b) RBMAP_CAT(a, b)
+#define RBMAP_(name) RBMAP_XCAT(RBMAP_NAME, name)
+
+typedef struct RBMAP_(node)
+{
+  rbtree_link_t link;
+  RBMAP_KEY key;
+  RBMAP_VALUE value;
+} RBMAP_(node);
+
+typedef struct RBMAP_(chunk)
+{
+  struct RBMAP_(chunk) *next;
+  size_t used;
+  RBMAP_(node) nodes[RBMAP_CHUNK_NODES];
+} RBMAP_(chunk);
+
+typedef struct
+{
+  intrusive_rbtree links;
+  RBMAP_(chunk) *chunks;     // head is the bump chunk
+  RBMAP_(node) *free_list;   // erased nodes, linked through link.right
+} RBMAP_NAME;
+
+// link를 품은 node (link가 NULL이면 NULL)
+static inline RBMAP_(node) *RBMAP_(entry)(const rbtree_link_t *link)
+{
+  return (link != NULL) ? rbtree_entry(link, RBMAP_(node), link) : NULL;
+}
+
+// NULL이 아닌 link의 key (탐색 loop 안에서 분기를 더하지 않도록 NULL 확인 없이 읽는다)
+#define RBMAP_LINK_KEY(p) (rbtree_entry(p, RBMAP_(node), link)->key)
+
+// 탐색은 rbtree.c와 같은 core template에서 만든다 (기본 비교면 core도 ==와 <로 비교한다)
+#define RBCORE_NAME RBMAP_(core)
+#define RBCORE_TREE intrusive_rbtree
+#define RBCORE_NODE rbtree_link_t
+#define RBCORE_ROOT(tree) ((tree)->root)
+#define RBCORE_KEY_T RBMAP_KEY
+#define RBCORE_KEY(p) RBMAP_LINK_KEY(p)
+#ifndef RBMAP_DEFAULT_CMP
+#define RBCORE_CMP(a, b) RBMAP_CMP(a, b)
+#endif
+#include "rbtree_core.h"
+
+static inline RBMAP_NAME *RBMAP_(new)(void)
+{
+  RBMAP_NAME *tree = (RBMAP_NAME *)calloc(1, sizeof(RBMAP_NAME));
+  intrusive_rbtree_init(&tree->links);
+  return tree;
+}
+
+static inline void RBMAP_(delete)(RBMAP_NAME *tree)
+{
+  // node는 모두 chunk 안에 있으므로 chunk만 해제하면 된다
+  RBMAP_(chunk) *chunk = tree->chunks;
+  while (chunk != NULL)
+  {
+    RBMAP_(chunk) *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(tree);
+}
+
+static inline size_t RBMAP_(size)(const RBMAP_NAME *tree)
+{
+  return tree->links.count;
+}
+
+// free list에서 꺼내거나 현재 chunk에서 잘라 node 하나를 할당하는 함수
+static inline RBMAP_(node) *RBMAP_(alloc_node)(RBMAP_NAME *tree)
+{
+  RBMAP_(node) *node = tree->free_list;
+  if (node != NULL)
+  {
+    tree->free_list = RBMAP_(entry)(node->link.right);
+    return node;
+  }
+
+  RBMAP_(chunk) *chunk = tree->chunks;
+  if (chunk == NULL || chunk->used == RBMAP_CHUNK_NODES)
+  {
+    chunk = (RBMAP_(chunk) *)malloc(sizeof(RBMAP_(chunk)));
+    chunk->used = 0;
+    chunk->next = tree->chunks;
+    tree->chunks = chunk;
+  }
+  return &chunk->nodes[chunk->used++];
+}
+
+static inline RBMAP_(node) *RBMAP_(insert)(RBMAP_NAME *tree, RBMAP_KEY key, RBMAP_VALUE value)
+{
+  RBMAP_(node) *node = RBMAP_(alloc_node)(tree);
+  node->key = key;
+  node->value = value;
+  // 같은 key는 오른쪽으로 보내 삽입 순서를 유지한다
+  int dir;
+  rbtree_link_t *parent_link = RBMAP_(core_descend)(&tree->links, tree->links.root, &node->link, &dir);
+  intrusive_rbtree_insert_at(&tree->links, parent_link, dir, &node->link);
+  return node;
+}
+
+static inline RBMAP_(node) *RBMAP_(find)(const RBMAP_NAME *tree, RBMAP_KEY key)
+{
+  return RBMAP_(entry)(RBMAP_(core_find)(&tree->links, tree->links.root, key));
+}
+
+// key 이상인 첫 node를 찾는 함수
+static inline RBMAP_(node) *RBMAP_(lower_bound)(const RBMAP_NAME *tree, RBMAP_KEY key)
+{
+  return RBMAP_(entry)(RBMAP_(core_lower_bound)(&tree->links, key));
+}
+
+static inline RBMAP_(node) *RBMAP_(min)(const RBMAP_NAME *tree)
+{
+  return RBMAP_(entry)(intrusive_rbtree_first(&tree->links));
+}
+
+static inline RBMAP_(node) *RBMAP_(max)(const RBMAP_NAME *tree)
+{
+  return RBMAP_(entry)(intrusive_rbtree_last(&tree->links));
+}
+
+// inorder 다음 node (마지막이면 NULL)
+static inline RBMAP_(node) *RBMAP_(next)(const RBMAP_NAME *tree, RBMAP_(node) *p)
+{
+  (void)tree;
+  return RBMAP_(entry)(intrusive_rbtree_next(&p->link));
+}
+
+// inorder 이전 node (첫 node면 NULL)
+static inline RBMAP_(node) *RBMAP_(prev)(const RBMAP_NAME *tree, RBMAP_(node) *p)
+{
+  (void)tree;
+  return RBMAP_(entry)(intrusive_rbtree_prev(&p->link));
+}
+
+// node를 tree에서 떼어내 free list에 돌려주는 함수 (key와 value는 복사하지 않는다)
+static inline void RBMAP_(erase)(RBMAP_NAME *tree, RBMAP_(node) *z)
+{
+  intrusive_rbtree_erase(&tree->links, &z->link);
+  z->link.right = (tree->free_list != NULL) ? &tree->free_list->link : NULL;
+  tree->free_list = z;
+}
+
+#undef RBMAP_LINK_KEY
+#undef RBMAP_
+#undef RBMAP_XCAT
+#undef RBMAP_CAT
+#undef RBMAP_NAME
+#undef RBMAP_KEY
+#undef RBMAP_VALUE
+#undef RBMAP_CMP
+#undef RBMAP_DEFAULT_CMP
@@ -0,0 +1,416 @@
+#include "rbtree_mt.h"
+
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+
+// reader는 writer가 동시에 바꾸는 필드를 읽으므로 모두 atomic load로 읽는다
+// rbtree.c는 RBTREE_MT_ATOMIC으로 빌드되어 link를 release store로 쓰므로,
+// acquire로 읽으면 새로 걸린 node의 key와 link도 다 쓰인 뒤의 값이 보인다
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+
+// RB tree 높이의 상한. 이보다 길게 내려가면 회전 중인 tree를 읽은 것이다
+#define MAX_STEPS 128
+
+// lock 없는 읽기가 몇 번 write와 겹치면 writer mutex를 잡고 읽을지
+#define OPTIMISTIC_SCANS 2
+
+mt_rbtree *new_mt_rbtree(rbtree_mt_mode_t mode)
+{
+  mt_rbtree *mt = (mt_rbtree *)calloc(1, sizeof(mt_rbtree));
+  mt->tree = new_rbtree();
+  mt->mode = mode;
+  pthread_rwlock_init(&mt->rwlock, NULL);
+  pthread_mutex_init(&mt->writer, NULL);
+  return mt;
+}
+
+// retire된 node들을 tree에 돌려주는 함수
+static void release_list(mt_rbtree *mt, mt_retired_list_t *list)
+{
+  for (size_t i = 0; i < list->count; i++)
+    rbtree_release_node(mt->tree, list->nodes[i]);
+  list->count = 0;
+}
+
+void delete_mt_rbtree(mt_rbtree *mt)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    release_list(mt, &mt->limbo[i]);
+    free(mt->limbo[i].nodes);
+  }
+  delete_rbtree(mt->tree);
+  pthread_rwlock_destroy(&mt->rwlock);
+  pthread_mutex_destroy(&mt->writer);
+  free(mt);
+}
+
+// erase에서 빠진 node를 현재 epoch의 limbo list에 넣는 함수 (rbtree의 retire hook)
+static void retire_node(void *ctx, node_t *p)
+{
+  mt_rbtree *mt = (mt_rbtree *)ctx;
+  mt_retired_list_t *list = &mt->limbo[mt->epoch % 3];
+  if (list->count == list->capacity)
+  {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->nodes = (node_t **)realloc(list->nodes, list->capacity * sizeof(node_t *));
+  }
+  list->nodes[list->count++] = p;
+}
+
+// 모든 reader가 현재 epoch에 있으면 epoch을 올리고,
+// 두 epoch 전에 retire된 node들을 돌려주는 함수
+static void try_advance_epoch(mt_rbtree *mt)
+{
+  unsigned long epoch = mt->epoch;
+  if (mt->limbo[0].count == 0 && mt->limbo[1].count == 0 && mt->limbo[2].count == 0)
+    return;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (int i = 0; i < RBTREE_MT_MAX_READERS; i++)
+  {
+    unsigned long state = __atomic_load_n(&mt->readers[i].state, __ATOMIC_ACQUIRE);
+    if ((state & 1) && (state >> 1) != epoch)
+      return;
+  }
+  __atomic_store_n(&mt->epoch, epoch + 1, __ATOMIC_RELEASE);
+  release_list(mt, &mt->limbo[(epoch + 2) % 3]);
+}
+
+static void write_lock(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_wrlock(&mt->rwlock);
+    return;
+  }
+  pthread_mutex_lock(&mt->writer);
+  __atomic_store_n(&mt->seq, mt->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void write_unlock(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_unlock(&mt->rwlock);
+    return;
+  }
+  // reader가 root->size를 읽지 않도록 개수는 wrapper에 따로 publish한다
+  __atomic_store_n(&mt->count, rbtree_size(mt->tree), __ATOMIC_RELEASE);
+  __atomic_store_n(&mt->seq, mt->seq + 1, __ATOMIC_RELEASE);
+  try_advance_epoch(mt);
+  pthread_mutex_unlock(&mt->writer);
+}
+
+// 읽기를 시작할 때의 sequence 번호를 읽는 함수
+// write가 진행 중이어도 기다리지 않고, 검증은 read_retry에서 한 번만 한다
+static unsigned long read_begin(mt_rbtree *mt)
+{
+  return __atomic_load_n(&mt->seq, __ATOMIC_ACQUIRE);
+}
+
+// 읽기 시작 때 write가 진행 중이었거나 읽는 동안 write가 끼어들었는지 확인하는 함수
+static int read_retry(mt_rbtree *mt, unsigned long seq)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return (seq & 1) || __atomic_load_n(&mt->seq, __ATOMIC_RELAXED) != seq;
+}
+
+int mt_rbtree_read_lock(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_rdlock(&mt->rwlock);
+    return 0;
+  }
+
+  // 빈 reader slot에 현재 epoch을 기록한다
+  while (1)
+  {
+    for (int i = 0; i < RBTREE_MT_MAX_READERS; i++)
+    {
+      unsigned long expected = 0;
+      unsigned long state = (__atomic_load_n(&mt->epoch, __ATOMIC_ACQUIRE) << 1) | 1;
+      if (__atomic_compare_exchange_n(&mt->readers[i].state, &expected, state, 0,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return i;
+    }
+    sched_yield();
+  }
+}
+
+void mt_rbtree_read_unlock(mt_rbtree *mt, int slot)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_unlock(&mt->rwlock);
+    return;
+  }
+  __atomic_store_n(&mt->readers[slot].state, 0, __ATOMIC_RELEASE);
+}
+
+node_t *mt_rbtree_insert(mt_rbtree *mt, const key_t key)
+{
+  write_lock(mt);
+  node_t *p = rbtree_insert(mt->tree, key);
+  write_unlock(mt);
+  return p;
+}
+
+// lock-free 모드에서는 erase된 node를 바로 재사용하지 않고 epoch이 지날 때까지 미룬다
+static void erase_locked(mt_rbtree *mt, node_t *p)
+{
+  if (mt->mode == RBTREE_MT_LOCKFREE)
+  {
+    mt->tree->retire = retire_node;
+    mt->tree->retire_ctx = mt;
+  }
+  rbtree_erase(mt->tree, p);
+}
+
+int mt_rbtree_erase(mt_rbtree *mt, node_t *p)
+{
+  write_lock(mt);
+  erase_locked(mt, p);
+  write_unlock(mt);
+  return 0;
+}
+
+int mt_rbtree_erase_key(mt_rbtree *mt, const key_t key)
+{
+  write_lock(mt);
+  node_t *p = rbtree_find(mt->tree, key);
+  if (p != NULL)
+    erase_locked(mt, p);
+  write_unlock(mt);
+  return (p != NULL) ? 0 : -1;
+}
+
+// 아래 *_unlocked 함수들은 writer와 동시에 tree를 읽는다
+// 끊긴 pointer나 너무 긴 경로를 만나면 torn을 세우고, 호출하는 쪽은
+// sequence 번호로 결과를 검증해서 다시 시도한다
+
+static node_t *find_unlocked(const rbtree *tree, key_t key, int *torn)
+{
+  node_t *current_node = LOAD(tree->root);
+  for (int steps = 0; steps < MAX_STEPS && current_node != NULL; steps++)
+  {
+    if (current_node == tree->nil)
+      return NULL;
+    key_t node_key = LOAD(current_node->key);
+    if (key == node_key)
+      return current_node;
+    current_node = (key < node_key) ? LOAD(current_node->left) : LOAD(current_node->right);
+  }
+  *torn = 1;
+  return NULL;
+}
+
+// key 이상 (strict이면 key 초과)인 첫 노드를 찾는 함수
+static node_t *bound_unlocked(const rbtree *tree, key_t key, int strict, int *torn)
+{
+  node_t *current_node = LOAD(tree->root);
+  node_t *bound = NULL;
+  for (int steps = 0; steps < MAX_STEPS && current_node != NULL; steps++)
+  {
+    if (current_node == tree->nil)
+      return bound;
+    key_t node_key = LOAD(current_node->key);
+    if (node_key > key || (!strict && node_key == key))
+    {
+      bound = current_node;
+      current_node = LOAD(current_node->left);
+    }
+    else
+      current_node = LOAD(current_node->right);
+  }
+  *torn = 1;
+  return NULL;
+}
+
+static node_t *successor_unlocked(const rbtree *tree, node_t *p, int *torn)
+{
+  node_t *current_node = LOAD(p->right);
+  int steps = 0;
+  if (current_node != tree->nil)
+  {
+    while (current_node != NULL && steps++ < MAX_STEPS)
+    {
+      node_t *left_node = LOAD(current_node->left);
+      if (left_node == tree->nil)
+        return current_node;
+      current_node = left_node;
+    }
+    *torn = 1;
+    return NULL;
+  }
+
+  current_node = p;
+  while (current_node != NULL && steps++ < MAX_STEPS)
+  {
+    node_t *parent_node = LOAD(current_node->parent);
+    if (parent_node == tree->nil)
+      return NULL;
+    if (parent_node == NULL)
+      break;
+    if (LOAD(parent_node->left) == current_node)
+      return parent_node;
+    current_node = parent_node;
+  }
+  *torn = 1;
+  return NULL;
+}
+
+node_t *mt_rbtree_find(mt_rbtree *mt, const key_t key)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_find(mt->tree, key);
+  for (int attempt = 0; attempt < OPTIMISTIC_SCANS; attempt++)
+  {
+    int torn = 0;
+    unsigned long seq = read_begin(mt);
+    node_t *p = find_unlocked(mt->tree, key, &torn);
+    // 찾은 node는 읽는 동안 한 번은 tree에 있었고 key도 바뀌지 않으므로 검증하지 않는다
+    // 회전과 겹치면 있는 key를 놓칠 수 있으므로 못 찾은 경우만 검증한다
+    if (p != NULL || (!torn && !read_retry(mt, seq)))
+      return p;
+  }
+
+  // 계속 write와 겹치면 writer를 잠시 막고 읽는다
+  pthread_mutex_lock(&mt->writer);
+  node_t *p = rbtree_find(mt->tree, key);
+  pthread_mutex_unlock(&mt->writer);
+  return p;
+}
+
+// dir이 0이면 최소, 1이면 최대 노드를 돌려주는 함수
+// writer가 캐시해 둔 끝 node를 한 번 읽으므로 tree를 내려가지도, 검증하지도 않는다
+static node_t *extreme(mt_rbtree *mt, int dir)
+{
+  node_t *p = dir ? LOAD(mt->tree->rightmost) : LOAD(mt->tree->leftmost);
+  return (p != mt->tree->nil) ? p : NULL;
+}
+
+node_t *mt_rbtree_min(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_min(mt->tree);
+  return extreme(mt, 0);
+}
+
+node_t *mt_rbtree_max(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_max(mt->tree);
+  return extreme(mt, 1);
+}
+
+static node_t *bound(mt_rbtree *mt, key_t key, int strict)
+{
+  for (int attempt = 0; attempt < OPTIMISTIC_SCANS; attempt++)
+  {
+    int torn = 0;
+    unsigned long seq = read_begin(mt);
+    node_t *p = bound_unlocked(mt->tree, key, strict, &torn);
+    if (!torn && !read_retry(mt, seq))
+      return p;
+  }
+
+  // key는 정수이므로 key 초과는 key + 1 이상이다
+  if (strict && key == INT_MAX)
+    return NULL;
+  pthread_mutex_lock(&mt->writer);
+  node_t *p = rbtree_lower_bound(mt->tree, strict ? key + 1 : key);
+  pthread_mutex_unlock(&mt->writer);
+  return p;
+}
+
+node_t *mt_rbtree_lower_bound(mt_rbtree *mt, const key_t key)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_lower_bound(mt->tree, key);
+  return bound(mt, key, 0);
+}
+
+node_t *mt_rbtree_iter_begin(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_iter_begin(mt->tree);
+  return extreme(mt, 0);
+}
+
+node_t *mt_rbtree_iter_next(mt_rbtree *mt, node_t *p)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+    return rbtree_iter_next(mt->tree, p);
+  if (p == NULL)
+    return NULL;
+
+  int torn = 0;
+  unsigned long seq = read_begin(mt);
+  key_t key = LOAD(p->key);
+  node_t *next_node = successor_unlocked(mt->tree, p, &torn);
+  if (!torn && !read_retry(mt, seq))
+    return next_node;
+
+  // 그 사이 tree가 바뀌었으면 현재 key보다 큰 첫 노드에서 이어간다
+  return bound(mt, key, 1);
+}
+
+size_t mt_rbtree_size(mt_rbtree *mt)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_rdlock(&mt->rwlock);
+    size_t size = rbtree_size(mt->tree);
+    pthread_rwlock_unlock(&mt->rwlock);
+    return size;
+  }
+  return LOAD(mt->count);
+}
+
+static int to_array_unlocked(const rbtree *tree, key_t *arr, const size_t n)
+{
+  int torn = 0;
+  size_t i = 0;
+  node_t *p = LOAD(tree->leftmost);
+  if (p == tree->nil)
+    p = NULL;
+  while (!torn && p != NULL && i < n)
+  {
+    arr[i++] = LOAD(p->key);
+    p = successor_unlocked(tree, p, &torn);
+  }
+  return !torn;
+}
+
+int mt_rbtree_to_array(mt_rbtree *mt, key_t *arr, const size_t n)
+{
+  if (mt->mode == RBTREE_MT_RWLOCK)
+  {
+    pthread_rwlock_rdlock(&mt->rwlock);
+    rbtree_to_array(mt->tree, arr, n);
+    pthread_rwlock_unlock(&mt->rwlock);
+    return 0;
+  }
+
+  int slot = mt_rbtree_read_lock(mt);
+  for (int attempt = 0; attempt < OPTIMISTIC_SCANS; attempt++)
+  {
+    unsigned long seq = read_begin(mt);
+    if (to_array_unlocked(mt->tree, arr, n) && !read_retry(mt, seq))
+    {
+      mt_rbtree_read_unlock(mt, slot);
+      return 0;
+    }
+  }
+  mt_rbtree_read_unlock(mt, slot);
+
+  // 계속 write와 겹치면 writer를 잠시 막고 일관된 상태를 읽는다
+  pthread_mutex_lock(&mt->writer);
+  rbtree_to_array(mt->tree, arr, n);
+  pthread_mutex_unlock(&mt->writer);
+  return 0;
+}
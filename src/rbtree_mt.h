@@ -0,0 +1,88 @@
+#ifndef _RBTREE_MT_H_
+#define _RBTREE_MT_H_
+
+#include <pthread.h>
+
+#include "rbtree.h"
+
+// Thread-safe wrapper around rbtree.h.
+//
+// RBTREE_MT_RWLOCK: readers share a pthread rwlock, writers take it
+// exclusively. Any number of writer threads.
+//
+// RBTREE_MT_LOCKFREE: readers take no lock and never wait for a write in
+// progress; they walk the tree while the writer relinks it, RCU style.
+// Erased nodes are reclaimed through epochs, so a node_t * obtained inside a
+// read section stays valid (and keeps its key) until mt_rbtree_read_unlock.
+// That makes a found node and the cached min and max correct as read. A
+// miss, a bound or a successor can be wrong if a rotation overlapped the
+// walk, so those are checked once at the end against a sequence counter that
+// the writer bumps around every mutation. After a couple of overlapping
+// walks the read briefly takes the writer mutex, so steady writes cannot
+// starve readers. Writers are serialized by a mutex; the mode is meant for a
+// single writer thread. Iteration is weakly consistent: if a write overlaps
+// a step, the walk resumes at the first key greater than the current one. Erase never moves keys between nodes, so a
+// walk still visits every distinct key that stays in the tree meanwhile.
+//
+// In lock-free mode rbtree.c must be built with -DRBTREE_MT_ATOMIC, so the
+// writer publishes links with release stores that the readers pair with
+// acquire loads.
+//
+// Read operations (find, min, max, lower_bound, iter_*) must be called
+// between mt_rbtree_read_lock and mt_rbtree_read_unlock, and a read section
+// must not call a write operation.
+
+typedef enum { RBTREE_MT_RWLOCK, RBTREE_MT_LOCKFREE } rbtree_mt_mode_t;
+
+#define RBTREE_MT_MAX_READERS 64
+
+// a reader slot on its own cache line: (epoch << 1) | 1 while reading, 0 if
+// free
+typedef struct {
+  unsigned long state;
+  char pad[64 - sizeof(unsigned long)];
+} mt_reader_slot_t;
+
+typedef struct {
+  node_t **nodes;
+  size_t count, capacity;
+} mt_retired_list_t;
+
+typedef struct {
+  rbtree *tree;
+  rbtree_mt_mode_t mode;
+  pthread_rwlock_t rwlock;  // RBTREE_MT_RWLOCK
+  pthread_mutex_t writer;   // RBTREE_MT_LOCKFREE: serializes writers
+  unsigned long seq;        // odd while a write is in progress
+  unsigned long epoch;      // reclamation epoch
+  size_t count;             // RBTREE_MT_LOCKFREE: keys after the last write
+  mt_retired_list_t limbo[3];  // erased nodes by retire epoch % 3
+  mt_reader_slot_t readers[RBTREE_MT_MAX_READERS];
+} mt_rbtree;
+
+mt_rbtree *new_mt_rbtree(rbtree_mt_mode_t);
+void delete_mt_rbtree(mt_rbtree *);
+
+// returns a reader slot to pass to mt_rbtree_read_unlock
+int mt_rbtree_read_lock(mt_rbtree *);
+void mt_rbtree_read_unlock(mt_rbtree *, int);
+
+node_t *mt_rbtree_insert(mt_rbtree *, const key_t);
+// the caller must make sure no other writer erases the same node
+int mt_rbtree_erase(mt_rbtree *, node_t *);
+// finds and erases one node with the key under the write lock; -1 if absent
+int mt_rbtree_erase_key(mt_rbtree *, const key_t);
+
+node_t *mt_rbtree_find(mt_rbtree *, const key_t);
+node_t *mt_rbtree_min(mt_rbtree *);
+node_t *mt_rbtree_max(mt_rbtree *);
+node_t *mt_rbtree_lower_bound(mt_rbtree *, const key_t);
+node_t *mt_rbtree_iter_begin(mt_rbtree *);
+node_t *mt_rbtree_iter_next(mt_rbtree *, node_t *);
+
+// size reads the count the last write published; to_array takes its own
+// read section
+size_t mt_rbtree_size(mt_rbtree *);
+int mt_rbtree_to_array(mt_rbtree *, key_t *, const size_t);
+
+#endif  // _RBTREE_MT_H_
@@ -0,0 +1,441 @@
+#include "rbtree_par.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+// 이보다 작은 subtree는 나누지 않고 한 thread가 처리한다
+#define PAR_GRAIN 16384
+// worker마다 쌓아 둘 수 있는 task 개수 (넘치면 그 자리에서 실행한다)
+#define PAR_DEQUE_TASKS 256
+
+typedef struct par_task par_task_t;
+
+struct par_task
+{
+  void (*run)(rbtree_par_t *, int, const par_task_t *);
+  node_t *node;  // subtree root (build에서는 새 node를 달 parent)
+  size_t lo, hi;  // to_array: 출력 offset, build: keys 구간
+  int depth;      // build: 새 node의 깊이
+  int is_left;    // build: parent의 어느 쪽에 달지
+};
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  size_t top, bottom;  // [top, bottom)이 남은 task. 주인은 bottom, 훔치는 쪽은 top을 쓴다
+  par_task_t tasks[PAR_DEQUE_TASKS];
+} par_deque_t;
+
+typedef struct
+{
+  rbtree_par_t *par;
+  int id;
+} par_worker_t;
+
+// worker마다 따로 쌓는 reduce 결과 (cache line 하나씩)
+typedef struct
+{
+  uint64_t sum;
+  char pad[64 - sizeof(uint64_t)];
+} par_partial_t;
+
+struct rbtree_par
+{
+  int threads;
+  pthread_t threads_id[RBTREE_PAR_MAX_THREADS];
+  par_worker_t workers[RBTREE_PAR_MAX_THREADS];
+  par_deque_t deques[RBTREE_PAR_MAX_THREADS];
+  par_partial_t partial[RBTREE_PAR_MAX_THREADS];
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  unsigned long generation;  // 작업을 시작할 때마다 1씩 증가
+  int stop;
+  size_t pending;  // 아직 끝나지 않은 task 수
+
+  // 실행 중인 작업의 인자
+  const rbtree *tree;
+  rbtree *build_tree;
+  key_t *out;
+  size_t out_n;
+  const key_t *keys;
+  node_t *nodes;
+  int red_depth;
+  uint64_t (*reduce)(key_t, size_t, void *);
+  void *ctx;
+};
+
+// 자기 deque의 bottom에서 가장 최근 task를 꺼내는 함수
+static int pop_task(par_deque_t *deque, par_task_t *task)
+{
+  int found = 0;
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom > deque->top)
+  {
+    *task = deque->tasks[--deque->bottom % PAR_DEQUE_TASKS];
+    found = 1;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+// 다른 worker의 deque top에서 가장 오래된 (가장 큰) task를 훔치는 함수
+static int steal_task(rbtree_par_t *par, int id, unsigned int *seed, par_task_t *task)
+{
+  const int start = rand_r(seed) % par->threads;
+  for (int i = 0; i < par->threads; i++)
+  {
+    const int victim = (start + i) % par->threads;
+    if (victim == id)
+      continue;
+    par_deque_t *deque = &par->deques[victim];
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top)
+    {
+      *task = deque->tasks[deque->top++ % PAR_DEQUE_TASKS];
+      pthread_mutex_unlock(&deque->lock);
+      return 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+  }
+  return 0;
+}
+
+// task를 자기 deque에 넣는 함수 (deque가 가득 차면 바로 실행한다)
+static void spawn_task(rbtree_par_t *par, int id, const par_task_t *task)
+{
+  par_deque_t *deque = &par->deques[id];
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom - deque->top < PAR_DEQUE_TASKS)
+  {
+    __atomic_add_fetch(&par->pending, 1, __ATOMIC_RELAXED);
+    deque->tasks[deque->bottom++ % PAR_DEQUE_TASKS] = *task;
+    pthread_mutex_unlock(&deque->lock);
+    return;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  task->run(par, id, task);
+}
+
+// 모든 task가 끝날 때까지 자기 task를 꺼내거나 훔쳐서 실행하는 함수
+static void work_until_done(rbtree_par_t *par, int id)
+{
+  unsigned int seed = (unsigned int)id * 2654435761u + 1;
+  while (__atomic_load_n(&par->pending, __ATOMIC_ACQUIRE) > 0)
+  {
+    par_task_t task;
+    if (pop_task(&par->deques[id], &task) || steal_task(par, id, &seed, &task))
+    {
+      task.run(par, id, &task);
+      __atomic_sub_fetch(&par->pending, 1, __ATOMIC_RELEASE);
+    }
+    else
+      sched_yield();
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  rbtree_par_t *par = ((par_worker_t *)arg)->par;
+  const int id = ((par_worker_t *)arg)->id;
+  unsigned long seen = 0;
+  while (1)
+  {
+    pthread_mutex_lock(&par->lock);
+    while (par->generation == seen && !par->stop)
+      pthread_cond_wait(&par->wake, &par->lock);
+    if (par->stop)
+    {
+      pthread_mutex_unlock(&par->lock);
+      return NULL;
+    }
+    seen = par->generation;
+    pthread_mutex_unlock(&par->lock);
+    work_until_done(par, id);
+  }
+}
+
+rbtree_par_t *new_rbtree_par(int threads)
+{
+  if (threads < 1)
+    threads = 1;
+  if (threads > RBTREE_PAR_MAX_THREADS)
+    threads = RBTREE_PAR_MAX_THREADS;
+
+  rbtree_par_t *par = (rbtree_par_t *)calloc(1, sizeof(rbtree_par_t));
+  if (par == NULL)
+    return NULL;
+  pthread_mutex_init(&par->lock, NULL);
+  pthread_cond_init(&par->wake, NULL);
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_mutex_init(&par->deques[i].lock, NULL);
+    par->workers[i].par = par;
+    par->workers[i].id = i;
+  }
+  // 0번 worker는 작업을 시작한 thread가 맡는다
+  // thread를 만들지 못하면 거기까지 만든 thread만 쓰고, delete도 그 thread들만 join한다
+  int started = 1;
+  while (started < threads &&
+         pthread_create(&par->threads_id[started], NULL, worker_main, &par->workers[started]) == 0)
+    started++;
+  for (int i = started; i < threads; i++)
+    pthread_mutex_destroy(&par->deques[i].lock);
+  par->threads = started;
+  return par;
+}
+
+void delete_rbtree_par(rbtree_par_t *par)
+{
+  pthread_mutex_lock(&par->lock);
+  par->stop = 1;
+  pthread_cond_broadcast(&par->wake);
+  pthread_mutex_unlock(&par->lock);
+  for (int i = 1; i < par->threads; i++)
+    pthread_join(par->threads_id[i], NULL);
+  for (int i = 0; i < par->threads; i++)
+    pthread_mutex_destroy(&par->deques[i].lock);
+  pthread_cond_destroy(&par->wake);
+  pthread_mutex_destroy(&par->lock);
+  free(par);
+}
+
+// root task 하나로 작업을 시작하고 모든 task가 끝나면 돌아오는 함수
+static void run_job(rbtree_par_t *par, const par_task_t *root)
+{
+  for (int i = 0; i < par->threads; i++)
+    par->partial[i].sum = 0;
+  par_deque_t *deque = &par->deques[0];
+  pthread_mutex_lock(&deque->lock);
+  __atomic_store_n(&par->pending, 1, __ATOMIC_RELAXED);
+  deque->tasks[deque->bottom++ % PAR_DEQUE_TASKS] = *root;
+  pthread_mutex_unlock(&deque->lock);
+
+  pthread_mutex_lock(&par->lock);
+  par->generation++;
+  pthread_cond_broadcast(&par->wake);
+  pthread_mutex_unlock(&par->lock);
+  work_until_done(par, 0);
+}
+
+// p의 subtree를 in-order로 out[offset, n)에 쓰고 다음 offset을 반환하는 함수
+static size_t copy_subtree(const rbtree *tree, node_t *p, key_t *out, size_t offset, const size_t n)
+{
+  while (p != tree->nil && offset < n)
+  {
+    offset = copy_subtree(tree, p->left, out, offset, n);
+    for (size_t count = rbtree_node_count(p); count > 0 && offset < n; count--)
+      out[offset++] = p->key;
+    p = p->right;
+  }
+  return offset;
+}
+
+// 큰 subtree는 오른쪽 자식을 task로 넘기고 왼쪽으로 내려가며 자기 key를 쓰는 task
+static void to_array_task(rbtree_par_t *par, int id, const par_task_t *task)
+{
+  const rbtree *tree = par->tree;
+  node_t *p = task->node;
+  const size_t offset = task->lo;
+  while (p->size > PAR_GRAIN && offset < par->out_n)
+  {
+    // 이 node의 key는 왼쪽 subtree 바로 뒤, 오른쪽 subtree는 그 뒤에 온다
+    const size_t count = rbtree_node_count(p);
+    const size_t at = offset + p->left->size;
+    if (p->right != tree->nil && at + count < par->out_n)
+    {
+      const par_task_t right = {.run = to_array_task, .node = p->right, .lo = at + count};
+      spawn_task(par, id, &right);
+    }
+    for (size_t i = 0; i < count && at + i < par->out_n; i++)
+      par->out[at + i] = p->key;
+    p = p->left;
+  }
+  copy_subtree(tree, p, par->out, offset, par->out_n);
+}
+
+int rbtree_par_to_array(rbtree_par_t *par, const rbtree *tree, key_t *arr, const size_t n)
+{
+  if (tree->root == tree->nil || n == 0)
+    return 0;
+  // 각 task의 출력 위치를 size로 정하므로 thread를 띄우기 전에 size를 맞춘다
+  rbtree_settle_sizes(tree);
+  par->tree = tree;
+  par->out = arr;
+  par->out_n = n;
+  const par_task_t root = {.run = to_array_task, .node = tree->root, .lo = 0};
+  run_job(par, &root);
+  return 0;
+}
+
+// p의 subtree에 대한 reduce 함수 값의 합
+static uint64_t reduce_subtree(const rbtree_par_t *par, node_t *p)
+{
+  uint64_t sum = 0;
+  for (; p != par->tree->nil; p = p->right)
+    sum += reduce_subtree(par, p->left) + par->reduce(p->key, rbtree_node_count(p), par->ctx);
+  return sum;
+}
+
+static void reduce_task(rbtree_par_t *par, int id, const par_task_t *task)
+{
+  node_t *p = task->node;
+  uint64_t sum = 0;
+  while (p->size > PAR_GRAIN)
+  {
+    if (p->right != par->tree->nil)
+    {
+      const par_task_t right = {.run = reduce_task, .node = p->right};
+      spawn_task(par, id, &right);
+    }
+    sum += par->reduce(p->key, rbtree_node_count(p), par->ctx);
+    p = p->left;
+  }
+  par->partial[id].sum += sum + reduce_subtree(par, p);
+}
+
+uint64_t rbtree_par_reduce(rbtree_par_t *par, const rbtree *tree, uint64_t (*f)(key_t, size_t, void *),
+                           void *ctx)
+{
+  if (tree->root == tree->nil)
+    return 0;
+  par->tree = tree;
+  par->reduce = f;
+  par->ctx = ctx;
+  const par_task_t root = {.run = reduce_task, .node = tree->root};
+  run_job(par, &root);
+
+  uint64_t sum = 0;
+  for (int i = 0; i < par->threads; i++)
+    sum += par->partial[i].sum;
+  return sum;
+}
+
+// keys[mid]로 node를 만들어 parent의 is_left 쪽에 다는 함수
+static node_t *make_node(rbtree_par_t *par, size_t mid, size_t size, node_t *parent, int is_left, int depth)
+{
+  rbtree *tree = par->build_tree;
+  node_t *node = (par->nodes != NULL) ? &par->nodes[mid] : (node_t *)malloc(sizeof(node_t));
+  node->key = par->keys[mid];
+  node->color = (depth == par->red_depth) ? RBTREE_RED : RBTREE_BLACK;
+  node->size = size;
+  node->parent = parent;
+  node->left = node->right = tree->nil;
+  // 양쪽 자식은 서로 다른 thread가 달 수 있지만 쓰는 필드가 다르다
+  if (parent == tree->nil)
+    tree->root = node;
+  else if (is_left)
+    parent->left = node;
+  else
+    parent->right = node;
+  return node;
+}
+
+// keys[lo, hi)로 만든 subtree를 parent 아래에 다는 함수 (rbtree.c의 build_subtree와 같은 모양)
+static void build_range(rbtree_par_t *par, node_t *parent, int is_left, size_t lo, size_t hi, int depth)
+{
+  if (lo >= hi)
+    return;
+  const size_t mid = lo + (hi - lo) / 2;
+  node_t *node = make_node(par, mid, hi - lo, parent, is_left, depth);
+  build_range(par, node, 1, lo, mid, depth + 1);
+  build_range(par, node, 0, mid + 1, hi, depth + 1);
+}
+
+static void build_task(rbtree_par_t *par, int id, const par_task_t *task)
+{
+  node_t *parent = task->node;
+  int is_left = task->is_left;
+  int depth = task->depth;
+  size_t lo = task->lo, hi = task->hi;
+  while (hi - lo > PAR_GRAIN)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    node_t *node = make_node(par, mid, hi - lo, parent, is_left, depth);
+    const par_task_t right = {.run = build_task, .node = node, .lo = mid + 1, .hi = hi,
+                              .depth = depth + 1, .is_left = 0};
+    spawn_task(par, id, &right);
+    parent = node;
+    is_left = 1;
+    hi = mid;
+    depth++;
+  }
+  build_range(par, parent, is_left, lo, hi, depth);
+}
+
+rbtree *rbtree_par_from_sorted_array(rbtree_par_t *par, const key_t *arr, const size_t n)
+{
+  rbtree *tree = new_rbtree();
+  if (n == 0)
+    return tree;
+
+  // rbtree.c의 build_runs와 같이 꽉 찬 깊이 아래에 매달린 node만 red로 칠한다
+  int red_depth = 0;
+  while (((size_t)2 << red_depth) <= n + 1)
+    red_depth++;
+  par->build_tree = tree;
+  par->keys = arr;
+  par->nodes = rbtree_reserve_nodes(tree, n);
+  par->red_depth = red_depth;
+  const par_task_t root = {.run = build_task, .node = tree->nil, .lo = 0, .hi = n, .depth = 0,
+                           .is_left = 0};
+  run_job(par, &root);
+
+  // node를 직접 달았으므로 캐시된 min, max node도 여기서 채운다
+  tree->leftmost = tree->rightmost = tree->root;
+  while (tree->leftmost->left != tree->nil)
+    tree->leftmost = tree->leftmost->left;
+  while (tree->rightmost->right != tree->nil)
+    tree->rightmost = tree->rightmost->right;
+  return tree;
+}
+
+#ifdef RBTREE_MALLOC_NODES
+// p의 subtree node를 모두 해제하는 함수
+static void free_subtree(rbtree *tree, node_t *p)
+{
+  while (p != tree->nil)
+  {
+    node_t *right = p->right;
+    free_subtree(tree, p->left);
+    rbtree_release_node(tree, p);
+    p = right;
+  }
+}
+
+static void delete_task(rbtree_par_t *par, int id, const par_task_t *task)
+{
+  rbtree *tree = par->build_tree;
+  node_t *p = task->node;
+  while (p->size > PAR_GRAIN)
+  {
+    node_t *left = p->left;
+    if (p->right != tree->nil)
+    {
+      const par_task_t right = {.run = delete_task, .node = p->right};
+      spawn_task(par, id, &right);
+    }
+    rbtree_release_node(tree, p);
+    p = left;
+  }
+  free_subtree(tree, p);
+}
+#endif
+
+void rbtree_par_delete(rbtree_par_t *par, rbtree *tree)
+{
+#ifdef RBTREE_MALLOC_NODES
+  // malloc 모드에서는 release가 free라서 여러 thread가 동시에 불러도 된다
+  if (tree->root != tree->nil)
+  {
+    par->build_tree = tree;
+    const par_task_t root = {.run = delete_task, .node = tree->root};
+    run_job(par, &root);
+    tree->root = tree->nil;
+  }
+#else
+  (void)par;
+#endif
+  delete_rbtree(tree);
+}
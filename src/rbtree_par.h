@@ -0,0 +1,43 @@
+#ifndef _RBTREE_PAR_H_
+#define _RBTREE_PAR_H_
+
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// Parallel bulk operations on rbtree.h trees.
+//
+// A rbtree_par_t is a small work-stealing pool: the calling thread plus
+// threads - 1 workers, each with its own task deque. An operation starts as
+// one task for the whole tree. A task over a large subtree pushes its right
+// child as a new task and goes on with the left one, and idle threads steal
+// the oldest (largest) task from another deque. Subtree sizes give every task
+// its output offset, so no task waits for another.
+//
+// The tree must not be modified while an operation runs, and a pool runs one
+// operation at a time.
+
+#define RBTREE_PAR_MAX_THREADS 64
+
+typedef struct rbtree_par rbtree_par_t;
+
+// threads counts the caller, so 1 runs everything on the calling thread.
+// NULL if out of memory; if a worker thread cannot be created, the pool runs
+// with the ones started so far.
+rbtree_par_t *new_rbtree_par(int);
+void delete_rbtree_par(rbtree_par_t *);
+
+// same results as rbtree_to_array and rbtree_from_sorted_array (plain tree)
+int rbtree_par_to_array(rbtree_par_t *, const rbtree *, key_t *, const size_t);
+rbtree *rbtree_par_from_sorted_array(rbtree_par_t *, const key_t *,
+                                     const size_t);
+// delete_rbtree; nodes malloc'd one by one (RBTREE_MALLOC_NODES) are freed
+// in parallel, slab pools are freed chunk by chunk as before
+void rbtree_par_delete(rbtree_par_t *, rbtree *);
+
+// sum of f(key, copies, ctx) over all nodes, where copies is
+// rbtree_node_count of the node; f is called from several threads at once
+uint64_t rbtree_par_reduce(rbtree_par_t *, const rbtree *,
+                           uint64_t (*)(key_t, size_t, void *), void *);
+
+#endif  // _RBTREE_PAR_H_
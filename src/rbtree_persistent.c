@@ -0,0 +1,341 @@
+#include "rbtree_persistent.h"
+
+#include <stdlib.h>
+
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+
+// 2^64개 미만의 노드로 만든 RB tree의 높이는 128을 넘지 않는다
+// (erase case 1에서 경로가 한 칸 늘어나는 것까지 여유를 둠)
+#define MAX_PATH 160
+
+// 모든 version의 살아 있는 node 수 (persistent_rbtree_node_bytes용)
+static size_t live_nodes;
+
+static inline int is_red(const pnode_t *p)
+{
+  return p != NULL && p->color == RBTREE_RED;
+}
+
+static inline void acquire(pnode_t *p)
+{
+  if (p != NULL)
+    __atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+}
+
+// 참조 하나를 놓는 함수 (마지막 참조였으면 node를 해제하고 자식들의 참조도 놓는다)
+static void release(pnode_t *p)
+{
+  while (p != NULL && __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    pnode_t *right = p->link[1];
+    release(p->link[0]);
+    free(p);
+    __atomic_sub_fetch(&live_nodes, 1, __ATOMIC_RELAXED);
+    p = right;
+  }
+}
+
+static pnode_t *alloc_node(void)
+{
+  __atomic_add_fetch(&live_nodes, 1, __ATOMIC_RELAXED);
+  return (pnode_t *)malloc(sizeof(pnode_t));
+}
+
+// *slot의 node를 이 version 혼자 쓰도록 만들어 돌려주는 함수
+// slot을 가진 node가 이미 이 version 것이어야 하므로 root부터 내려가며 부른다.
+// 다른 version과 공유 중이면 복사본을 걸고 (복사본이 자식을 새로 참조한다) 원래 node의 참조를 놓는다
+static pnode_t *own(pnode_t **slot)
+{
+  pnode_t *p = *slot;
+  if (LOAD(p->refs) == 1)
+    return p;
+
+  pnode_t *copy = alloc_node();
+  *copy = *p;
+  copy->refs = 1;
+  acquire(copy->link[0]);
+  acquire(copy->link[1]);
+  release(p);
+  *slot = copy;
+  return copy;
+}
+
+// path[depth - 1]의 dirs[depth - 1] 자리 (depth가 0이면 root)를 가리키는 함수
+static inline pnode_t **slot_at(persistent_rbtree *tree, pnode_t **path, const int *dirs, int depth)
+{
+  return (depth == 0) ? &tree->root : &path[depth - 1]->link[dirs[depth - 1]];
+}
+
+// x를 dir 방향으로 회전하고 새 subtree root를 돌려주는 함수
+// x와 올라오는 자식은 이 version 것이어야 한다 (부모와의 연결은 호출하는 쪽에서)
+static pnode_t *rotate(pnode_t *x, int dir)
+{
+  pnode_t *y = x->link[!dir];
+  x->link[!dir] = y->link[dir];
+  y->link[dir] = x;
+  return y;
+}
+
+persistent_rbtree *new_persistent_rbtree(void)
+{
+  return (persistent_rbtree *)calloc(1, sizeof(persistent_rbtree));
+}
+
+void delete_persistent_rbtree(persistent_rbtree *tree)
+{
+  release(tree->root);
+  free(tree);
+}
+
+persistent_rbtree *persistent_rbtree_snapshot(const persistent_rbtree *tree)
+{
+  persistent_rbtree *snap = (persistent_rbtree *)malloc(sizeof(persistent_rbtree));
+  *snap = *tree;
+  acquire(snap->root);
+  return snap;
+}
+
+size_t persistent_rbtree_node_bytes(void)
+{
+  return __atomic_load_n(&live_nodes, __ATOMIC_RELAXED) * sizeof(pnode_t);
+}
+
+size_t persistent_rbtree_size(const persistent_rbtree *tree)
+{
+  return tree->count;
+}
+
+void persistent_rbtree_insert(persistent_rbtree *tree, const key_t key)
+{
+  pnode_t *path[MAX_PATH];
+  int dirs[MAX_PATH];
+  int depth = 0;
+
+  // 삽입할 위치까지 내려가며 경로의 node를 이 version 것으로 만든다 (같은 key는 오른쪽으로)
+  pnode_t **slot = &tree->root;
+  while (*slot != NULL)
+  {
+    pnode_t *x = own(slot);
+    path[depth] = x;
+    dirs[depth] = (x->key <= key);
+    slot = &x->link[dirs[depth]];
+    depth++;
+  }
+
+  pnode_t *node = alloc_node();
+  node->key = key;
+  node->color = RBTREE_RED;
+  node->link[0] = node->link[1] = NULL;
+  node->refs = 1;
+  *slot = node;
+  tree->count++;
+
+  // 삽입 이후 리밸런싱: path[depth]가 red인 현재 노드
+  path[depth] = node;
+  while (depth >= 2 && is_red(path[depth - 1]))
+  {
+    pnode_t *parent = path[depth - 1];
+    pnode_t *grand_parent = path[depth - 2];
+    int parent_dir = dirs[depth - 2];
+
+    if (is_red(grand_parent->link[!parent_dir]))
+    {
+      // uncle은 경로 밖이라 색을 바꾸기 전에 복사해야 할 수 있다
+      pnode_t *uncle = own(&grand_parent->link[!parent_dir]);
+      parent->color = uncle->color = RBTREE_BLACK;
+      grand_parent->color = RBTREE_RED;
+      depth -= 2;
+      continue;
+    }
+
+    // 안쪽 자식이면 parent를 돌려 바깥쪽으로 만든다
+    if (dirs[depth - 1] != parent_dir)
+      grand_parent->link[parent_dir] = rotate(parent, parent_dir);
+    pnode_t *top = rotate(grand_parent, !parent_dir);
+    *slot_at(tree, path, dirs, depth - 2) = top;
+    top->color = RBTREE_BLACK;
+    grand_parent->color = RBTREE_RED;
+    break;
+  }
+  tree->root->color = RBTREE_BLACK;
+}
+
+int persistent_rbtree_erase(persistent_rbtree *tree, const key_t key)
+{
+  pnode_t *path[MAX_PATH];
+  int dirs[MAX_PATH];
+  int depth = 0;
+
+  // 없는 key로 경로를 복사하지 않도록 먼저 읽기만 해서 확인한다
+  if (persistent_rbtree_find(tree, key) == NULL)
+    return -1;
+
+  pnode_t **slot = &tree->root;
+  pnode_t *target = own(slot);
+  while (target->key != key)
+  {
+    path[depth] = target;
+    dirs[depth] = (key > target->key);
+    slot = &target->link[dirs[depth]];
+    depth++;
+    target = own(slot);
+  }
+  path[depth++] = target;
+
+  // 자식이 둘이면 successor의 key를 옮기고 successor를 대신 삭제
+  pnode_t *removed = target;
+  if (target->link[0] != NULL && target->link[1] != NULL)
+  {
+    dirs[depth - 1] = 1;
+    removed = own(&target->link[1]);
+    path[depth++] = removed;
+    while (removed->link[0] != NULL)
+    {
+      dirs[depth - 1] = 0;
+      removed = own(&removed->link[0]);
+      path[depth++] = removed;
+    }
+    target->key = removed->key;
+  }
+
+  // removed는 자식이 하나 이하: 자식에 대한 참조를 그대로 넘겨주고 removed만 해제한다
+  depth--;
+  pnode_t *replace_node = removed->link[removed->link[0] == NULL];
+  int is_removed_black = !is_red(removed);
+  *slot_at(tree, path, dirs, depth) = replace_node;
+  free(removed);
+  __atomic_sub_fetch(&live_nodes, 1, __ATOMIC_RELAXED);
+  tree->count--;
+
+  if (!is_removed_black)
+    return 0;
+  if (is_red(replace_node))
+  {
+    own(slot_at(tree, path, dirs, depth))->color = RBTREE_BLACK;
+    return 0;
+  }
+
+  // erase 리밸런싱: path[i]의 dir 방향에 extra black이 있다
+  // 색을 바꾸거나 회전시키는 sibling과 조카는 그 전에 이 version 것으로 만든다
+  int i = depth - 1;
+  while (i >= 0)
+  {
+    pnode_t *parent = path[i];
+    int dir = dirs[i];
+    pnode_t *sibling = own(&parent->link[!dir]);
+
+    if (is_red(sibling))
+    {
+      sibling->color = RBTREE_BLACK;
+      parent->color = RBTREE_RED;
+      *slot_at(tree, path, dirs, i) = rotate(parent, dir);
+      // sibling이 parent 위로 올라왔으므로 경로에 끼워 넣는다
+      path[i] = sibling;
+      dirs[i] = dir;
+      path[i + 1] = parent;
+      dirs[i + 1] = dir;
+      i++;
+      sibling = own(&parent->link[!dir]);
+    }
+
+    if (!is_red(sibling->link[0]) && !is_red(sibling->link[1]))
+    {
+      sibling->color = RBTREE_RED;
+      if (is_red(parent))
+      {
+        parent->color = RBTREE_BLACK;
+        break;
+      }
+      i--;
+      continue;
+    }
+
+    if (!is_red(sibling->link[!dir]))
+    {
+      own(&sibling->link[dir])->color = RBTREE_BLACK;
+      sibling->color = RBTREE_RED;
+      sibling = rotate(sibling, !dir);
+      parent->link[!dir] = sibling;
+    }
+
+    sibling->color = parent->color;
+    parent->color = RBTREE_BLACK;
+    own(&sibling->link[!dir])->color = RBTREE_BLACK;
+    *slot_at(tree, path, dirs, i) = rotate(parent, dir);
+    break;
+  }
+  if (is_red(tree->root))
+    own(&tree->root)->color = RBTREE_BLACK;
+  return 0;
+}
+
+const key_t *persistent_rbtree_find(const persistent_rbtree *tree, const key_t key)
+{
+  const pnode_t *x = tree->root;
+  while (x != NULL)
+  {
+    if (key == x->key)
+      return &x->key;
+    x = x->link[key > x->key];
+  }
+  return NULL;
+}
+
+const key_t *persistent_rbtree_lower_bound(const persistent_rbtree *tree, const key_t key)
+{
+  const pnode_t *x = tree->root;
+  const pnode_t *bound = NULL;
+  while (x != NULL)
+  {
+    if (x->key >= key)
+    {
+      bound = x;
+      x = x->link[0];
+    }
+    else
+      x = x->link[1];
+  }
+  return (bound != NULL) ? &bound->key : NULL;
+}
+
+// dir이 0이면 최소, 1이면 최대 key를 찾는 함수
+static const key_t *extreme(const persistent_rbtree *tree, int dir)
+{
+  const pnode_t *x = tree->root;
+  if (x == NULL)
+    return NULL;
+  while (x->link[dir] != NULL)
+    x = x->link[dir];
+  return &x->key;
+}
+
+const key_t *persistent_rbtree_min(const persistent_rbtree *tree)
+{
+  return extreme(tree, 0);
+}
+
+const key_t *persistent_rbtree_max(const persistent_rbtree *tree)
+{
+  return extreme(tree, 1);
+}
+
+int persistent_rbtree_to_array(const persistent_rbtree *tree, key_t *arr, const size_t n)
+{
+  const pnode_t *stack[MAX_PATH];
+  int top = 0;
+  size_t i = 0;
+  const pnode_t *x = tree->root;
+
+  while (i < n && (x != NULL || top > 0))
+  {
+    while (x != NULL)
+    {
+      stack[top++] = x;
+      x = x->link[0];
+    }
+    x = stack[--top];
+    arr[i++] = x->key;
+    x = x->link[1];
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef _RBTREE_PERSISTENT_H_
+#define _RBTREE_PERSISTENT_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Persistent (copy-on-write) variant of rbtree.h. A version is a root
+// pointer, and versions share every node they have in common. Each node
+// counts the versions and parent nodes that point at it. persistent_rbtree_
+// snapshot is O(1): the new version just takes a reference on the root.
+// insert and erase copy a node only when it is shared, so they copy the
+// O(log n) nodes on the search path plus the siblings the fixup recolors,
+// and a node nobody else can see is changed in place.
+//
+// The nodes have no parent links (a copied child could not fix its
+// parent's pointer), so the rebalancing walks a path stack as in
+// rbtree_compact.c. Keys move during erase and nodes are copied on write,
+// so a const key_t * from find, lower_bound, min or max is only valid until
+// that version is modified or deleted.
+//
+// A version is used by one thread at a time, and a snapshot is taken by the
+// thread that owns the source version. After that the two versions are
+// independent. Either can be read, modified or deleted on any thread while
+// the other is in use, because shared nodes are never written and the counts
+// are atomic.
+
+typedef struct pnode_t {
+  struct pnode_t *link[2];  // left, right (NULL leaves)
+  key_t key;
+  color_t color;
+  unsigned refs;  // versions and parent nodes pointing here
+} pnode_t;
+
+typedef struct {
+  pnode_t *root;
+  size_t count;
+} persistent_rbtree;
+
+persistent_rbtree *new_persistent_rbtree(void);
+// drops this version; nodes still shared with other versions stay
+void delete_persistent_rbtree(persistent_rbtree *);
+// O(1) point-in-time copy of the version
+persistent_rbtree *persistent_rbtree_snapshot(const persistent_rbtree *);
+
+void persistent_rbtree_insert(persistent_rbtree *, const key_t);
+// removes one copy of key; 0 on success, -1 if key is not in the version
+int persistent_rbtree_erase(persistent_rbtree *, const key_t);
+
+const key_t *persistent_rbtree_find(const persistent_rbtree *, const key_t);
+const key_t *persistent_rbtree_lower_bound(const persistent_rbtree *,
+                                           const key_t);
+const key_t *persistent_rbtree_min(const persistent_rbtree *);
+const key_t *persistent_rbtree_max(const persistent_rbtree *);
+
+size_t persistent_rbtree_size(const persistent_rbtree *);
+int persistent_rbtree_to_array(const persistent_rbtree *, key_t *,
+                               const size_t);
+
+// bytes in live nodes across every version in the process, for
+// memory-overhead reports
+size_t persistent_rbtree_node_bytes(void);
+
+#endif  // _RBTREE_PERSISTENT_H_
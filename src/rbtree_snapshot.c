@@ -0,0 +1,333 @@
+#include "rbtree_snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// prefix 배열은 mapping을 그대로 size_t 배열로 읽는다
+_Static_assert(sizeof(size_t) == sizeof(uint64_t), "snapshot prefix is read as size_t");
+
+// 파일에 한 번에 write하는 크기
+#define SNAPSHOT_BLOCK_BYTES (64 * 1024)
+
+typedef struct
+{
+  int fd;
+  uint64_t sum1, sum2;  // checksum 중간 값
+  size_t used;
+  unsigned char buf[SNAPSHOT_BLOCK_BYTES];
+} snapshot_writer_t;
+
+// 32-bit word마다 두 합을 쌓는 Fletcher 방식 checksum (len은 4의 배수)
+static void checksum_update(uint64_t *sum1, uint64_t *sum2, const unsigned char *p, size_t len)
+{
+  uint64_t s1 = *sum1, s2 = *sum2;
+  for (size_t i = 0; i < len; i += 4)
+  {
+    uint32_t word;
+    memcpy(&word, p + i, sizeof(word));
+    s1 += word;
+    s2 += s1;
+  }
+  *sum1 = s1;
+  *sum2 = s2;
+}
+
+static uint64_t checksum_final(uint64_t sum1, uint64_t sum2)
+{
+  return sum1 ^ ((sum2 << 32) | (sum2 >> 32));
+}
+
+// buf의 len byte를 fd에 모두 쓰는 함수 (짧은 write와 EINTR은 이어서 쓴다)
+static int write_fully(int fd, const unsigned char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    const ssize_t written = write(fd, buf, len);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += written;
+    len -= (size_t)written;
+  }
+  return 0;
+}
+
+// 모아 둔 byte를 checksum에 더하고 파일에 쓰는 함수
+static int writer_flush(snapshot_writer_t *w)
+{
+  checksum_update(&w->sum1, &w->sum2, w->buf, w->used);
+  const int result = write_fully(w->fd, w->buf, w->used);
+  w->used = 0;
+  return result;
+}
+
+// len byte (4나 8)를 buffer에 붙이는 함수
+static int writer_put(snapshot_writer_t *w, const void *p, size_t len)
+{
+  if (w->used + len > SNAPSHOT_BLOCK_BYTES && writer_flush(w) != 0)
+    return -1;
+  memcpy(w->buf + w->used, p, len);
+  w->used += len;
+  return 0;
+}
+
+// header 뒤에 key 배열과 (필요하면) prefix 배열을 쓰고 header의 distinct와 flags를 채우는 함수
+static int write_body(snapshot_writer_t *w, const rbtree *tree, rbtree_snapshot_header_t *header)
+{
+  key_t last = 0;
+  node_t *p;
+  for (p = rbtree_iter_begin(tree); p != NULL; p = rbtree_iter_next(tree, p))
+  {
+    // plain tree에서는 같은 key가 여러 node에 이어서 나온다
+    if (header->distinct > 0 && p->key == last)
+      continue;
+    if (writer_put(w, &p->key, sizeof(key_t)) != 0)
+      return -1;
+    last = p->key;
+    header->distinct++;
+  }
+  const uint64_t zero = 0;
+  const size_t keys_bytes = header->distinct * sizeof(key_t);
+  if (keys_bytes % 8 != 0 && writer_put(w, &zero, 8 - keys_bytes % 8) != 0)
+    return -1;
+  if (header->distinct == header->total)
+    return writer_flush(w);
+
+  // 같은 key가 있을 때만 tree를 한 번 더 돌며 prefix를 쓴다
+  header->flags |= RBTREE_SNAPSHOT_PREFIX;
+  uint64_t before = 0;
+  for (p = rbtree_iter_begin(tree); p != NULL; p = rbtree_iter_next(tree, p))
+  {
+    if ((before == 0 || p->key != last) && writer_put(w, &before, sizeof(before)) != 0)
+      return -1;
+    before += rbtree_node_count(p);
+    last = p->key;
+  }
+  if (writer_put(w, &before, sizeof(before)) != 0)
+    return -1;
+  return writer_flush(w);
+}
+
+int rbtree_save(const rbtree *tree, const char *path)
+{
+  rbtree_snapshot_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RBTREE_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = RBTREE_SNAPSHOT_VERSION;
+  header.key_size = sizeof(key_t);
+  header.total = rbtree_size(tree);
+  if (tree->counted)
+    header.flags |= RBTREE_SNAPSHOT_COUNTED;
+
+  // 임시 파일에 다 쓴 뒤 rename으로 바꿔치기한다
+  const size_t path_len = strlen(path);
+  char *tmp_path = (char *)malloc(path_len + sizeof(".tmp"));
+  snapshot_writer_t *w = (snapshot_writer_t *)malloc(sizeof(snapshot_writer_t));
+  if (tmp_path == NULL || w == NULL)
+  {
+    free(tmp_path);
+    free(w);
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+  int result = -1;
+  w->fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  w->sum1 = w->sum2 = 0;
+  w->used = 0;
+  if (w->fd >= 0)
+  {
+    // checksum과 distinct는 body를 다 쓴 뒤에 알 수 있으므로 header는 두 번 쓴다
+    if (write_fully(w->fd, (const unsigned char *)&header, sizeof(header)) == 0 &&
+        write_body(w, tree, &header) == 0)
+    {
+      header.checksum = checksum_final(w->sum1, w->sum2);
+      if (pwrite(w->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fsync(w->fd) == 0)
+        result = 0;
+    }
+    const int saved_errno = errno;
+    if (close(w->fd) != 0)
+      result = -1;
+    else
+      errno = saved_errno;
+    if (result == 0 && rename(tmp_path, path) != 0)
+      result = -1;
+    if (result != 0)
+    {
+      const int error = errno;
+      unlink(tmp_path);
+      errno = error;
+    }
+  }
+
+  free(w);
+  free(tmp_path);
+  return result;
+}
+
+// mapping이 온전한 snapshot인지 확인하는 함수 (header, 크기, checksum, key 순서)
+static int snapshot_valid(const unsigned char *map, size_t size)
+{
+  rbtree_snapshot_header_t header;
+  if (size < sizeof(header))
+    return 0;
+  memcpy(&header, map, sizeof(header));
+  if (memcmp(header.magic, RBTREE_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != RBTREE_SNAPSHOT_VERSION || header.key_size != sizeof(key_t) ||
+      (header.flags & ~(RBTREE_SNAPSHOT_COUNTED | RBTREE_SNAPSHOT_PREFIX)) != 0)
+    return 0;
+
+  const size_t body = size - sizeof(header);
+  if (header.distinct > body / sizeof(key_t) || header.distinct > header.total)
+    return 0;
+  const size_t keys_bytes = (header.distinct * sizeof(key_t) + 7) / 8 * 8;
+  const int has_prefix = (header.flags & RBTREE_SNAPSHOT_PREFIX) != 0;
+  const size_t prefix_bytes = has_prefix ? (header.distinct + 1) * sizeof(uint64_t) : 0;
+  if (body != keys_bytes + prefix_bytes || (!has_prefix && header.distinct != header.total))
+    return 0;
+
+  uint64_t sum1 = 0, sum2 = 0;
+  checksum_update(&sum1, &sum2, map + sizeof(header), body);
+  if (checksum_final(sum1, sum2) != header.checksum)
+    return 0;
+
+  // 올바른 checksum이어도 순서가 틀린 파일로 tree를 만들지 않도록 확인한다
+  const key_t *keys = (const key_t *)(map + sizeof(header));
+  for (size_t i = 1; i < header.distinct; i++)
+    if (keys[i - 1] >= keys[i])
+      return 0;
+  if (has_prefix)
+  {
+    const uint64_t *prefix = (const uint64_t *)(map + sizeof(header) + keys_bytes);
+    if (prefix[0] != 0 || prefix[header.distinct] != header.total)
+      return 0;
+    for (size_t i = 0; i < header.distinct; i++)
+      if (prefix[i] >= prefix[i + 1])
+        return 0;
+  }
+  return 1;
+}
+
+rbtree_snapshot_t *rbtree_snapshot_open(const char *path)
+{
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return NULL;
+  }
+  const size_t size = (size_t)st.st_size;
+  if (size < sizeof(rbtree_snapshot_header_t))
+  {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+  if (!snapshot_valid((const unsigned char *)map, size))
+  {
+    munmap(map, size);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  rbtree_snapshot_header_t header;
+  memcpy(&header, map, sizeof(header));
+  rbtree_snapshot_t *snap = (rbtree_snapshot_t *)calloc(1, sizeof(rbtree_snapshot_t));
+  const unsigned char *body = (const unsigned char *)map + sizeof(header);
+  snap->map = map;
+  snap->map_size = size;
+  snap->keys = (const key_t *)body;
+  if (header.flags & RBTREE_SNAPSHOT_PREFIX)
+    snap->prefix = (const size_t *)(body + (header.distinct * sizeof(key_t) + 7) / 8 * 8);
+  snap->distinct = header.distinct;
+  snap->total = header.total;
+  snap->counted = (header.flags & RBTREE_SNAPSHOT_COUNTED) != 0;
+  return snap;
+}
+
+void rbtree_snapshot_close(rbtree_snapshot_t *snap)
+{
+  munmap(snap->map, snap->map_size);
+  free(snap);
+}
+
+size_t rbtree_snapshot_size(const rbtree_snapshot_t *snap)
+{
+  return snap->total;
+}
+
+// key 이상인 첫 key의 index를 이분 탐색으로 찾는 함수 (없으면 distinct)
+static size_t lower_index(const rbtree_snapshot_t *snap, const key_t key)
+{
+  size_t lo = 0, hi = snap->distinct;
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (snap->keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+const key_t *rbtree_snapshot_find(const rbtree_snapshot_t *snap, const key_t key)
+{
+  const size_t i = lower_index(snap, key);
+  return (i < snap->distinct && snap->keys[i] == key) ? &snap->keys[i] : NULL;
+}
+
+const key_t *rbtree_snapshot_lower_bound(const rbtree_snapshot_t *snap, const key_t key)
+{
+  const size_t i = lower_index(snap, key);
+  return (i < snap->distinct) ? &snap->keys[i] : NULL;
+}
+
+size_t rbtree_snapshot_rank(const rbtree_snapshot_t *snap, const key_t key)
+{
+  const size_t i = lower_index(snap, key);
+  return (snap->prefix != NULL) ? snap->prefix[i] : i;
+}
+
+size_t rbtree_snapshot_count_range(const rbtree_snapshot_t *snap, const key_t lo, const key_t hi)
+{
+  if (lo >= hi)
+    return 0;
+  return rbtree_snapshot_rank(snap, hi) - rbtree_snapshot_rank(snap, lo);
+}
+
+rbtree *rbtree_snapshot_thaw(const rbtree_snapshot_t *snap)
+{
+  return rbtree_from_sorted_runs(snap->keys, snap->prefix, snap->distinct, snap->counted);
+}
+
+rbtree *rbtree_load(const char *path)
+{
+  rbtree_snapshot_t *snap = rbtree_snapshot_open(path);
+  if (snap == NULL)
+    return NULL;
+  rbtree *tree = rbtree_snapshot_thaw(snap);
+  rbtree_snapshot_close(snap);
+  return tree;
+}
@@ -0,0 +1,73 @@
+#ifndef _RBTREE_SNAPSHOT_H_
+#define _RBTREE_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// Snapshot files of rbtree.h trees.
+//
+// A file is a header, the distinct keys in ascending order (padded to 8
+// bytes) and, only if some key occurs more than once, prefix[0..distinct]
+// where prefix[i] is the number of keys before keys[i]. Integers are in host
+// byte order; a file written with a different key_t size or version is
+// rejected, and so is one whose checksum does not match.
+//
+// rbtree_load maps the file and builds the tree in O(n) with no per-key
+// descent. rbtree_snapshot_open keeps the mapping instead and answers lookups
+// and order statistics from the sorted arrays; rbtree_snapshot_thaw builds a
+// writable tree from it before the first write.
+
+#define RBTREE_SNAPSHOT_MAGIC "RBTSNAP"
+#define RBTREE_SNAPSHOT_VERSION 1
+
+// header flags
+#define RBTREE_SNAPSHOT_COUNTED 1  // saved from a counted tree
+#define RBTREE_SNAPSHOT_PREFIX 2   // prefix array follows the keys
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t key_size;
+  uint32_t reserved;
+  uint64_t distinct;  // number of keys stored
+  uint64_t total;     // number of keys in the tree, counting every copy
+  uint64_t checksum;  // over everything after the header
+} rbtree_snapshot_header_t;
+
+// read-only view of a mapped snapshot
+typedef struct {
+  void *map;
+  size_t map_size;
+  const key_t *keys;     // distinct keys, ascending
+  const size_t *prefix;  // NULL if every key occurs once
+  size_t distinct, total;
+  int counted;
+} rbtree_snapshot_t;
+
+// 0 on success, -1 with errno set. The file is written next to path and
+// renamed over it, so a crash never leaves a half-written snapshot.
+int rbtree_save(const rbtree *, const char *);
+// NULL with errno set if the file is missing or invalid (EINVAL)
+rbtree *rbtree_load(const char *);
+
+rbtree_snapshot_t *rbtree_snapshot_open(const char *);
+void rbtree_snapshot_close(rbtree_snapshot_t *);
+
+// queries on the mapped arrays, all O(log n). find and lower_bound return a
+// pointer into keys or NULL; rank and count_range count every copy like
+// rbtree_rank and rbtree_count_range.
+size_t rbtree_snapshot_size(const rbtree_snapshot_t *);
+const key_t *rbtree_snapshot_find(const rbtree_snapshot_t *, const key_t);
+const key_t *rbtree_snapshot_lower_bound(const rbtree_snapshot_t *,
+                                         const key_t);
+size_t rbtree_snapshot_rank(const rbtree_snapshot_t *, const key_t);
+size_t rbtree_snapshot_count_range(const rbtree_snapshot_t *, const key_t,
+                                   const key_t);
+
+// writable tree with the snapshot's keys (and mode); the snapshot stays open
+rbtree *rbtree_snapshot_thaw(const rbtree_snapshot_t *);
+
+#endif  // _RBTREE_SNAPSHOT_H_
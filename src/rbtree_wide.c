@@ -0,0 +1,497 @@
+#include "rbtree_wide.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(RBTREE_WIDE_SCALAR) && defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#define WIDE_SIMD
+// vector 비교는 key를 32-bit 정수로 다룬다
+_Static_assert(sizeof(key_t) == 4, "wide node search compares 32-bit keys");
+#endif
+
+// 합치기 전까지 node가 가져야 하는 최소 key (inner는 separator) 개수
+#define WIDE_MIN (WIDE_KEYS / 2)
+// root에서 leaf까지의 경로 길이 상한 (inner node는 자식이 WIDE_MIN + 1개 이상)
+#define WIDE_MAX_HEIGHT 32
+
+// node 하나를 cache line 경계에 맞춰 할당하는 함수 (빈 slot도 0으로 채워 둔다)
+static void *alloc_aligned(size_t bytes)
+{
+  bytes = (bytes + 63) / 64 * 64;
+  void *p = aligned_alloc(64, bytes);
+  memset(p, 0, bytes);
+  return p;
+}
+
+static wide_leaf_t *new_leaf(wide_rbtree *tree)
+{
+  tree->leaves++;
+  return (wide_leaf_t *)alloc_aligned(sizeof(wide_leaf_t));
+}
+
+static wide_inner_t *new_inner(wide_rbtree *tree)
+{
+  tree->inners++;
+  return (wide_inner_t *)alloc_aligned(sizeof(wide_inner_t));
+}
+
+#ifdef WIDE_SIMD
+// keys[0..WIDE_KEYS) 중 key보다 작은 (less) 또는 큰 slot의 bit mask를 구하는 함수
+static inline unsigned compare_mask(const key_t *keys, const key_t key, const int less)
+{
+#ifdef __AVX2__
+  const __m256i k = _mm256_set1_epi32(key);
+  unsigned mask = 0;
+  for (int i = 0; i < WIDE_KEYS; i += 8)
+  {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(keys + i));
+    const __m256i c = less ? _mm256_cmpgt_epi32(k, v) : _mm256_cmpgt_epi32(v, k);
+    mask |= (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(c)) << i;
+  }
+  return mask;
+#else
+  const __m128i k = _mm_set1_epi32(key);
+  unsigned mask = 0;
+  for (int i = 0; i < WIDE_KEYS; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+    const __m128i c = less ? _mm_cmpgt_epi32(k, v) : _mm_cmpgt_epi32(v, k);
+    mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(c)) << i;
+  }
+  return mask;
+#endif
+}
+
+// keys[0..count) 중 key보다 작은 key의 개수
+static inline size_t count_less(const key_t *keys, const size_t count, const key_t key)
+{
+  return (size_t)__builtin_popcount(compare_mask(keys, key, 1) & ((1u << count) - 1));
+}
+
+// keys[0..count) 중 key 이하인 key의 개수
+static inline size_t count_less_equal(const key_t *keys, const size_t count, const key_t key)
+{
+  return count - (size_t)__builtin_popcount(compare_mask(keys, key, 0) & ((1u << count) - 1));
+}
+#else
+static inline size_t count_less(const key_t *keys, const size_t count, const key_t key)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++)
+    n += keys[i] < key;
+  return n;
+}
+
+static inline size_t count_less_equal(const key_t *keys, const size_t count, const key_t key)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++)
+    n += keys[i] <= key;
+  return n;
+}
+#endif
+
+const char *wide_rbtree_engine(void)
+{
+#if defined(WIDE_SIMD) && defined(__AVX2__)
+  return "avx2";
+#elif defined(WIDE_SIMD)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+wide_rbtree *new_wide_rbtree(void)
+{
+  wide_rbtree *tree = (wide_rbtree *)calloc(1, sizeof(wide_rbtree));
+  // 빈 tree도 빈 leaf 하나를 root로 둔다
+  wide_leaf_t *leaf = new_leaf(tree);
+  tree->root = leaf;
+  tree->first = tree->last = leaf;
+  return tree;
+}
+
+// height 단계의 inner node 아래를 모두 해제하는 함수
+static void free_subtree(void *node, const size_t height)
+{
+  if (height > 0)
+  {
+    wide_inner_t *inner = (wide_inner_t *)node;
+    for (size_t i = 0; i <= inner->count; i++)
+      free_subtree(inner->child[i], height - 1);
+  }
+  free(node);
+}
+
+void delete_wide_rbtree(wide_rbtree *tree)
+{
+  free_subtree(tree->root, tree->height);
+  free(tree);
+}
+
+// key 이상인 첫 key의 위치를 찾는 함수 (leaf가 NULL이면 없음)
+// 각 단계에서 key보다 작은 separator 개수번째 자식으로 내려가므로, 왼쪽 leaf들은 모두 key보다 작다
+static const wide_leaf_t *lower_bound_leaf(const wide_rbtree *tree, const key_t key, size_t *index)
+{
+  const void *node = tree->root;
+  for (size_t h = tree->height; h > 0; h--)
+  {
+    const wide_inner_t *inner = (const wide_inner_t *)node;
+    node = inner->child[count_less(inner->keys, inner->count, key)];
+  }
+  const wide_leaf_t *leaf = (const wide_leaf_t *)node;
+  const size_t i = count_less(leaf->keys, leaf->count, key);
+  if (i < leaf->count)
+  {
+    *index = i;
+    return leaf;
+  }
+  // leaf의 key가 모두 key보다 작으면 답은 다음 leaf의 첫 key다
+  *index = 0;
+  return leaf->next;
+}
+
+const key_t *wide_rbtree_lower_bound(const wide_rbtree *tree, const key_t key)
+{
+  size_t i;
+  const wide_leaf_t *leaf = lower_bound_leaf(tree, key, &i);
+  return (leaf != NULL) ? &leaf->keys[i] : NULL;
+}
+
+const key_t *wide_rbtree_find(const wide_rbtree *tree, const key_t key)
+{
+  const key_t *p = wide_rbtree_lower_bound(tree, key);
+  return (p != NULL && *p == key) ? p : NULL;
+}
+
+const key_t *wide_rbtree_min(const wide_rbtree *tree)
+{
+  return (tree->count > 0) ? &tree->first->keys[0] : NULL;
+}
+
+const key_t *wide_rbtree_max(const wide_rbtree *tree)
+{
+  return (tree->count > 0) ? &tree->last->keys[tree->last->count - 1] : NULL;
+}
+
+size_t wide_rbtree_size(const wide_rbtree *tree)
+{
+  return tree->count;
+}
+
+// 가득 찬 leaf에 key를 i번째로 넣으면서 반으로 나누고, 새 오른쪽 leaf를 돌려주는 함수
+static wide_leaf_t *split_leaf(wide_rbtree *tree, wide_leaf_t *leaf, const size_t i, const key_t key)
+{
+  wide_leaf_t *right = new_leaf(tree);
+  right->count = WIDE_KEYS - WIDE_MIN;
+  memcpy(right->keys, leaf->keys + WIDE_MIN, right->count * sizeof(key_t));
+  leaf->count = WIDE_MIN;
+
+  wide_leaf_t *target = (i <= WIDE_MIN) ? leaf : right;
+  const size_t at = (i <= WIDE_MIN) ? i : i - WIDE_MIN;
+  memmove(target->keys + at + 1, target->keys + at, (target->count - at) * sizeof(key_t));
+  target->keys[at] = key;
+  target->count++;
+
+  right->prev = leaf;
+  right->next = leaf->next;
+  if (leaf->next != NULL)
+    leaf->next->prev = right;
+  else
+    tree->last = right;
+  leaf->next = right;
+  return right;
+}
+
+// inner node의 i번째 separator 자리에 (sep, 오른쪽 자식)을 넣는 함수 (자리가 있을 때)
+static void inner_insert_at(wide_inner_t *inner, const size_t i, const key_t sep, void *right)
+{
+  memmove(inner->keys + i + 1, inner->keys + i, (inner->count - i) * sizeof(key_t));
+  memmove(inner->child + i + 2, inner->child + i + 1, (inner->count - i) * sizeof(void *));
+  inner->keys[i] = sep;
+  inner->child[i + 1] = right;
+  inner->count++;
+}
+
+// 가득 찬 inner node에 (sep, right)를 i번째로 넣으면서 나누는 함수
+// 가운데 separator는 *up으로 올려 보내고 새 오른쪽 node를 돌려준다
+static wide_inner_t *split_inner(wide_rbtree *tree, wide_inner_t *inner, const size_t i, const key_t sep,
+                                 void *right, key_t *up)
+{
+  key_t keys[WIDE_KEYS + 1];
+  void *child[WIDE_KEYS + 2];
+  memcpy(keys, inner->keys, i * sizeof(key_t));
+  keys[i] = sep;
+  memcpy(keys + i + 1, inner->keys + i, (WIDE_KEYS - i) * sizeof(key_t));
+  memcpy(child, inner->child, (i + 1) * sizeof(void *));
+  child[i + 1] = right;
+  memcpy(child + i + 2, inner->child + i + 1, (WIDE_KEYS - i) * sizeof(void *));
+
+  wide_inner_t *sibling = new_inner(tree);
+  inner->count = WIDE_MIN;
+  memcpy(inner->keys, keys, WIDE_MIN * sizeof(key_t));
+  memcpy(inner->child, child, (WIDE_MIN + 1) * sizeof(void *));
+  *up = keys[WIDE_MIN];
+  sibling->count = WIDE_KEYS - WIDE_MIN;
+  memcpy(sibling->keys, keys + WIDE_MIN + 1, sibling->count * sizeof(key_t));
+  memcpy(sibling->child, child + WIDE_MIN + 1, (sibling->count + 1) * sizeof(void *));
+  return sibling;
+}
+
+void wide_rbtree_insert(wide_rbtree *tree, const key_t key)
+{
+  // 같은 key는 오른쪽으로 가도록 key 이하인 separator 개수번째 자식으로 내려간다
+  wide_inner_t *path[WIDE_MAX_HEIGHT];
+  size_t slot[WIDE_MAX_HEIGHT];
+  void *node = tree->root;
+  for (size_t h = 0; h < tree->height; h++)
+  {
+    wide_inner_t *inner = (wide_inner_t *)node;
+    path[h] = inner;
+    slot[h] = count_less_equal(inner->keys, inner->count, key);
+    node = inner->child[slot[h]];
+  }
+  tree->count++;
+
+  wide_leaf_t *leaf = (wide_leaf_t *)node;
+  const size_t i = count_less_equal(leaf->keys, leaf->count, key);
+  if (leaf->count < WIDE_KEYS)
+  {
+    memmove(leaf->keys + i + 1, leaf->keys + i, (leaf->count - i) * sizeof(key_t));
+    leaf->keys[i] = key;
+    leaf->count++;
+    return;
+  }
+
+  // 나눠진 node의 (separator, 오른쪽 node)를 자리가 있는 조상까지 올려 보낸다
+  void *right = split_leaf(tree, leaf, i, key);
+  key_t sep = ((wide_leaf_t *)right)->keys[0];
+  for (size_t h = tree->height; h > 0; h--)
+  {
+    wide_inner_t *parent = path[h - 1];
+    if (parent->count < WIDE_KEYS)
+    {
+      inner_insert_at(parent, slot[h - 1], sep, right);
+      return;
+    }
+    key_t up;
+    right = split_inner(tree, parent, slot[h - 1], sep, right, &up);
+    sep = up;
+  }
+
+  // root가 나눠졌으면 한 단계 높아진다
+  wide_inner_t *root = new_inner(tree);
+  root->count = 1;
+  root->keys[0] = sep;
+  root->child[0] = tree->root;
+  root->child[1] = right;
+  tree->root = root;
+  tree->height++;
+}
+
+// parent의 i번째 separator와 그 오른쪽 자식을 지우는 함수
+static void inner_remove_at(wide_inner_t *parent, const size_t i)
+{
+  memmove(parent->keys + i, parent->keys + i + 1, (parent->count - i - 1) * sizeof(key_t));
+  memmove(parent->child + i + 1, parent->child + i + 2, (parent->count - i - 1) * sizeof(void *));
+  parent->count--;
+}
+
+// parent의 child[i], child[i + 1] leaf를 왼쪽으로 합치는 함수
+static void merge_leaves(wide_rbtree *tree, wide_inner_t *parent, const size_t i)
+{
+  wide_leaf_t *left = (wide_leaf_t *)parent->child[i];
+  wide_leaf_t *right = (wide_leaf_t *)parent->child[i + 1];
+  memcpy(left->keys + left->count, right->keys, right->count * sizeof(key_t));
+  left->count += right->count;
+  left->next = right->next;
+  if (right->next != NULL)
+    right->next->prev = left;
+  else
+    tree->last = left;
+  free(right);
+  tree->leaves--;
+  inner_remove_at(parent, i);
+}
+
+// parent의 child[i], child[i + 1] inner node를 separator i와 함께 왼쪽으로 합치는 함수
+static void merge_inners(wide_rbtree *tree, wide_inner_t *parent, const size_t i)
+{
+  wide_inner_t *left = (wide_inner_t *)parent->child[i];
+  wide_inner_t *right = (wide_inner_t *)parent->child[i + 1];
+  left->keys[left->count] = parent->keys[i];
+  memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof(key_t));
+  memcpy(left->child + left->count + 1, right->child, (right->count + 1) * sizeof(void *));
+  left->count += 1 + right->count;
+  free(right);
+  tree->inners--;
+  inner_remove_at(parent, i);
+}
+
+// WIDE_MIN보다 작아진 parent->child[i]를 형제에게서 하나 빌리거나 형제와 합쳐 채우는 함수
+static void fix_underflow(wide_rbtree *tree, wide_inner_t *parent, const size_t i, const int leaf_level)
+{
+  if (leaf_level)
+  {
+    wide_leaf_t *c = (wide_leaf_t *)parent->child[i];
+    wide_leaf_t *l = (i > 0) ? (wide_leaf_t *)parent->child[i - 1] : NULL;
+    wide_leaf_t *r = (i < parent->count) ? (wide_leaf_t *)parent->child[i + 1] : NULL;
+    if (l != NULL && l->count > WIDE_MIN)
+    {
+      memmove(c->keys + 1, c->keys, c->count * sizeof(key_t));
+      c->keys[0] = l->keys[--l->count];
+      c->count++;
+      parent->keys[i - 1] = c->keys[0];
+    }
+    else if (r != NULL && r->count > WIDE_MIN)
+    {
+      c->keys[c->count++] = r->keys[0];
+      memmove(r->keys, r->keys + 1, --r->count * sizeof(key_t));
+      parent->keys[i] = r->keys[0];
+    }
+    else
+      merge_leaves(tree, parent, (l != NULL) ? i - 1 : i);
+    return;
+  }
+
+  // inner node는 parent의 separator를 거쳐 자식 하나를 옮긴다
+  wide_inner_t *c = (wide_inner_t *)parent->child[i];
+  wide_inner_t *l = (i > 0) ? (wide_inner_t *)parent->child[i - 1] : NULL;
+  wide_inner_t *r = (i < parent->count) ? (wide_inner_t *)parent->child[i + 1] : NULL;
+  if (l != NULL && l->count > WIDE_MIN)
+  {
+    memmove(c->keys + 1, c->keys, c->count * sizeof(key_t));
+    memmove(c->child + 1, c->child, (c->count + 1) * sizeof(void *));
+    c->keys[0] = parent->keys[i - 1];
+    c->child[0] = l->child[l->count];
+    c->count++;
+    parent->keys[i - 1] = l->keys[--l->count];
+  }
+  else if (r != NULL && r->count > WIDE_MIN)
+  {
+    c->keys[c->count] = parent->keys[i];
+    c->child[c->count + 1] = r->child[0];
+    c->count++;
+    parent->keys[i] = r->keys[0];
+    memmove(r->keys, r->keys + 1, (r->count - 1) * sizeof(key_t));
+    memmove(r->child, r->child + 1, r->count * sizeof(void *));
+    r->count--;
+  }
+  else
+    merge_inners(tree, parent, (l != NULL) ? i - 1 : i);
+}
+
+// height 단계 node 아래에서 key 하나를 지우는 함수 (지웠으면 1)
+// 오래된 separator가 key와 같으면 key가 이웃한 여러 자식에 걸쳐 있을 수 있어 차례로 찾아본다
+static int erase_below(wide_rbtree *tree, void *node, const size_t height, const key_t key)
+{
+  if (height == 0)
+  {
+    wide_leaf_t *leaf = (wide_leaf_t *)node;
+    const size_t i = count_less(leaf->keys, leaf->count, key);
+    if (i == leaf->count || leaf->keys[i] != key)
+      return 0;
+    memmove(leaf->keys + i, leaf->keys + i + 1, (leaf->count - i - 1) * sizeof(key_t));
+    leaf->count--;
+    return 1;
+  }
+
+  wide_inner_t *inner = (wide_inner_t *)node;
+  const size_t last = count_less_equal(inner->keys, inner->count, key);
+  for (size_t i = count_less(inner->keys, inner->count, key); i <= last; i++)
+  {
+    if (!erase_below(tree, inner->child[i], height - 1, key))
+      continue;
+    const size_t count = (height == 1) ? ((wide_leaf_t *)inner->child[i])->count
+                                       : ((wide_inner_t *)inner->child[i])->count;
+    if (count < WIDE_MIN)
+      fix_underflow(tree, inner, i, height == 1);
+    return 1;
+  }
+  return 0;
+}
+
+int wide_rbtree_erase(wide_rbtree *tree, const key_t key)
+{
+  if (!erase_below(tree, tree->root, tree->height, key))
+    return -1;
+  tree->count--;
+  // separator가 모두 없어진 root는 하나 남은 자식으로 바꾼다
+  if (tree->height > 0 && ((wide_inner_t *)tree->root)->count == 0)
+  {
+    wide_inner_t *old = (wide_inner_t *)tree->root;
+    tree->root = old->child[0];
+    tree->height--;
+    free(old);
+    tree->inners--;
+  }
+  return 0;
+}
+
+void wide_rbtree_cursor_begin(const wide_rbtree *tree, wide_cursor_t *cursor)
+{
+  cursor->leaf = tree->first;
+  cursor->index = 0;
+}
+
+size_t wide_rbtree_cursor_read(const wide_rbtree *tree, wide_cursor_t *cursor, key_t *buf, const size_t n)
+{
+  (void)tree;
+  size_t written = 0;
+  while (written < n && cursor->leaf != NULL)
+  {
+    const wide_leaf_t *leaf = cursor->leaf;
+    size_t take = leaf->count - cursor->index;
+    if (take > n - written)
+      take = n - written;
+    memcpy(buf + written, leaf->keys + cursor->index, take * sizeof(key_t));
+    written += take;
+    cursor->index += take;
+    if (cursor->index == leaf->count)
+    {
+      cursor->leaf = leaf->next;
+      cursor->index = 0;
+    }
+  }
+  return written;
+}
+
+int wide_rbtree_to_array(const wide_rbtree *tree, key_t *arr, const size_t n)
+{
+  wide_cursor_t cursor;
+  wide_rbtree_cursor_begin(tree, &cursor);
+  wide_rbtree_cursor_read(tree, &cursor, arr, n);
+  return 0;
+}
+
+size_t wide_rbtree_foreach_range(const wide_rbtree *tree, const key_t lo, const key_t hi,
+                                 int (*visit)(const key_t *, void *), void *ctx)
+{
+  size_t count = 0;
+  if (lo >= hi)
+    return 0;
+  size_t i;
+  for (const wide_leaf_t *leaf = lower_bound_leaf(tree, lo, &i); leaf != NULL; leaf = leaf->next, i = 0)
+  {
+    for (; i < leaf->count; i++)
+    {
+      if (leaf->keys[i] >= hi)
+        return count;
+      count++;
+      if (visit(&leaf->keys[i], ctx))
+        return count;
+    }
+  }
+  return count;
+}
+
+size_t wide_rbtree_memory(const wide_rbtree *tree)
+{
+  // alloc_aligned가 64 byte 단위로 올려 잡은 크기로 센다
+  const size_t leaf_bytes = (sizeof(wide_leaf_t) + 63) / 64 * 64;
+  const size_t inner_bytes = (sizeof(wide_inner_t) + 63) / 64 * 64;
+  return sizeof(wide_rbtree) + tree->leaves * leaf_bytes + tree->inners * inner_bytes;
+}
@@ -0,0 +1,78 @@
+#ifndef _RBTREE_WIDE_H_
+#define _RBTREE_WIDE_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// Wide-node variant of rbtree.h: a B+ tree whose nodes hold up to
+// WIDE_KEYS sorted keys in one cache line. A search compares the key against
+// a whole node at once (AVX2 or SSE2 when the compiler targets them, a plain
+// loop otherwise or with -DRBTREE_WIDE_SCALAR) and goes down one of
+// WIDE_KEYS + 1 children, so it visits a third as many nodes as a red-black
+// tree and has no per-key branch. Leaves are linked in order, so scans copy
+// whole leaves.
+//
+// Like rbtree.h it is a multiset. Keys move between nodes on every insert and
+// erase, so a const key_t * returned by find, lower_bound, min or max is only
+// valid until the next modification, and erase takes a key.
+
+#define WIDE_KEYS 16
+
+typedef struct wide_leaf_t {
+  key_t keys[WIDE_KEYS];  // keys[0..count) in order
+  struct wide_leaf_t *prev, *next;
+  size_t count;
+} wide_leaf_t;
+
+// child[i] holds keys between keys[i - 1] and keys[i] (both inclusive)
+typedef struct {
+  key_t keys[WIDE_KEYS];
+  void *child[WIDE_KEYS + 1];
+  size_t count;  // separators in use, count + 1 children
+} wide_inner_t;
+
+typedef struct {
+  void *root;     // a wide_leaf_t when height is 0, a wide_inner_t otherwise
+  size_t height;  // inner levels above the leaves
+  size_t count;
+  wide_leaf_t *first, *last;  // ends of the leaf list
+  size_t leaves, inners;      // node counts, for wide_rbtree_memory
+} wide_rbtree;
+
+wide_rbtree *new_wide_rbtree(void);
+void delete_wide_rbtree(wide_rbtree *);
+
+void wide_rbtree_insert(wide_rbtree *, const key_t);
+const key_t *wide_rbtree_find(const wide_rbtree *, const key_t);
+const key_t *wide_rbtree_lower_bound(const wide_rbtree *, const key_t);
+const key_t *wide_rbtree_min(const wide_rbtree *);
+const key_t *wide_rbtree_max(const wide_rbtree *);
+// removes one copy of key; 0 on success, -1 if key is not in the tree
+int wide_rbtree_erase(wide_rbtree *, const key_t);
+
+size_t wide_rbtree_size(const wide_rbtree *);
+int wide_rbtree_to_array(const wide_rbtree *, key_t *, const size_t);
+
+// same contract as rbtree_cursor_t: each read copies the next keys in order,
+// a leaf at a time, and returns how many it wrote (0 at the end)
+typedef struct {
+  const wide_leaf_t *leaf;
+  size_t index;
+} wide_cursor_t;
+
+void wide_rbtree_cursor_begin(const wide_rbtree *, wide_cursor_t *);
+size_t wide_rbtree_cursor_read(const wide_rbtree *, wide_cursor_t *, key_t *,
+                               const size_t);
+
+// visits the keys in [lo, hi) in order until visit returns nonzero and
+// returns how many it visited; visit must not modify the tree
+size_t wide_rbtree_foreach_range(const wide_rbtree *, const key_t, const key_t,
+                                 int (*)(const key_t *, void *), void *);
+
+// bytes owned by the tree, for memory-per-key reports
+size_t wide_rbtree_memory(const wide_rbtree *);
+// "avx2", "sse2" or "scalar": the node search this file was built with
+const char *wide_rbtree_engine(void);
+
+#endif  // _RBTREE_WIDE_H_
@@ -0,0 +1,190 @@
+#include <assert.h>
+#include <rbtree_compact.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LINK_MASK 0x7fffffffu
+#define RED_BIT 0x80000000u
+
+static uint32_t left_of(const compact_rbtree *t, uint32_t x) {
+  return t->nodes[x].link[0] & LINK_MASK;
+}
+
+static uint32_t right_of(const compact_rbtree *t, uint32_t x) {
+  return t->nodes[x].link[1] & LINK_MASK;
+}
+
+static bool red(const compact_rbtree *t, uint32_t x) {
+  return (t->nodes[x].link[0] & RED_BIT) != 0;
+}
+
+// checks search order, colors, black heights and (optionally) parent links;
+// returns the black height or -1 on violation
+static int check_subtree(const compact_rbtree *t, uint32_t x, uint32_t parent,
+                         key_t *min, key_t *max) {
+  if (x == 0) {
+    return 1;
+  }
+#ifdef RBTREE_COMPACT_PARENT
+  if (t->nodes[x].parent != parent) {
+    return -1;
+  }
+#endif
+  const key_t key = t->nodes[x].key;
+  if (red(t, x) && (red(t, left_of(t, x)) || red(t, right_of(t, x)))) {
+    return -1;
+  }
+  key_t l_min = key, l_max = key, r_min = key, r_max = key;
+  const int lh = check_subtree(t, left_of(t, x), x, &l_min, &l_max);
+  const int rh = check_subtree(t, right_of(t, x), x, &r_min, &r_max);
+  if (lh < 0 || lh != rh || l_max > key || r_min < key) {
+    return -1;
+  }
+  *min = l_min;
+  *max = r_max;
+  return lh + (red(t, x) ? 0 : 1);
+}
+
+static void test_constraints(const compact_rbtree *t) {
+  key_t min, max;
+  assert(!red(t, t->root));
+  assert(!red(t, 0));
+  assert(check_subtree(t, t->root, 0, &min, &max) > 0);
+}
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1, e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// compact tree should hold the same multiset as a sorted reference array
+static void check_contents(const compact_rbtree *t, key_t *ref, size_t n) {
+  qsort(ref, n, sizeof(key_t), comp);
+  assert(compact_rbtree_size(t) == n);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  compact_rbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == ref[i]);
+  }
+  free(res);
+
+  if (n > 0) {
+    assert(compact_rbtree_min(t)->key == ref[0]);
+    assert(compact_rbtree_max(t)->key == ref[n - 1]);
+    assert(compact_rbtree_lower_bound(t, ref[n - 1] + 1) == NULL);
+  } else {
+    assert(compact_rbtree_min(t) == NULL);
+  }
+  for (size_t i = 0; i < n; i++) {
+    cnode_t *p = compact_rbtree_lower_bound(t, ref[i]);
+    assert(p != NULL && p->key == ref[i]);
+  }
+
+#ifdef RBTREE_COMPACT_PARENT
+  size_t i = 0;
+  for (cnode_t *p = compact_rbtree_iter_begin(t);
+       p != compact_rbtree_iter_end(t); p = compact_rbtree_iter_next(t, p)) {
+    assert(p->key == ref[i++]);
+  }
+  assert(i == n);
+  for (cnode_t *p = compact_rbtree_iter_prev(t, compact_rbtree_iter_end(t));
+       p != NULL; p = compact_rbtree_iter_prev(t, p)) {
+    assert(p->key == ref[--i]);
+  }
+  assert(i == 0);
+#endif
+}
+
+void test_insert_erase_rand(const size_t n, const unsigned int seed) {
+  srand(seed);
+  compact_rbtree *t = new_compact_rbtree();
+  key_t *ref = calloc(n, sizeof(key_t));
+  size_t m = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    const key_t key = rand() % (n / 4 + 1);
+    cnode_t *p = compact_rbtree_find(t, key);
+    if (p != NULL && rand() % 2) {
+      assert(p->key == key);
+      compact_rbtree_erase(t, p);
+      for (size_t j = 0; j < m; j++) {
+        if (ref[j] == key) {
+          ref[j] = ref[--m];
+          break;
+        }
+      }
+    } else {
+      p = compact_rbtree_insert(t, key);
+      assert(p != NULL && p->key == key);
+      ref[m++] = key;
+    }
+    if (i % 128 == 0) {
+      test_constraints(t);
+      check_contents(t, ref, m);
+    }
+  }
+  test_constraints(t);
+  check_contents(t, ref, m);
+
+  // erase everything through min to exercise every fixup case
+  while (m > 0) {
+    compact_rbtree_erase(t, compact_rbtree_min(t));
+    m--;
+    assert(compact_rbtree_size(t) == m);
+  }
+  test_constraints(t);
+  assert(t->root == 0);
+
+  free(ref);
+  delete_compact_rbtree(t);
+}
+
+// a tree of nothing but copies: erase finds one copy with a single
+// descent, whichever copy the handle points at
+void test_erase_duplicates(const size_t n) {
+  compact_rbtree *t = new_compact_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    compact_rbtree_insert(t, (key_t)(i % 3));
+  }
+  for (size_t m = n; m > 0; m--) {
+    const key_t key = (key_t)(m % 3);
+    cnode_t *p = compact_rbtree_find(t, key);
+    assert(p != NULL);
+    assert(compact_rbtree_erase(t, p) == 0);
+    assert(compact_rbtree_size(t) == m - 1);
+    if (m % 512 == 0) {
+      test_constraints(t);
+    }
+  }
+  test_constraints(t);
+  assert(t->root == 0);
+  delete_compact_rbtree(t);
+}
+
+void test_find_erase_fixed(void) {
+  const key_t arr[] = {10, 5, 8, 34, 67, 23, 156, 24, 2, 12, 24, 36, 990, 25};
+  const size_t n = sizeof(arr) / sizeof(arr[0]);
+  compact_rbtree *t = new_compact_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    compact_rbtree_insert(t, arr[i]);
+    test_constraints(t);
+  }
+  for (size_t i = 0; i < n; i++) {
+    cnode_t *p = compact_rbtree_find(t, arr[i]);
+    assert(p != NULL && p->key == arr[i]);
+    compact_rbtree_erase(t, p);
+    test_constraints(t);
+  }
+  for (size_t i = 0; i < n; i++) {
+    assert(compact_rbtree_find(t, arr[i]) == NULL);
+  }
+  delete_compact_rbtree(t);
+}
+
+int main(void) {
+  test_find_erase_fixed();
+  test_insert_erase_rand(20000, 11);
+  test_erase_duplicates(30000);
+  printf("Passed all tests!\n");
+}
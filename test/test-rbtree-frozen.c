@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <rbtree_frozen.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int comp(const void *p1, const void *p2) {
+  const key_t k1 = *(const key_t *)p1, k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+typedef struct {
+  key_t keys[64];
+  size_t count, limit;
+} range_visit_t;
+
+static int collect(const key_t *p, void *ctx) {
+  range_visit_t *v = (range_visit_t *)ctx;
+  v->keys[v->count++] = *p;
+  return v->count == v->limit;
+}
+
+// every query on the frozen copy should agree with the sorted keys
+static void check_frozen(const rbtree *t, const key_t *sorted, const size_t n,
+                         const key_t range) {
+  rbtree_frozen_t *f = rbtree_freeze(t);
+  assert(rbtree_frozen_size(f) == n);
+  if (n == 0) {
+    assert(rbtree_frozen_min(f) == NULL && rbtree_frozen_max(f) == NULL);
+    assert(rbtree_frozen_lower_bound(f, 0) == NULL);
+    delete_rbtree_frozen(f);
+    return;
+  }
+
+  // full walks in both directions
+  const key_t *p = rbtree_frozen_min(f);
+  for (size_t i = 0; i < n; i++, p = rbtree_frozen_next(f, p)) {
+    assert(p != NULL && *p == sorted[i]);
+  }
+  assert(p == NULL);
+  p = rbtree_frozen_max(f);
+  for (size_t i = n; i > 0; i--, p = rbtree_frozen_prev(f, p)) {
+    assert(p != NULL && *p == sorted[i - 1]);
+  }
+  assert(p == NULL);
+
+  for (key_t key = -2; key <= range + 2; key++) {
+    size_t rank = 0;
+    while (rank < n && sorted[rank] < key) {
+      rank++;
+    }
+    const key_t *bound = rbtree_frozen_lower_bound(f, key);
+    const key_t *found = rbtree_frozen_find(f, key);
+    if (rank == n) {
+      assert(bound == NULL && found == NULL);
+      continue;
+    }
+    assert(bound != NULL && *bound == sorted[rank]);
+    // lower_bound lands on the first copy
+    const key_t *before = rbtree_frozen_prev(f, bound);
+    assert(rank == 0 ? before == NULL : *before == sorted[rank - 1]);
+    assert((found != NULL) == (sorted[rank] == key));
+    assert(found == NULL || *found == key);
+
+    // [key, key + 5) with and without an early stop
+    range_visit_t v = {.count = 0, .limit = 64};
+    size_t end = rank;
+    while (end < n && sorted[end] < key + 5 && end - rank < 64) {
+      end++;
+    }
+    if (end - rank < 64) {
+      assert(rbtree_frozen_foreach_range(f, key, key + 5, collect, &v) == end - rank);
+      for (size_t i = 0; i < v.count; i++) {
+        assert(v.keys[i] == sorted[rank + i]);
+      }
+    }
+    v.count = 0;
+    v.limit = 1;
+    assert(rbtree_frozen_foreach_range(f, key, key + 5, collect, &v) ==
+           (end > rank ? 1 : 0));
+  }
+  delete_rbtree_frozen(f);
+}
+
+// every tree shape up to 70 keys, with and without duplicates
+void test_small(void) {
+  for (size_t n = 0; n <= 70; n++) {
+    for (int dup = 0; dup < 2; dup++) {
+      const key_t range = dup ? (key_t)(n / 3 + 1) : (key_t)(4 * n + 1);
+      key_t *sorted = calloc(n + 1, sizeof(key_t));
+      rbtree *t = new_rbtree();
+      for (size_t i = 0; i < n; i++) {
+        sorted[i] = rand() % range;
+        rbtree_insert(t, sorted[i]);
+      }
+      qsort(sorted, n, sizeof(key_t), comp);
+      check_frozen(t, sorted, n, range);
+      delete_rbtree(t);
+      free(sorted);
+    }
+  }
+}
+
+void test_counted(const size_t n) {
+  const key_t range = 300;
+  key_t *sorted = calloc(n, sizeof(key_t));
+  rbtree *t = new_rbtree_counted();
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = rand() % range;
+    rbtree_insert(t, sorted[i]);
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+  check_frozen(t, sorted, n, range);
+  delete_rbtree(t);
+  free(sorted);
+}
+
+// larger than a few cache lines, so the prefetch runs past the array end
+void test_large(const size_t n) {
+  const key_t range = (key_t)(2 * n);
+  key_t *sorted = calloc(n, sizeof(key_t));
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = rand() % range;
+    rbtree_insert(t, sorted[i]);
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+  rbtree_frozen_t *f = rbtree_freeze(t);
+  for (key_t key = -1; key <= range; key++) {
+    node_t *live = rbtree_lower_bound(t, key);
+    const key_t *frozen = rbtree_frozen_lower_bound(f, key);
+    assert((live == NULL) == (frozen == NULL));
+    assert(live == NULL || live->key == *frozen);
+    assert((rbtree_find(t, key) == NULL) == (rbtree_frozen_find(f, key) == NULL));
+  }
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+  free(sorted);
+}
+
+int main(void) {
+  srand(59);
+  test_small();
+  test_counted(5000);
+  test_large(50000);
+  printf("Passed all tests!\n");
+}
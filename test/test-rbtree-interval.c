@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <limits.h>
+#include <rbtree_interval.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// checks order by lo, colors, black heights, parent links and the subtree
+// max; returns the black height or -1 on violation
+static int check_subtree(const rbtree_link_t *link, const rbtree_link_t *parent,
+                         size_t *count) {
+  if (link == NULL) {
+    return 1;
+  }
+  const inode_t *p = interval_rbtree_entry(link);
+  const inode_t *left = interval_rbtree_entry(link->left);
+  const inode_t *right = interval_rbtree_entry(link->right);
+  if (link->parent != parent || p->lo > p->hi) {
+    return -1;
+  }
+  if (link->color == RBTREE_RED &&
+      ((left != NULL && left->link.color == RBTREE_RED) ||
+       (right != NULL && right->link.color == RBTREE_RED))) {
+    return -1;
+  }
+  if ((left != NULL && left->lo > p->lo) ||
+      (right != NULL && right->lo < p->lo)) {
+    return -1;
+  }
+  key_t max = p->hi;
+  if (left != NULL && left->max > max) {
+    max = left->max;
+  }
+  if (right != NULL && right->max > max) {
+    max = right->max;
+  }
+  if (p->max != max) {
+    return -1;
+  }
+  const int lh = check_subtree(link->left, link, count);
+  const int rh = check_subtree(link->right, link, count);
+  if (lh < 0 || lh != rh) {
+    return -1;
+  }
+  (*count)++;
+  return lh + (link->color == RBTREE_BLACK);
+}
+
+static void test_constraints(const interval_rbtree *t) {
+  size_t count = 0;
+  const rbtree_link_t *root = t->links.root;
+  assert(root == NULL || root->color == RBTREE_BLACK);
+  assert(check_subtree(root, NULL, &count) > 0);
+  assert(count == interval_rbtree_size(t));
+}
+
+typedef struct {
+  inode_t **out;
+  size_t n, limit;
+} collect_t;
+
+static int collect(inode_t *p, void *ctx) {
+  collect_t *c = ctx;
+  c->out[c->n++] = p;
+  return c->n == c->limit;
+}
+
+static bool overlaps(const inode_t *p, const key_t lo, const key_t hi) {
+  return p->lo <= hi && p->hi >= lo;
+}
+
+// the query must visit exactly the brute-force matches, in order of lo
+static void check_query(const interval_rbtree *t, inode_t **nodes,
+                        const size_t m, const key_t lo, const key_t hi,
+                        inode_t **out) {
+  size_t expect = 0;
+  for (size_t i = 0; i < m; i++) {
+    expect += overlaps(nodes[i], lo, hi);
+  }
+
+  collect_t c = {out, 0, 0};
+  const size_t visited =
+      lo == hi ? interval_rbtree_stab(t, lo, collect, &c)
+               : interval_rbtree_overlaps(t, lo, hi, collect, &c);
+  assert(visited == expect && c.n == expect);
+  assert(interval_rbtree_overlaps(t, lo, hi, NULL, NULL) == expect);
+  for (size_t i = 0; i < c.n; i++) {
+    assert(overlaps(out[i], lo, hi));
+    assert(i == 0 || out[i - 1]->lo <= out[i]->lo);
+    for (size_t j = 0; j < i; j++) {
+      assert(out[j] != out[i]);
+    }
+  }
+
+  // visit returning nonzero stops the walk after that node
+  if (expect > 2) {
+    c = (collect_t){out, 0, 2};
+    assert(interval_rbtree_overlaps(t, lo, hi, collect, &c) == 2);
+  }
+}
+
+// random inserts and erases checked against a plain array of the live
+// intervals, like test_find_erase_rand in test-rbtree.c
+void test_interval_rand(const size_t n, const unsigned int seed) {
+  srand(seed);
+  interval_rbtree *t = new_interval_rbtree();
+  inode_t **nodes = calloc(n, sizeof(inode_t *));
+  inode_t **out = calloc(n, sizeof(inode_t *));
+  const key_t span = (key_t)(4 * n);
+  size_t m = 0;
+
+  assert(interval_rbtree_overlaps(t, 0, span, NULL, NULL) == 0);
+  for (size_t i = 0; i < 3 * n; i++) {
+    if (m == n || (m > 0 && rand() % 3 == 0)) {
+      const size_t j = (size_t)rand() % m;
+      interval_rbtree_erase(t, nodes[j]);
+      nodes[j] = nodes[--m];
+    } else {
+      // mostly short ranges plus a few long ones, some lo values repeated
+      const key_t lo = (key_t)(rand() % span);
+      const key_t len = rand() % 8 == 0 ? rand() % span : rand() % 32;
+      inode_t *p = interval_rbtree_insert(t, lo, lo + len);
+      assert(p->lo == lo && p->hi == lo + len);
+      nodes[m++] = p;
+    }
+    if (i % 97 == 0) {
+      test_constraints(t);
+      const key_t lo = (key_t)(rand() % span);
+      check_query(t, nodes, m, lo, lo + rand() % 64, out);
+      check_query(t, nodes, m, lo, lo, out);
+    }
+  }
+  test_constraints(t);
+
+  for (size_t i = 0; i < 200; i++) {
+    const key_t lo = (key_t)(rand() % (2 * span)) - span / 2;
+    check_query(t, nodes, m, lo, lo + rand() % (span / 4), out);
+    check_query(t, nodes, m, lo, lo, out);
+  }
+  check_query(t, nodes, m, -span, 2 * span, out);
+
+  // handles stay valid while their neighbours are erased
+  while (m > 0) {
+    const size_t j = (size_t)rand() % m;
+    const key_t lo = nodes[j]->lo, hi = nodes[j]->hi;
+    interval_rbtree_erase(t, nodes[j]);
+    nodes[j] = nodes[--m];
+    if (m % 64 == 0) {
+      test_constraints(t);
+      check_query(t, nodes, m, lo, hi, out);
+    }
+  }
+  assert(interval_rbtree_size(t) == 0 && t->links.root == NULL);
+
+  free(out);
+  free(nodes);
+  delete_interval_rbtree(t);
+}
+
+// a hand-checked case: nested, touching and disjoint intervals
+void test_interval_fixed(void) {
+  interval_rbtree *t = new_interval_rbtree();
+  const key_t ranges[][2] = {{15, 20}, {10, 30}, {17, 19}, {5, 20},
+                             {12, 15}, {30, 40}, {5, 5},   {41, 50}};
+  inode_t *nodes[8];
+  // INT_MIN as the lower bound must not walk into an empty subtree
+  assert(interval_rbtree_stab(t, INT_MIN, NULL, NULL) == 0);
+  assert(interval_rbtree_overlaps(t, INT_MIN, 100, NULL, NULL) == 0);
+  for (size_t i = 0; i < 8; i++) {
+    nodes[i] = interval_rbtree_insert(t, ranges[i][0], ranges[i][1]);
+  }
+  test_constraints(t);
+  assert(interval_rbtree_entry(t->links.root)->max == 50);
+
+  inode_t *out[8];
+  collect_t c = {out, 0, 0};
+  assert(interval_rbtree_stab(t, 5, collect, &c) == 2);
+  assert(out[0]->lo == 5 && out[1]->lo == 5);
+  assert(interval_rbtree_stab(t, 30, NULL, NULL) == 2);
+  assert(interval_rbtree_stab(t, 40, NULL, NULL) == 1);
+  assert(interval_rbtree_stab(t, 4, NULL, NULL) == 0);
+  assert(interval_rbtree_stab(t, 51, NULL, NULL) == 0);
+  assert(interval_rbtree_stab(t, INT_MIN, NULL, NULL) == 0);
+  assert(interval_rbtree_overlaps(t, INT_MIN, 4, NULL, NULL) == 0);
+  assert(interval_rbtree_overlaps(t, INT_MIN, 12, NULL, NULL) == 4);
+  assert(interval_rbtree_overlaps(t, INT_MIN, INT_MAX, NULL, NULL) == 8);
+  // [16, 18] meets every interval from 5 to 30 except [12, 15] and [5, 5]
+  c = (collect_t){out, 0, 0};
+  assert(interval_rbtree_overlaps(t, 16, 18, collect, &c) == 4);
+  assert(out[0]->lo == 5 && out[1]->lo == 10 && out[2]->lo == 15 &&
+         out[3]->lo == 17);
+
+  interval_rbtree_erase(t, nodes[1]);  // [10, 30]
+  test_constraints(t);
+  assert(interval_rbtree_stab(t, 25, NULL, NULL) == 0);
+  interval_rbtree_erase(t, nodes[7]);  // [41, 50]
+  test_constraints(t);
+  assert(interval_rbtree_entry(t->links.root)->max == 40);
+  // erased nodes go back to the tree's pool and are handed out again
+  assert(interval_rbtree_insert(t, 45, 60) == nodes[7]);
+  test_constraints(t);
+  assert(interval_rbtree_stab(t, 60, NULL, NULL) == 1);
+  delete_interval_rbtree(t);
+}
+
+int main(void) {
+  test_interval_fixed();
+  test_interval_rand(3000, 61);
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,277 @@
+#include <assert.h>
+#include <rbtree_intrusive.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// a caller-owned object that sits in two trees at once: by key and by id
+typedef struct {
+  int key;
+  int id;
+  rbtree_link_t by_key;
+  rbtree_link_t by_id;
+} item_t;
+
+static int compare_by_key(const rbtree_link_t *a, const rbtree_link_t *b) {
+  const int ka = rbtree_entry(a, item_t, by_key)->key;
+  const int kb = rbtree_entry(b, item_t, by_key)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+static int compare_key(const void *key, const rbtree_link_t *link) {
+  const int k = *(const int *)key;
+  const int kl = rbtree_entry(link, item_t, by_key)->key;
+  return (k > kl) - (k < kl);
+}
+
+static int compare_id(const void *key, const rbtree_link_t *link) {
+  const int k = *(const int *)key;
+  const int kl = rbtree_entry(link, item_t, by_id)->id;
+  return (k > kl) - (k < kl);
+}
+
+// checks colors, black heights and parent links; returns the black height or
+// -1 on violation
+static int check_subtree(const rbtree_link_t *p, const rbtree_link_t *parent,
+                         size_t *count) {
+  if (p == NULL) {
+    return 1;
+  }
+  if (p->parent != parent) {
+    return -1;
+  }
+  if (p->color == RBTREE_RED &&
+      ((p->left != NULL && p->left->color == RBTREE_RED) ||
+       (p->right != NULL && p->right->color == RBTREE_RED))) {
+    return -1;
+  }
+  const int lh = check_subtree(p->left, p, count);
+  const int rh = check_subtree(p->right, p, count);
+  if (lh < 0 || lh != rh) {
+    return -1;
+  }
+  (*count)++;
+  return lh + (p->color == RBTREE_BLACK);
+}
+
+static void check_tree(const intrusive_rbtree *t) {
+  size_t count = 0;
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  assert(check_subtree(t->root, NULL, &count) > 0);
+  assert(count == intrusive_rbtree_size(t));
+}
+
+// the key tree walks in key order and agrees with a scan of the live items;
+// while items went in by ascending id, equal keys must also be in id order
+static void check_contents(const intrusive_rbtree *keys,
+                           const intrusive_rbtree *ids, const item_t *items,
+                           const int *live, const size_t n,
+                           const int inserted_by_id) {
+  check_tree(keys);
+  check_tree(ids);
+  size_t count = 0;
+  const item_t *last = NULL;
+  for (rbtree_link_t *p = intrusive_rbtree_first(keys); p != NULL;
+       p = intrusive_rbtree_next(p)) {
+    const item_t *item = rbtree_entry(p, item_t, by_key);
+    assert(live[item->id]);
+    assert(last == NULL || last->key < item->key ||
+           (last->key == item->key &&
+            (!inserted_by_id || last->id < item->id)));
+    last = item;
+    count++;
+  }
+  assert(count == intrusive_rbtree_size(keys));
+  assert(count == intrusive_rbtree_size(ids));
+  for (rbtree_link_t *p = intrusive_rbtree_last(keys); p != NULL;
+       p = intrusive_rbtree_prev(p)) {
+    count--;
+  }
+  assert(count == 0);
+
+  for (size_t i = 0; i < n; i++) {
+    const int id = (int)i;
+    rbtree_link_t *p = intrusive_rbtree_find(ids, &id, compare_id);
+    assert((p != NULL) == (live[i] != 0));
+    assert(p == NULL || rbtree_entry(p, item_t, by_id) == &items[i]);
+    if (live[i]) {
+      p = intrusive_rbtree_find(keys, &items[i].key, compare_key);
+      assert(p != NULL && rbtree_entry(p, item_t, by_key)->key == items[i].key);
+      // lower_bound returns the first copy: nothing equal before it
+      p = intrusive_rbtree_lower_bound(keys, &items[i].key, compare_key);
+      assert(p != NULL && rbtree_entry(p, item_t, by_key)->key == items[i].key);
+      rbtree_link_t *q = intrusive_rbtree_prev(p);
+      assert(q == NULL || rbtree_entry(q, item_t, by_key)->key < items[i].key);
+    }
+  }
+}
+
+// items come from one caller-owned array; the library never allocates
+void test_two_trees(const size_t n, const unsigned int seed) {
+  srand(seed);
+  item_t *items = calloc(n, sizeof(item_t));
+  int *live = calloc(n, sizeof(int));
+  intrusive_rbtree keys, ids;
+  intrusive_rbtree_init(&keys);
+  intrusive_rbtree_init(&ids);
+  assert(intrusive_rbtree_first(&keys) == NULL);
+
+  for (size_t i = 0; i < n; i++) {
+    items[i].id = (int)i;
+    items[i].key = rand() % (int)(n / 4 + 1);
+    intrusive_rbtree_insert(&keys, &items[i].by_key, compare_by_key);
+    // ids ascend, so the caller can link at the right end without comparing
+    intrusive_rbtree_insert_at(&ids, intrusive_rbtree_last(&ids), 1,
+                               &items[i].by_id);
+    live[i] = 1;
+  }
+  check_contents(&keys, &ids, items, live, n, 1);
+
+  for (size_t round = 0; round < 3; round++) {
+    for (size_t i = 0; i < n; i++) {
+      if (rand() % 3 != 0) {
+        continue;
+      }
+      if (live[i]) {
+        intrusive_rbtree_erase(&keys, &items[i].by_key);
+        intrusive_rbtree_erase(&ids, &items[i].by_id);
+      } else {
+        // re-insert with a new key; ids go back by comparator
+        items[i].key = rand() % (int)(n / 4 + 1);
+        intrusive_rbtree_insert(&keys, &items[i].by_key, compare_by_key);
+        const int id = (int)i;
+        rbtree_link_t *at = intrusive_rbtree_lower_bound(&ids, &id, compare_id);
+        if (at == NULL) {
+          intrusive_rbtree_insert_at(&ids, intrusive_rbtree_last(&ids), 1,
+                                     &items[i].by_id);
+        } else if (at->left == NULL) {
+          intrusive_rbtree_insert_at(&ids, at, 0, &items[i].by_id);
+        } else {
+          intrusive_rbtree_insert_at(&ids, intrusive_rbtree_prev(at), 1,
+                                     &items[i].by_id);
+        }
+      }
+      live[i] = !live[i];
+    }
+    check_contents(&keys, &ids, items, live, n, 0);
+  }
+
+  const int above = (int)n;
+  assert(intrusive_rbtree_lower_bound(&keys, &above, compare_key) == NULL);
+  for (size_t i = 0; i < n; i++) {
+    if (live[i]) {
+      intrusive_rbtree_erase(&keys, &items[i].by_key);
+      intrusive_rbtree_erase(&ids, &items[i].by_id);
+    }
+  }
+  assert(keys.root == NULL && ids.root == NULL);
+  assert(intrusive_rbtree_size(&keys) == 0);
+  free(live);
+  free(items);
+}
+
+// augmented with subtree sizes, kept up to date by the callbacks alone
+typedef struct {
+  int key;
+  size_t size;
+  rbtree_link_t link;
+} sized_t;
+
+static size_t link_size(const rbtree_link_t *p) {
+  return p == NULL ? 0 : rbtree_entry(p, sized_t, link)->size;
+}
+
+static void size_propagate(rbtree_link_t *p, rbtree_link_t *stop) {
+  for (; p != stop; p = p->parent) {
+    rbtree_entry(p, sized_t, link)->size =
+        link_size(p->left) + link_size(p->right) + 1;
+  }
+}
+
+static void size_copy(rbtree_link_t *old, rbtree_link_t *new) {
+  rbtree_entry(new, sized_t, link)->size = link_size(old);
+}
+
+static void size_rotate(rbtree_link_t *old, rbtree_link_t *new) {
+  rbtree_entry(new, sized_t, link)->size = link_size(old);
+  size_propagate(old, new);
+}
+
+static const rbtree_augment_t size_augment = {size_propagate, size_copy,
+                                              size_rotate};
+
+// every size equals the count of its subtree; returns the count
+static size_t check_sizes(const rbtree_link_t *p) {
+  if (p == NULL) {
+    return 0;
+  }
+  const size_t size = check_sizes(p->left) + check_sizes(p->right) + 1;
+  assert(link_size(p) == size);
+  return size;
+}
+
+// the k-th link in order (0-based), found by the sizes
+static sized_t *select_link(const intrusive_rbtree *t, size_t k) {
+  rbtree_link_t *p = t->root;
+  while (p != NULL) {
+    const size_t left = link_size(p->left);
+    if (k == left) {
+      return rbtree_entry(p, sized_t, link);
+    }
+    if (k < left) {
+      p = p->left;
+    } else {
+      k -= left + 1;
+      p = p->right;
+    }
+  }
+  return NULL;
+}
+
+void test_augmented_size(const size_t n, const unsigned int seed) {
+  srand(seed);
+  sized_t *items = calloc(n, sizeof(sized_t));
+  int *live = calloc(n, sizeof(int));
+  intrusive_rbtree t;
+  intrusive_rbtree_init(&t);
+
+  for (size_t round = 0; round < 4; round++) {
+    for (size_t i = 0; i < n; i++) {
+      if (rand() % 2 == 0) {
+        continue;
+      }
+      if (live[i]) {
+        intrusive_rbtree_erase_augmented(&t, &items[i].link, &size_augment);
+      } else {
+        items[i].key = rand() % (int)(n / 2 + 1);
+        rbtree_link_t *parent = NULL, *p = t.root;
+        int dir = 0;
+        while (p != NULL) {
+          parent = p;
+          dir = items[i].key >= rbtree_entry(p, sized_t, link)->key;
+          p = dir ? p->right : p->left;
+        }
+        intrusive_rbtree_insert_at_augmented(&t, parent, dir, &items[i].link,
+                                             &size_augment);
+      }
+      live[i] = !live[i];
+    }
+    check_tree(&t);
+    assert(check_sizes(t.root) == intrusive_rbtree_size(&t));
+
+    // select walks the sizes and agrees with the in-order walk
+    size_t k = 0;
+    for (rbtree_link_t *p = intrusive_rbtree_first(&t); p != NULL;
+         p = intrusive_rbtree_next(p)) {
+      assert(&select_link(&t, k++)->link == p);
+    }
+    assert(select_link(&t, k) == NULL);
+  }
+  free(live);
+  free(items);
+}
+
+int main(void) {
+  test_two_trees(2000, 61);
+  test_augmented_size(2000, 67);
+  printf("Passed all tests!\n");
+}
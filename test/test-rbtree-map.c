@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RBMAP_NAME intmap
+#define RBMAP_KEY int
+#define RBMAP_VALUE int
+#include <rbtree_map.h>
+
+typedef struct {
+  int id;
+  double weight;
+} item_t;
+
+static size_t string_compares;
+
+static inline int compare_string(const char *a, const char *b) {
+  string_compares++;
+  return strcmp(a, b);
+}
+
+#define RBMAP_NAME strmap
+#define RBMAP_KEY const char *
+#define RBMAP_VALUE item_t
+#define RBMAP_CMP(a, b) compare_string(a, b)
+#include <rbtree_map.h>
+
+// checks order, colors, black heights and parent links; returns the black
+// height or -1 on violation
+static int check_subtree(const rbtree_link_t *p, const rbtree_link_t *parent,
+                         size_t *count) {
+  if (p == NULL) {
+    return 1;
+  }
+  if (p->parent != parent) {
+    return -1;
+  }
+  if (p->color == RBTREE_RED &&
+      ((p->left != NULL && p->left->color == RBTREE_RED) ||
+       (p->right != NULL && p->right->color == RBTREE_RED))) {
+    return -1;
+  }
+  const int key = intmap_entry(p)->key;
+  if ((p->left != NULL && intmap_entry(p->left)->key > key) ||
+      (p->right != NULL && intmap_entry(p->right)->key < key)) {
+    return -1;
+  }
+  const int lh = check_subtree(p->left, p, count);
+  const int rh = check_subtree(p->right, p, count);
+  if (lh < 0 || lh != rh) {
+    return -1;
+  }
+  (*count)++;
+  return lh + (p->color == RBTREE_BLACK);
+}
+
+static void test_constraints(const intmap *t) {
+  size_t count = 0;
+  assert(t->links.root == NULL || t->links.root->color == RBTREE_BLACK);
+  assert(check_subtree(t->links.root, NULL, &count) > 0);
+  assert(count == intmap_size(t));
+}
+
+// values ride along with their keys, and node pointers stay valid while
+// other nodes are erased
+void test_int_map(const size_t n, const unsigned int seed) {
+  srand(seed);
+  intmap *t = intmap_new();
+  intmap_node **nodes = calloc(n, sizeof(intmap_node *));
+  size_t m = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    const int key = rand() % (n / 4 + 1);
+    if (m > 0 && rand() % 3 == 0) {
+      const size_t j = rand() % m;
+      intmap_erase(t, nodes[j]);
+      nodes[j] = nodes[--m];
+    } else {
+      intmap_node *p = intmap_insert(t, key, key * 7 + 1);
+      assert(p->key == key && p->value == key * 7 + 1);
+      nodes[m++] = p;
+    }
+    if (i % 256 == 0) {
+      test_constraints(t);
+    }
+  }
+  test_constraints(t);
+
+  for (size_t i = 0; i < m; i++) {
+    assert(nodes[i]->value == nodes[i]->key * 7 + 1);
+    intmap_node *p = intmap_find(t, nodes[i]->key);
+    assert(p != NULL && p->key == nodes[i]->key);
+  }
+
+  // in-order walk in both directions
+  size_t count = 0;
+  intmap_node *last = NULL;
+  for (intmap_node *p = intmap_min(t); p != NULL; p = intmap_next(t, p)) {
+    assert(last == NULL || last->key <= p->key);
+    assert(intmap_lower_bound(t, p->key)->key == p->key);
+    last = p;
+    count++;
+  }
+  assert(count == m && last == intmap_max(t));
+  for (intmap_node *p = intmap_max(t); p != NULL; p = intmap_prev(t, p)) {
+    count--;
+  }
+  assert(count == 0);
+  assert(intmap_lower_bound(t, n) == NULL);
+
+  while (m > 0) {
+    intmap_erase(t, nodes[--m]);
+  }
+  assert(intmap_size(t) == 0 && intmap_min(t) == NULL);
+  test_constraints(t);
+
+  free(nodes);
+  intmap_delete(t);
+}
+
+void test_string_map(void) {
+  const char *words[] = {"pear", "apple", "fig", "kiwi", "banana", "cherry",
+                         "date", "grape", "lime", "mango"};
+  const size_t n = sizeof(words) / sizeof(words[0]);
+  strmap *t = strmap_new();
+  for (size_t i = 0; i < n; i++) {
+    strmap_insert(t, words[i], (item_t){(int)i, i * 0.5});
+  }
+  assert(strmap_size(t) == n);
+
+  for (size_t i = 0; i < n; i++) {
+    string_compares = 0;
+    strmap_node *p = strmap_find(t, words[i]);
+    assert(p != NULL && p->value.id == (int)i && p->value.weight == i * 0.5);
+    // one comparator call per level down to the node
+    size_t levels = 1;
+    for (const rbtree_link_t *q = p->link.parent; q != NULL; q = q->parent) {
+      levels++;
+    }
+    assert(string_compares == levels);
+  }
+  assert(strmap_find(t, "melon") == NULL);
+  assert(strcmp(strmap_lower_bound(t, "c")->key, "cherry") == 0);
+  assert(strcmp(strmap_min(t)->key, "apple") == 0);
+  assert(strcmp(strmap_max(t)->key, "pear") == 0);
+
+  strmap_erase(t, strmap_find(t, "fig"));
+  strmap_erase(t, strmap_find(t, "apple"));
+  const char *expect[] = {"banana", "cherry", "date", "grape",
+                          "kiwi", "lime", "mango", "pear"};
+  size_t i = 0;
+  for (strmap_node *p = strmap_min(t); p != NULL; p = strmap_next(t, p)) {
+    assert(strcmp(p->key, expect[i++]) == 0);
+  }
+  assert(i == n - 2);
+
+  strmap_delete(t);
+}
+
+int main(void) {
+  test_int_map(20000, 7);
+  test_string_map();
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <pthread.h>
+#include <rbtree_mt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Stable keys are the even numbers below 2 * STABLE_KEYS. They are inserted
+// before any thread starts and never erased, so every reader must always find
+// them. Writers insert and erase odd keys concurrently.
+#define STABLE_KEYS 2000
+#define READERS 4
+#define READER_ROUNDS 3000
+#define WRITER_ROUNDS 20000
+
+typedef struct {
+  mt_rbtree *t;
+  rbtree_mt_mode_t mode;
+  unsigned int seed;
+} worker_arg_t;
+
+static bool color_ok(const rbtree *t, const node_t *p, int *black_height) {
+  if (p == t->nil) {
+    *black_height = 1;
+    return true;
+  }
+  int lh, rh;
+  if (!color_ok(t, p->left, &lh) || !color_ok(t, p->right, &rh) || lh != rh) {
+    return false;
+  }
+  if (p->color == RBTREE_RED &&
+      (p->left->color == RBTREE_RED || p->right->color == RBTREE_RED)) {
+    return false;
+  }
+  *black_height = lh + (p->color == RBTREE_BLACK);
+  return true;
+}
+
+static void *writer(void *arg) {
+  worker_arg_t *w = (worker_arg_t *)arg;
+  for (int i = 0; i < WRITER_ROUNDS; i++) {
+    const key_t key = 2 * (rand_r(&w->seed) % STABLE_KEYS) + 1;
+    if (rand_r(&w->seed) % 2) {
+      node_t *p = mt_rbtree_insert(w->t, key);
+      assert(p != NULL);
+    } else {
+      mt_rbtree_erase_key(w->t, key);
+    }
+  }
+  return NULL;
+}
+
+static void *reader(void *arg) {
+  worker_arg_t *w = (worker_arg_t *)arg;
+  for (int i = 0; i < READER_ROUNDS; i++) {
+    const int slot = mt_rbtree_read_lock(w->t);
+
+    // stable keys are always there and their nodes keep their key
+    const key_t key = 2 * (rand_r(&w->seed) % STABLE_KEYS);
+    node_t *p = mt_rbtree_find(w->t, key);
+    assert(p != NULL);
+    assert(p->key == key);
+    node_t *q = mt_rbtree_lower_bound(w->t, key - 1);
+    assert(q != NULL && q->key <= key);
+
+    // churned keys may or may not be there
+    mt_rbtree_find(w->t, key + 1);
+
+    node_t *min = mt_rbtree_min(w->t);
+    assert(min != NULL && min->key == 0);
+    node_t *max = mt_rbtree_max(w->t);
+    assert(max != NULL && max->key >= 2 * (STABLE_KEYS - 1));
+    assert(p->key == key);
+
+    // a short walk must stay sorted and visit every stable key on the way;
+    // erase never moves a key into another node, so this holds lock-free too
+    if (i % 16 == 0) {
+      key_t expect = key, last = key;
+      int steps = 0;
+      for (node_t *r = p; r != NULL && steps < 64;
+           r = mt_rbtree_iter_next(w->t, r), steps++) {
+        const key_t k = r->key;
+        assert(k >= last);
+        last = k;
+        if (k % 2 == 0) {
+          assert(k == expect);
+          expect += 2;
+        }
+      }
+    }
+    mt_rbtree_read_unlock(w->t, slot);
+  }
+  return NULL;
+}
+
+void test_stress(rbtree_mt_mode_t mode, const int writers) {
+  mt_rbtree *t = new_mt_rbtree(mode);
+  for (key_t k = 0; k < 2 * STABLE_KEYS; k += 2) {
+    mt_rbtree_insert(t, k);
+  }
+
+  pthread_t threads[READERS + 4];
+  worker_arg_t args[READERS + 4];
+  int n = 0;
+  for (int i = 0; i < writers; i++, n++) {
+    args[n] = (worker_arg_t){t, mode, 1000 + n};
+    pthread_create(&threads[n], NULL, writer, &args[n]);
+  }
+  for (int i = 0; i < READERS; i++, n++) {
+    args[n] = (worker_arg_t){t, mode, 1000 + n};
+    pthread_create(&threads[n], NULL, reader, &args[n]);
+  }
+  for (int i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // after the threads are gone the tree must be a valid rbtree holding every
+  // stable key
+  int black_height;
+  assert(color_ok(t->tree, t->tree->root, &black_height));
+  const size_t size = mt_rbtree_size(t);
+  assert(size >= STABLE_KEYS);
+  key_t *arr = calloc(size, sizeof(key_t));
+  mt_rbtree_to_array(t, arr, size);
+  size_t stable = 0;
+  for (size_t i = 0; i < size; i++) {
+    assert(i == 0 || arr[i - 1] <= arr[i]);
+    stable += arr[i] % 2 == 0;
+  }
+  assert(stable == STABLE_KEYS);
+
+  free(arr);
+  delete_mt_rbtree(t);
+}
+
+int main(void) {
+  test_stress(RBTREE_MT_RWLOCK, 2);
+  test_stress(RBTREE_MT_LOCKFREE, 1);
+  printf("Passed all tests!\n");
+}
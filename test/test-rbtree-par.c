@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <rbtree_par.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sizes larger than the parallel grain, so the tasks really get split
+#define BIG 100000
+
+static int comp(const void *p1, const void *p2) {
+  const key_t k1 = *(const key_t *)p1, k2 = *(const key_t *)p2;
+  return (k1 > k2) - (k1 < k2);
+}
+
+// checks colors, parent links and sizes; returns the black height or -1
+static int check_subtree(const rbtree *t, const node_t *p, const node_t *parent) {
+  if (p == t->nil) {
+    return 1;
+  }
+  if (p->parent != parent || p->size != p->left->size + p->right->size + 1) {
+    return -1;
+  }
+  if (p->color == RBTREE_RED &&
+      (p->left->color == RBTREE_RED || p->right->color == RBTREE_RED)) {
+    return -1;
+  }
+  const int lh = check_subtree(t, p->left, p);
+  const int rh = check_subtree(t, p->right, p);
+  if (lh < 0 || lh != rh) {
+    return -1;
+  }
+  return lh + (p->color == RBTREE_BLACK);
+}
+
+static uint64_t sum_keys(key_t key, size_t copies, void *ctx) {
+  return (uint64_t)(uint32_t)key * copies + (ctx != NULL);
+}
+
+static uint64_t count_nodes(key_t key, size_t copies, void *ctx) {
+  return 1;
+}
+
+// parallel to_array and reduce should match the sequential versions, also
+// when the output is shorter than the tree
+static void check_export(rbtree_par_t *par, const rbtree *t) {
+  const size_t n = rbtree_size(t);
+  key_t *expect = calloc(n + 1, sizeof(key_t));
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  rbtree_to_array(t, expect, n);
+
+  rbtree_par_to_array(par, t, res, n);
+  assert(memcmp(res, expect, n * sizeof(key_t)) == 0);
+  const size_t cut = n / 3 + 1;
+  memset(res, 0, (n + 1) * sizeof(key_t));
+  rbtree_par_to_array(par, t, res, cut);
+  assert(memcmp(res, expect, cut * sizeof(key_t)) == 0);
+  for (size_t i = cut; i <= n; i++) {
+    assert(res[i] == 0);
+  }
+
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += (uint32_t)expect[i];
+  }
+  assert(rbtree_par_reduce(par, t, sum_keys, NULL) == sum);
+  size_t nodes = 0;
+  for (node_t *p = rbtree_iter_begin(t); p != NULL; p = rbtree_iter_next(t, p)) {
+    nodes++;
+  }
+  assert(rbtree_par_reduce(par, t, count_nodes, NULL) == nodes);
+  free(res);
+  free(expect);
+}
+
+void test_build(rbtree_par_t *par) {
+  const size_t sizes[] = {0, 1, 2, 3, 1000, BIG, 3 * BIG + 7};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    const size_t n = sizes[s];
+    key_t *arr = calloc(n + 1, sizeof(key_t));
+    for (size_t i = 0; i < n; i++) {
+      arr[i] = rand() % (key_t)(n + 1);
+    }
+    qsort(arr, n, sizeof(key_t), comp);
+
+    rbtree *t = rbtree_par_from_sorted_array(par, arr, n);
+    assert(t->root->color == RBTREE_BLACK);
+    assert(check_subtree(t, t->root, t->nil) > 0);
+    assert(rbtree_size(t) == n);
+    key_t *res = calloc(n + 1, sizeof(key_t));
+    rbtree_to_array(t, res, n);
+    assert(memcmp(res, arr, n * sizeof(key_t)) == 0);
+
+    // the built tree is an ordinary tree
+    for (size_t i = 0; i < n / 2; i++) {
+      rbtree_erase(t, rbtree_find(t, arr[i]));
+    }
+    rbtree_insert(t, -1);
+    assert(rbtree_size(t) == n - n / 2 + 1);
+    assert(check_subtree(t, t->root, t->nil) > 0);
+    rbtree_par_delete(par, t);
+    free(res);
+    free(arr);
+  }
+}
+
+void test_export(rbtree_par_t *par) {
+  rbtree *t = new_rbtree();
+  check_export(par, t);
+  for (size_t i = 0; i < BIG; i++) {
+    rbtree_insert(t, rand());
+  }
+  check_export(par, t);
+  rbtree_par_delete(par, t);
+
+  // counted mode expands every node's copies at the right offset
+  t = new_rbtree_counted();
+  for (size_t i = 0; i < 2 * BIG; i++) {
+    rbtree_insert(t, rand() % (BIG / 4));
+  }
+  check_export(par, t);
+  rbtree_par_delete(par, t);
+}
+
+int main(void) {
+  srand(53);
+  const int threads[] = {1, 2, 4};
+  for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    rbtree_par_t *par = new_rbtree_par(threads[i]);
+    test_build(par);
+    test_export(par);
+    delete_rbtree_par(par);
+  }
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,188 @@
+#include <assert.h>
+#include <rbtree_persistent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// checks order, colors and black heights; returns the black height or -1 on
+// violation
+static int check_subtree(const pnode_t *p, size_t *count) {
+  if (p == NULL) {
+    return 1;
+  }
+  if (p->refs == 0) {
+    return -1;
+  }
+  if (p->color == RBTREE_RED &&
+      ((p->link[0] != NULL && p->link[0]->color == RBTREE_RED) ||
+       (p->link[1] != NULL && p->link[1]->color == RBTREE_RED))) {
+    return -1;
+  }
+  if ((p->link[0] != NULL && p->link[0]->key > p->key) ||
+      (p->link[1] != NULL && p->link[1]->key < p->key)) {
+    return -1;
+  }
+  const int lh = check_subtree(p->link[0], count);
+  const int rh = check_subtree(p->link[1], count);
+  if (lh < 0 || lh != rh) {
+    return -1;
+  }
+  (*count)++;
+  return lh + (p->color == RBTREE_BLACK);
+}
+
+// t should be a valid tree holding exactly sorted[0, n)
+static void check_version(const persistent_rbtree *t, const key_t *sorted,
+                          const size_t n) {
+  size_t count = 0;
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  assert(check_subtree(t->root, &count) > 0);
+  assert(count == n && persistent_rbtree_size(t) == n);
+
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  persistent_rbtree_to_array(t, arr, n);
+  assert(memcmp(arr, sorted, n * sizeof(key_t)) == 0);
+  free(arr);
+  if (n > 0) {
+    assert(*persistent_rbtree_min(t) == sorted[0]);
+    assert(*persistent_rbtree_max(t) == sorted[n - 1]);
+    assert(*persistent_rbtree_find(t, sorted[n / 2]) == sorted[n / 2]);
+    assert(*persistent_rbtree_lower_bound(t, sorted[n / 2]) == sorted[n / 2]);
+  } else {
+    assert(persistent_rbtree_min(t) == NULL);
+  }
+}
+
+typedef struct {
+  persistent_rbtree *tree;
+  key_t *sorted;
+  size_t n;
+} version_t;
+
+// a version keeps the contents it had when it was taken while the live tree
+// goes on with random inserts and erases, and writes to a snapshot do not
+// leak into the tree it came from
+void test_versions(const size_t n, const size_t versions,
+                   const unsigned int seed) {
+  srand(seed);
+  const size_t base_bytes = persistent_rbtree_node_bytes();
+  persistent_rbtree *t = new_persistent_rbtree();
+  key_t *sorted = calloc(n, sizeof(key_t));
+  size_t m = 0;
+  version_t *v = calloc(versions, sizeof(version_t));
+  size_t taken = 0;
+
+  assert(persistent_rbtree_erase(t, 1) == -1);
+  for (size_t i = 0; taken < versions; i++) {
+    if (m < n && (m == 0 || rand() % 3 != 0)) {
+      const key_t key = (key_t)(rand() % n);
+      persistent_rbtree_insert(t, key);
+      size_t j = m++;
+      for (; j > 0 && sorted[j - 1] > key; j--) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = key;
+    } else {
+      const size_t j = (size_t)rand() % m;
+      assert(persistent_rbtree_erase(t, sorted[j]) == 0);
+      memmove(sorted + j, sorted + j + 1, (--m - j) * sizeof(key_t));
+    }
+
+    if (i % (2 * n / versions + 1) == 0) {
+      check_version(t, sorted, m);
+      v[taken].tree = persistent_rbtree_snapshot(t);
+      v[taken].sorted = malloc((m + 1) * sizeof(key_t));
+      memcpy(v[taken].sorted, sorted, m * sizeof(key_t));
+      v[taken].n = m;
+      taken++;
+    }
+  }
+  check_version(t, sorted, m);
+  for (size_t i = 0; i < versions; i++) {
+    check_version(v[i].tree, v[i].sorted, v[i].n);
+  }
+
+  // modify one snapshot: the tree and the other versions do not change
+  version_t *w = &v[versions / 2];
+  persistent_rbtree_insert(w->tree, -1);
+  if (w->n > 0) {
+    assert(persistent_rbtree_erase(w->tree, w->sorted[w->n - 1]) == 0);
+    w->sorted[w->n - 1] = -1;
+  } else {
+    w->sorted[w->n++] = -1;
+  }
+  for (size_t j = w->n - 1; j > 0 && w->sorted[j - 1] > w->sorted[j]; j--) {
+    const key_t tmp = w->sorted[j];
+    w->sorted[j] = w->sorted[j - 1];
+    w->sorted[j - 1] = tmp;
+  }
+  check_version(t, sorted, m);
+  for (size_t i = 0; i < versions; i++) {
+    check_version(v[i].tree, v[i].sorted, v[i].n);
+  }
+
+  // drain the tree; the snapshots still hold their nodes
+  while (m > 0) {
+    assert(persistent_rbtree_erase(t, sorted[--m]) == 0);
+  }
+  check_version(t, sorted, 0);
+  for (size_t i = 0; i < versions; i++) {
+    check_version(v[i].tree, v[i].sorted, v[i].n);
+  }
+
+  // release the versions in a scrambled order; all nodes go with the last
+  for (size_t i = 0; i < versions; i++) {
+    const size_t j = (i * 7) % versions;
+    if (v[j].tree == NULL) {
+      continue;
+    }
+    delete_persistent_rbtree(v[j].tree);
+    free(v[j].sorted);
+    v[j].tree = NULL;
+  }
+  for (size_t i = 0; i < versions; i++) {
+    if (v[i].tree != NULL) {
+      delete_persistent_rbtree(v[i].tree);
+      free(v[i].sorted);
+    }
+  }
+  delete_persistent_rbtree(t);
+  assert(persistent_rbtree_node_bytes() == base_bytes);
+  free(v);
+  free(sorted);
+}
+
+// each write after a snapshot copies only the nodes it has to
+void test_path_copy(const size_t n) {
+  const size_t base_bytes = persistent_rbtree_node_bytes();
+  persistent_rbtree *t = new_persistent_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    persistent_rbtree_insert(t, (key_t)i);
+  }
+  // writes to an unshared tree copy nothing
+  assert(persistent_rbtree_node_bytes() - base_bytes == n * sizeof(pnode_t));
+
+  persistent_rbtree *snap = persistent_rbtree_snapshot(t);
+  assert(persistent_rbtree_node_bytes() - base_bytes == n * sizeof(pnode_t));
+  persistent_rbtree_insert(t, (key_t)(n / 2));
+  const size_t copied =
+      persistent_rbtree_node_bytes() - base_bytes - (n + 1) * sizeof(pnode_t);
+  // the path is at most 2 log2(n) long and the fixup copies a few siblings
+  size_t log_n = 0;
+  while (((size_t)1 << log_n) < n) {
+    log_n++;
+  }
+  assert(copied > 0 && copied <= (4 * log_n + 4) * sizeof(pnode_t));
+
+  delete_persistent_rbtree(snap);
+  delete_persistent_rbtree(t);
+  assert(persistent_rbtree_node_bytes() == base_bytes);
+}
+
+int main(void) {
+  test_path_copy(1000);
+  test_versions(3000, 40, 67);
+  test_versions(200, 200, 71);
+  printf("Passed all tests!\n");
+}
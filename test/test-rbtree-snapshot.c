@@ -0,0 +1,178 @@
+#include <rbtree_snapshot.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char path[64];
+
+// every key of t in order, with all copies
+static key_t *contents(const rbtree *t) {
+  const size_t n = rbtree_size(t);
+  key_t *arr = malloc((n + 1) * sizeof(key_t));
+  rbtree_to_array(t, arr, n);
+  return arr;
+}
+
+// both trees hold the same keys and t2 is a valid red-black tree
+static void check_same(const rbtree *t1, const rbtree *t2) {
+  const size_t n = rbtree_size(t1);
+  assert(rbtree_size(t2) == n);
+  assert(t1->counted == t2->counted);
+  assert(t2->root->color == RBTREE_BLACK);
+  key_t *a1 = contents(t1), *a2 = contents(t2);
+  assert(memcmp(a1, a2, n * sizeof(key_t)) == 0);
+  for (size_t i = 0; i < n; i++) {
+    assert(rbtree_select(t2, i)->key == a1[i]);
+  }
+  free(a1);
+  free(a2);
+}
+
+// snapshot queries agree with a sorted array holding every copy
+static void check_queries(const rbtree_snapshot_t *s, const key_t *sorted,
+                          const size_t n) {
+  assert(rbtree_snapshot_size(s) == n);
+  for (key_t key = -2; key < 2 * (key_t)n + 10; key++) {
+    size_t rank = 0;
+    while (rank < n && sorted[rank] < key) {
+      rank++;
+    }
+    assert(rbtree_snapshot_rank(s, key) == rank);
+    const key_t *found = rbtree_snapshot_find(s, key);
+    const key_t *bound = rbtree_snapshot_lower_bound(s, key);
+    if (rank < n) {
+      assert(bound != NULL && *bound == sorted[rank]);
+      assert((found != NULL) == (sorted[rank] == key));
+    } else {
+      assert(bound == NULL && found == NULL);
+    }
+    size_t in_range = 0;
+    for (size_t i = rank; i < n && sorted[i] < key + 3; i++) {
+      in_range++;
+    }
+    assert(rbtree_snapshot_count_range(s, key, key + 3) == in_range);
+  }
+  assert(rbtree_snapshot_count_range(s, 5, 5) == 0);
+}
+
+static void round_trip(rbtree *t) {
+  assert(rbtree_save(t, path) == 0);
+  assert(access(path, F_OK) == 0);
+
+  rbtree *loaded = rbtree_load(path);
+  assert(loaded != NULL);
+  check_same(t, loaded);
+
+  rbtree_snapshot_t *s = rbtree_snapshot_open(path);
+  assert(s != NULL);
+  key_t *sorted = contents(t);
+  check_queries(s, sorted, rbtree_size(t));
+  free(sorted);
+
+  // the thawed tree is writable and independent of the mapping
+  rbtree *thawed = rbtree_snapshot_thaw(s);
+  rbtree_snapshot_close(s);
+  check_same(t, thawed);
+  rbtree_insert(thawed, 7);
+  assert(rbtree_size(thawed) == rbtree_size(t) + 1);
+
+  delete_rbtree(thawed);
+  delete_rbtree(loaded);
+}
+
+void test_round_trip_plain(const size_t n) {
+  rbtree *t = new_rbtree();
+  round_trip(t);  // empty
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(rand() % (2 * n)) * 2 + 1);
+  }
+  round_trip(t);
+  delete_rbtree(t);
+}
+
+void test_round_trip_duplicates(const size_t n) {
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % 17);
+  }
+  round_trip(t);
+  delete_rbtree(t);
+}
+
+void test_round_trip_counted(const size_t n) {
+  rbtree *t = new_rbtree_counted();
+  round_trip(t);
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % 31);
+  }
+  round_trip(t);
+
+  rbtree *loaded = rbtree_load(path);
+  for (node_t *p = rbtree_iter_begin(t); p != NULL; p = rbtree_iter_next(t, p)) {
+    assert(rbtree_node_count(rbtree_find(loaded, p->key)) ==
+           rbtree_node_count(p));
+  }
+  delete_rbtree(loaded);
+  delete_rbtree(t);
+}
+
+// flips one byte at offset and expects both loaders to refuse the file
+static void expect_rejected_after(const long offset) {
+  FILE *f = fopen(path, "r+b");
+  assert(f != NULL);
+  assert(fseek(f, offset, SEEK_SET) == 0);
+  const int c = fgetc(f);
+  assert(c != EOF);
+  assert(fseek(f, offset, SEEK_SET) == 0);
+  fputc(c ^ 0x40, f);
+  fclose(f);
+
+  errno = 0;
+  assert(rbtree_load(path) == NULL && errno == EINVAL);
+  errno = 0;
+  assert(rbtree_snapshot_open(path) == NULL && errno == EINVAL);
+}
+
+void test_invalid_files(void) {
+  rbtree *t = new_rbtree();
+  for (key_t i = 0; i < 1000; i++) {
+    rbtree_insert(t, i % 100);
+  }
+
+  // a corrupted key, a corrupted prefix entry and a foreign version
+  const long key_offset = sizeof(rbtree_snapshot_header_t) + 10 * sizeof(key_t);
+  const long prefix_offset = sizeof(rbtree_snapshot_header_t) + 100 * sizeof(key_t) + 8;
+  const long version_offset = offsetof(rbtree_snapshot_header_t, version);
+  const long offsets[] = {key_offset, prefix_offset, version_offset, 0};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    assert(rbtree_save(t, path) == 0);
+    expect_rejected_after(offsets[i]);
+  }
+
+  // a truncated file
+  assert(rbtree_save(t, path) == 0);
+  assert(truncate(path, sizeof(rbtree_snapshot_header_t) + 4) == 0);
+  errno = 0;
+  assert(rbtree_load(path) == NULL && errno == EINVAL);
+
+  unlink(path);
+  errno = 0;
+  assert(rbtree_load(path) == NULL && errno == ENOENT);
+  assert(rbtree_save(t, "/nonexistent-dir/snapshot") == -1);
+  delete_rbtree(t);
+}
+
+int main(void) {
+  snprintf(path, sizeof(path), "/tmp/test-rbtree-snapshot.%ld", (long)getpid());
+  srand(29);
+  test_round_trip_plain(2000);
+  test_round_trip_duplicates(2000);
+  test_round_trip_counted(2000);
+  test_invalid_files();
+  unlink(path);
+  printf("Passed all tests!\n");
+}
@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <rbtree_wide.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1, e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+// checks node fill, key order against the separators and that every leaf is
+// at the same depth; returns the keys below node and records the leaves in
+// order so the caller can compare them with the leaf list
+static size_t check_node(const wide_rbtree *t, const void *node, size_t height,
+                         const key_t *lo, const key_t *hi,
+                         const wide_leaf_t **leaves, size_t *n_leaves) {
+  if (height == 0) {
+    const wide_leaf_t *leaf = node;
+    assert(leaf->count <= WIDE_KEYS);
+    assert(node == t->root || leaf->count >= WIDE_KEYS / 2);
+    for (size_t i = 0; i < leaf->count; i++) {
+      assert(i == 0 || leaf->keys[i - 1] <= leaf->keys[i]);
+      assert(lo == NULL || *lo <= leaf->keys[i]);
+      assert(hi == NULL || leaf->keys[i] <= *hi);
+    }
+    leaves[(*n_leaves)++] = leaf;
+    return leaf->count;
+  }
+  const wide_inner_t *inner = node;
+  assert(inner->count >= 1 && inner->count <= WIDE_KEYS);
+  assert(node == t->root || inner->count >= WIDE_KEYS / 2);
+  size_t total = 0;
+  for (size_t i = 0; i <= inner->count; i++) {
+    assert(i == 0 || i == inner->count ||
+           inner->keys[i - 1] <= inner->keys[i]);
+    total += check_node(t, inner->child[i], height - 1,
+                        i == 0 ? lo : &inner->keys[i - 1],
+                        i == inner->count ? hi : &inner->keys[i], leaves,
+                        n_leaves);
+  }
+  return total;
+}
+
+static void check_tree(const wide_rbtree *t) {
+  const wide_leaf_t **leaves = malloc((t->leaves + 1) * sizeof(*leaves));
+  size_t n_leaves = 0;
+  assert(check_node(t, t->root, t->height, NULL, NULL, leaves, &n_leaves) ==
+         t->count);
+  assert(n_leaves == t->leaves);
+  assert(t->first == leaves[0] && t->last == leaves[n_leaves - 1]);
+  for (size_t i = 0; i < n_leaves; i++) {
+    assert(leaves[i]->prev == (i > 0 ? leaves[i - 1] : NULL));
+    assert(leaves[i]->next == (i + 1 < n_leaves ? leaves[i + 1] : NULL));
+  }
+  free((void *)leaves);
+}
+
+static int collect_none(const key_t *p, void *ctx) {
+  (void)p;
+  (void)ctx;
+  return 0;
+}
+
+static int collect(const key_t *p, void *ctx) {
+  key_t **out = ctx;
+  *(*out)++ = *p;
+  return 0;
+}
+
+// size, to_array, min/max and a few lookups against the sorted reference
+static void check_contents(const wide_rbtree *t, const key_t *ref,
+                           const size_t n) {
+  check_tree(t);
+  assert(wide_rbtree_size(t) == n);
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  wide_rbtree_to_array(t, arr, n);
+  assert(memcmp(arr, ref, n * sizeof(key_t)) == 0);
+  if (n == 0) {
+    assert(wide_rbtree_min(t) == NULL && wide_rbtree_max(t) == NULL);
+    free(arr);
+    return;
+  }
+  assert(*wide_rbtree_min(t) == ref[0] && *wide_rbtree_max(t) == ref[n - 1]);
+  for (size_t i = 0; i < n; i += 1 + n / 50) {
+    const key_t *p = wide_rbtree_find(t, ref[i]);
+    assert(p != NULL && *p == ref[i]);
+    // the first copy, and nothing in between for the next key up
+    size_t first = i;
+    while (first > 0 && ref[first - 1] == ref[i]) {
+      first--;
+    }
+    assert(p == wide_rbtree_lower_bound(t, ref[i]));
+    if (ref[i] + 1 < ref[n - 1] && wide_rbtree_find(t, ref[i] + 1) == NULL) {
+      size_t next = i;
+      while (next < n && ref[next] <= ref[i]) {
+        next++;
+      }
+      assert(*wide_rbtree_lower_bound(t, ref[i] + 1) == ref[next]);
+    }
+    // [ref[first], ref[i] + 3) covers the same slice of ref
+    key_t *out = arr;
+    const size_t visited =
+        wide_rbtree_foreach_range(t, ref[i], ref[i] + 3, collect, &out);
+    size_t end = first;
+    while (end < n && ref[end] < ref[i] + 3) {
+      end++;
+    }
+    assert(visited == end - first && (size_t)(out - arr) == visited);
+    assert(memcmp(arr, ref + first, visited * sizeof(key_t)) == 0);
+  }
+  assert(wide_rbtree_lower_bound(t, ref[n - 1] + 1) == NULL);
+  free(arr);
+}
+
+// random keys from a small range (many duplicates) or a large one, erased in
+// random order with a full check every few steps
+void test_insert_erase_rand(const size_t n, const key_t range,
+                            const unsigned int seed) {
+  srand(seed);
+  key_t *keys = calloc(n, sizeof(key_t));
+  key_t *ref = calloc(n, sizeof(key_t));
+  wide_rbtree *t = new_wide_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = rand() % range;
+    wide_rbtree_insert(t, keys[i]);
+    if (i % 97 == 0) {
+      memcpy(ref, keys, (i + 1) * sizeof(key_t));
+      qsort(ref, i + 1, sizeof(key_t), comp);
+      check_contents(t, ref, i + 1);
+    }
+  }
+  memcpy(ref, keys, n * sizeof(key_t));
+  qsort(ref, n, sizeof(key_t), comp);
+  check_contents(t, ref, n);
+
+  for (size_t i = n; i > 1; i--) {
+    const size_t j = (size_t)rand() % i;
+    const key_t tmp = keys[j];
+    keys[j] = keys[i - 1];
+    keys[i - 1] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) {
+    assert(wide_rbtree_erase(t, keys[i]) == 0);
+    if (i % 97 == 0 || n - i < 40) {
+      memcpy(ref, keys + i + 1, (n - i - 1) * sizeof(key_t));
+      qsort(ref, n - i - 1, sizeof(key_t), comp);
+      check_contents(t, ref, n - i - 1);
+    }
+  }
+  assert(t->height == 0 && t->leaves == 1 && t->inners == 0);
+  assert(wide_rbtree_erase(t, 0) == -1);
+  delete_wide_rbtree(t);
+  free(ref);
+  free(keys);
+}
+
+// ascending inserts and descending erases, which split and merge at the ends
+void test_sorted(const size_t n) {
+  key_t *ref = calloc(n, sizeof(key_t));
+  wide_rbtree *t = new_wide_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    ref[i] = (key_t)(2 * i);
+    wide_rbtree_insert(t, ref[i]);
+  }
+  check_contents(t, ref, n);
+  assert(wide_rbtree_find(t, 1) == NULL && wide_rbtree_erase(t, 1) == -1);
+  for (size_t i = n; i > n / 2; i--) {
+    assert(wide_rbtree_erase(t, ref[i - 1]) == 0);
+  }
+  check_contents(t, ref, n / 2);
+  delete_wide_rbtree(t);
+  free(ref);
+}
+
+// every key the same: erase must find copies behind stale separators
+void test_one_key(const size_t n) {
+  wide_rbtree *t = new_wide_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    wide_rbtree_insert(t, 7);
+  }
+  wide_rbtree_insert(t, 3);
+  wide_rbtree_insert(t, 9);
+  check_tree(t);
+  assert(*wide_rbtree_lower_bound(t, 4) == 7);
+  assert(wide_rbtree_foreach_range(t, 7, 8, collect_none, NULL) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(wide_rbtree_erase(t, 7) == 0);
+  }
+  check_tree(t);
+  assert(wide_rbtree_erase(t, 7) == -1);
+  assert(*wide_rbtree_min(t) == 3 && *wide_rbtree_max(t) == 9);
+  delete_wide_rbtree(t);
+}
+
+// cursor reads of every size add up to to_array
+void test_cursor(const size_t n) {
+  wide_rbtree *t = new_wide_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    wide_rbtree_insert(t, rand() % 1000);
+  }
+  key_t *all = calloc(n, sizeof(key_t));
+  key_t *read = calloc(n, sizeof(key_t));
+  wide_rbtree_to_array(t, all, n);
+  for (size_t chunk = 1; chunk <= 40; chunk += 3) {
+    wide_cursor_t cursor;
+    wide_rbtree_cursor_begin(t, &cursor);
+    size_t done = 0, got;
+    while ((got = wide_rbtree_cursor_read(t, &cursor, read + done,
+                                          chunk < n - done ? chunk
+                                                           : n - done)) > 0) {
+      done += got;
+    }
+    assert(done == n && memcmp(all, read, n * sizeof(key_t)) == 0);
+  }
+  free(read);
+  free(all);
+  delete_wide_rbtree(t);
+}
+
+int main(void) {
+  printf("node search: %s\n", wide_rbtree_engine());
+  test_insert_erase_rand(3000, 50, 1);
+  test_insert_erase_rand(5000, 1 << 30, 2);
+  test_insert_erase_rand(20000, 4000, 3);
+  test_sorted(10000);
+  test_one_key(2000);
+  test_cursor(1000);
+  printf("Passed all tests!\n");
+}
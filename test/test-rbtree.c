@@ -1,8 +1,11 @@
 #include <assert.h>
 #include <rbtree.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 // new_rbtree should return rbtree struct with null root node
 void test_init(void) {
@@ -367,6 +370,1069 @@ void test_find_erase_rand(const size_t n, const unsigned int seed) {
   delete_rbtree(t);
 }
 
+// erased nodes should be recycled by the next insert instead of growing the
+// slab
+void test_node_reuse(void) {
+  rbtree *t = new_rbtree();
+  node_t *p = rbtree_insert(t, 1);
+  rbtree_insert(t, 2);
+  rbtree_erase(t, p);
+
+  node_t *q = rbtree_insert(t, 3);
+  assert(q == p);
+  assert(q->key == 3);
+  assert(rbtree_find(t, 1) == NULL);
+  assert(rbtree_find(t, 3) == q);
+  test_color_constraint(t);
+  test_search_constraint(t);
+
+  delete_rbtree(t);
+}
+
+// iterators should walk the tree in key order in both directions
+void test_iterator(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+  assert(rbtree_iter_begin(t) == rbtree_iter_end(t));
+  assert(rbtree_iter_prev(t, rbtree_iter_end(t)) == rbtree_iter_end(t));
+
+  insert_arr(t, arr, n);
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = arr[i];
+  }
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+
+  size_t i = 0;
+  for (node_t *p = rbtree_iter_begin(t); p != rbtree_iter_end(t);
+       p = rbtree_iter_next(t, p)) {
+    assert(i < n);
+    assert(p->key == sorted[i++]);
+  }
+  assert(i == n);
+
+  for (node_t *p = rbtree_iter_prev(t, rbtree_iter_end(t));
+       p != rbtree_iter_end(t); p = rbtree_iter_prev(t, p)) {
+    assert(i > 0);
+    assert(p->key == sorted[--i]);
+  }
+  assert(i == 0);
+
+  // lower_bound should land on the first of equal keys
+  for (i = 0; i < n; i++) {
+    node_t *p = rbtree_lower_bound(t, sorted[i]);
+    assert(p != NULL);
+    assert(p->key == sorted[i]);
+    node_t *q = rbtree_iter_prev(t, p);
+    assert(q == NULL || q->key < sorted[i]);
+  }
+  assert(rbtree_lower_bound(t, sorted[n - 1] + 1) == rbtree_iter_end(t));
+  assert(rbtree_lower_bound(t, sorted[0] - 1) == rbtree_iter_begin(t));
+
+  free(sorted);
+  delete_rbtree(t);
+}
+
+void test_iterator_suite() {
+  const key_t entries[] = {10, 5, 5, 34, 6, 23, 12, 12, 6, 12, 990, 2};
+  const size_t n = sizeof(entries) / sizeof(entries[0]);
+  test_iterator(entries, n);
+}
+
+// rbtree should keep both constraints and consistent parent links while
+// inserts and erases interleave
+static bool parent_traverse(const node_t *p, const node_t *parent,
+                            node_t *nil) {
+  if (p == nil) {
+    return true;
+  }
+  return p->parent == parent && parent_traverse(p->left, p, nil) &&
+         parent_traverse(p->right, p, nil);
+}
+
+void test_erase_constraints(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    const key_t key = rand() % (n / 4 + 1);
+    node_t *p = rbtree_find(t, key);
+    if (p != NULL && rand() % 2) {
+      rbtree_erase(t, p);
+    } else {
+      rbtree_insert(t, key);
+    }
+    if (i % 64 == 0) {
+      test_color_constraint(t);
+      test_search_constraint(t);
+      assert(parent_traverse(t->root, t->nil, t->nil));
+    }
+  }
+  delete_rbtree(t);
+}
+
+// rank/select/count_range should agree with a sorted copy of the keys
+static size_t sorted_rank(const key_t *sorted, const size_t n, const key_t key) {
+  size_t i = 0;
+  while (i < n && sorted[i] < key) {
+    i++;
+  }
+  return i;
+}
+
+static void check_order_statistics(const rbtree *t, const key_t *sorted,
+                                   const size_t n) {
+  assert(rbtree_size(t) == n);
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_select(t, i);
+    assert(p != NULL);
+    assert(p->key == sorted[i]);
+    assert(rbtree_rank(t, sorted[i]) == sorted_rank(sorted, n, sorted[i]));
+    assert(rbtree_rank(t, sorted[i] + 1) ==
+           sorted_rank(sorted, n, sorted[i] + 1));
+  }
+  assert(rbtree_select(t, n) == NULL);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i; j < n; j++) {
+      assert(rbtree_count_range(t, sorted[i], sorted[j]) ==
+             sorted_rank(sorted, n, sorted[j]) -
+                 sorted_rank(sorted, n, sorted[i]));
+    }
+  }
+}
+
+void test_order_statistics(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  assert(rbtree_size(t) == 0);
+  assert(rbtree_select(t, 0) == NULL);
+  assert(rbtree_rank(t, 0) == 0);
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % (n / 2);
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  check_order_statistics(t, arr, n);
+
+  // erase every other key and compare against the survivors
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i % 2) {
+      rbtree_erase(t, rbtree_find(t, arr[i]));
+    } else {
+      arr[m++] = arr[i];
+    }
+  }
+  check_order_statistics(t, arr, m);
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+// bulk-built trees should satisfy both constraints for every size and keep
+// working as ordinary trees afterwards
+void test_from_array(const size_t max_n) {
+  for (size_t n = 0; n <= max_n; n++) {
+    key_t *arr = calloc(n + 1, sizeof(key_t));
+    for (size_t i = 0; i < n; i++) {
+      arr[i] = (key_t)((i * 7919) % (n / 2 + 1));
+    }
+
+    rbtree *t = rbtree_from_array(arr, n);
+    qsort((void *)arr, n, sizeof(key_t), comp);
+    rbtree *u = rbtree_from_sorted_array(arr, n);
+    rbtree *trees[] = {t, u};
+    for (int k = 0; k < 2; k++) {
+      test_color_constraint(trees[k]);
+      test_search_constraint(trees[k]);
+      assert(parent_traverse(trees[k]->root, trees[k]->nil, trees[k]->nil));
+      check_order_statistics(trees[k], arr, n);
+    }
+
+    key_t *res = calloc(n + 1, sizeof(key_t));
+    rbtree_to_array(t, res, n);
+    for (size_t i = 0; i < n; i++) {
+      assert(res[i] == arr[i]);
+    }
+    free(res);
+
+    for (size_t i = 0; i < n; i++) {
+      node_t *p = rbtree_find(u, arr[i]);
+      assert(p != NULL);
+      rbtree_erase(u, p);
+      test_color_constraint(u);
+      rbtree_insert(t, arr[i]);
+    }
+    assert(rbtree_size(u) == 0);
+    test_color_constraint(t);
+    assert(rbtree_size(t) == 2 * n);
+
+    free(arr);
+    delete_rbtree(u);
+    delete_rbtree(t);
+  }
+}
+
+// find_many should return exactly what rbtree_find returns for every key
+void test_find_many(const size_t n, const size_t batch, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *keys = calloc(batch, sizeof(key_t));
+  node_t **out = calloc(batch, sizeof(node_t *));
+
+  for (size_t i = 0; i < batch; i++) {
+    keys[i] = rand() % (2 * n + 1);
+  }
+  rbtree_find_many(t, keys, batch, out);
+  for (size_t i = 0; i < batch; i++) {
+    assert(out[i] == NULL);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % (2 * n + 1));
+  }
+  for (size_t len = 0; len <= batch; len = len ? len * 2 : 1) {
+    rbtree_find_many(t, keys, len, out);
+    for (size_t i = 0; i < len; i++) {
+      assert(out[i] == rbtree_find(t, keys[i]));
+    }
+  }
+
+  free(out);
+  free(keys);
+  delete_rbtree(t);
+}
+
+// range visitor that copies keys and stops after limit nodes
+typedef struct {
+  key_t *keys;
+  size_t count, limit;
+} range_visit_t;
+
+static int collect_range(node_t *p, void *ctx) {
+  range_visit_t *v = (range_visit_t *)ctx;
+  v->keys[v->count++] = p->key;
+  return v->count == v->limit;
+}
+
+// t should be a valid rbtree holding exactly sorted[0, n), including sizes
+// and parent links
+static void check_tree(const rbtree *t, const key_t *sorted, const size_t n) {
+  test_color_constraint(t);
+  test_search_constraint(t);
+  assert(parent_traverse(t->root, t->nil, t->nil));
+  assert(rbtree_size(t) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(rbtree_select(t, i)->key == sorted[i]);
+  }
+}
+
+// erase_range should remove exactly the sorted slice [lo, hi)
+static size_t check_erase_range(rbtree *t, key_t *sorted, size_t n,
+                                const key_t lo, const key_t hi) {
+  const size_t from = sorted_rank(sorted, n, lo);
+  const size_t to = lo < hi ? sorted_rank(sorted, n, hi) : from;
+  assert(rbtree_erase_range(t, lo, hi) == to - from);
+  for (size_t i = to; i < n; i++) {
+    sorted[i - (to - from)] = sorted[i];
+  }
+  n -= to - from;
+  check_tree(t, sorted, n);
+  return n;
+}
+
+void test_range_fixed() {
+  const key_t arr[] = {10, 5, 8, 34, 67, 23, 156, 24, 2, 12, 24, 36, 990, 25};
+  const size_t n = sizeof(arr) / sizeof(arr[0]);
+  key_t sorted[sizeof(arr) / sizeof(arr[0])];
+  key_t keys[sizeof(arr) / sizeof(arr[0])];
+  rbtree *t = new_rbtree();
+  insert_arr(t, arr, n);
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = arr[i];
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+
+  range_visit_t v = {keys, 0, n + 1};
+  assert(rbtree_foreach_range(t, 12, 36, collect_range, &v) == 6);
+  const key_t expect[] = {12, 23, 24, 24, 25, 34};
+  for (size_t i = 0; i < v.count; i++) {
+    assert(keys[i] == expect[i]);
+  }
+  v = (range_visit_t){keys, 0, 2};
+  assert(rbtree_foreach_range(t, 0, 1000, collect_range, &v) == 2);
+  assert(keys[0] == 2 && keys[1] == 5);
+  assert(rbtree_foreach_range(t, 36, 36, collect_range, &v) == 0);
+
+  size_t m = n;
+  m = check_erase_range(t, sorted, m, 24, 25);
+  assert(rbtree_find(t, 24) == NULL);
+  m = check_erase_range(t, sorted, m, 30, 20);
+  m = check_erase_range(t, sorted, m, 0, 9);
+  m = check_erase_range(t, sorted, m, 100, 2000);
+  m = check_erase_range(t, sorted, m, 2000, 3000);
+  assert(m == 7);
+  m = check_erase_range(t, sorted, m, 0, 2000);
+  assert(m == 0 && t->root == t->nil);
+
+  // the tree keeps working after being emptied
+  test_find_erase(t, arr, n);
+  delete_rbtree(t);
+}
+
+void test_range_rand(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *sorted = calloc(n, sizeof(key_t));
+  key_t *keys = calloc(n, sizeof(key_t));
+  size_t m = 0;
+
+  for (int round = 0; round < 40; round++) {
+    // refill with duplicates so splits see runs of equal keys
+    while (m < n) {
+      sorted[m] = rand() % (n / 2 + 1);
+      rbtree_insert(t, sorted[m++]);
+    }
+    qsort(sorted, m, sizeof(key_t), comp);
+
+    const key_t lo = rand() % (n / 2 + 1);
+    const key_t hi = lo + rand() % (n / 8 + 1);
+    range_visit_t v = {keys, 0, n + 1};
+    const size_t from = sorted_rank(sorted, m, lo);
+    const size_t to = sorted_rank(sorted, m, hi);
+    assert(rbtree_foreach_range(t, lo, hi, collect_range, &v) == to - from);
+    for (size_t i = 0; i < v.count; i++) {
+      assert(keys[i] == sorted[from + i]);
+    }
+
+    m = check_erase_range(t, sorted, m, lo, hi);
+    // a few single erases on the joined tree
+    for (int i = 0; i < 8 && m > 0; i++) {
+      const size_t j = rand() % m;
+      rbtree_erase(t, rbtree_find(t, sorted[j]));
+      sorted[j] = sorted[--m];
+    }
+    qsort(sorted, m, sizeof(key_t), comp);
+    test_color_constraint(t);
+    assert(rbtree_size(t) == m);
+  }
+
+  free(keys);
+  free(sorted);
+  delete_rbtree(t);
+}
+
+// split should partition at the key and join should put the halves back
+// together around a new pivot, on shared and on separate pools
+void test_split_join(const size_t n, const unsigned int seed) {
+  srand(seed);
+  key_t *sorted = calloc(n + 1, sizeof(key_t));
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = rand() % (n / 2 + 1);
+    rbtree_insert(t, sorted[i]);
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+
+  size_t m = n;
+  for (int round = 0; round < 20; round++) {
+    const key_t key = rand() % (n / 2 + 3) - 1;
+    const size_t rank = sorted_rank(sorted, m, key);
+    rbtree *lo, *hi;
+    rbtree_split(t, key, &lo, &hi);
+    assert(lo == t);
+    assert(hi->pool == lo->pool);
+    check_tree(lo, sorted, rank);
+    check_tree(hi, sorted + rank, m - rank);
+
+    t = rbtree_join(lo, key, hi);
+    for (size_t i = m; i > rank; i--) {
+      sorted[i] = sorted[i - 1];
+    }
+    sorted[rank] = key;
+    if (++m > n) {
+      rbtree_erase(t, rbtree_find(t, sorted[--m]));
+    }
+    check_tree(t, sorted, m);
+  }
+
+  // separate pools: small is the only tree on its pool, so the pool is
+  // merged into t's and the nodes move over as they are
+  const key_t small_keys[] = {-30, -20, -10};
+  rbtree *small = rbtree_from_sorted_array(small_keys, 3);
+  node_t *moved = rbtree_find(small, -20);
+  t = rbtree_join(small, -5, t);
+  assert(rbtree_size(t) == m + 4);
+  test_color_constraint(t);
+  assert(parent_traverse(t->root, t->nil, t->nil));
+  assert(rbtree_min(t)->key == -30);
+  assert(rbtree_select(t, 3)->key == -5);
+  assert(rbtree_find(t, -20) == moved);
+
+  // both pools still have another tree on them: the smaller side is copied
+  rbtree *lo, *hi, *a_lo, *a_hi;
+  rbtree_split(rbtree_from_sorted_array(small_keys, 3), -15, &a_lo, &a_hi);
+  rbtree_split(t, -1, &lo, &hi);
+  const size_t hi_size = rbtree_size(hi);
+  t = rbtree_join(a_lo, -15, hi);
+  assert(rbtree_size(t) == hi_size + 3);
+  test_color_constraint(t);
+  assert(parent_traverse(t->root, t->nil, t->nil));
+  assert(rbtree_min(t)->key == -30 && rbtree_select(t, 2)->key == -15);
+  assert(rbtree_size(a_hi) == 1 && rbtree_size(lo) == 4);
+  delete_rbtree(a_hi);
+  delete_rbtree(lo);
+  delete_rbtree(t);
+
+  // empty sides
+  t = new_rbtree();
+  rbtree_split(t, 0, &lo, &hi);
+  assert(rbtree_size(lo) == 0 && rbtree_size(hi) == 0);
+  t = rbtree_join(lo, 7, hi);
+  assert(rbtree_size(t) == 1 && rbtree_find(t, 7) != NULL);
+  delete_rbtree(t);
+
+  free(sorted);
+}
+
+typedef enum { OP_UNION, OP_INTERSECTION, OP_DIFFERENCE } set_op_kind_t;
+
+// merge of two sorted arrays with std::set_union etc. semantics
+static size_t set_op_ref(set_op_kind_t op, const key_t *a, const size_t na,
+                         const key_t *b, const size_t nb, key_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na || j < nb) {
+    if (j == nb || (i < na && a[i] < b[j])) {
+      if (op != OP_INTERSECTION) {
+        out[k++] = a[i];
+      }
+      i++;
+    } else if (i == na || b[j] < a[i]) {
+      if (op == OP_UNION) {
+        out[k++] = b[j];
+      }
+      j++;
+    } else {
+      if (op != OP_DIFFERENCE) {
+        out[k++] = a[i];
+      }
+      i++;
+      j++;
+    }
+  }
+  return k;
+}
+
+// union/intersection/difference should match the sorted-array reference for
+// every size ratio, with duplicates, on shared and separate pools
+void test_set_operations(const size_t n, const unsigned int seed) {
+  srand(seed);
+  key_t *a = calloc(n, sizeof(key_t));
+  key_t *b = calloc(n, sizeof(key_t));
+  key_t *expect = calloc(2 * n, sizeof(key_t));
+
+  for (int round = 0; round < 60; round++) {
+    const set_op_kind_t op = round % 3;
+    // every fifth round pits a handful of keys against the whole tree
+    const size_t na = rand() % (n + 1);
+    const size_t nb = round % 5 == 4 ? rand() % 4 : rand() % (n / (1 + round % 4) + 1);
+    const key_t range = rand() % 2 ? n : n / 8 + 1;
+    rbtree *ta = new_rbtree();
+    rbtree *tb = round % 2 ? new_rbtree_shared(ta) : new_rbtree();
+    for (size_t i = 0; i < na; i++) {
+      a[i] = rand() % range;
+      rbtree_insert(ta, a[i]);
+    }
+    for (size_t i = 0; i < nb; i++) {
+      b[i] = rand() % range;
+      rbtree_insert(tb, b[i]);
+    }
+    qsort(a, na, sizeof(key_t), comp);
+    qsort(b, nb, sizeof(key_t), comp);
+    const size_t m = set_op_ref(op, a, na, b, nb, expect);
+
+    rbtree *t = op == OP_UNION          ? rbtree_union(ta, tb)
+                : op == OP_INTERSECTION ? rbtree_intersection(ta, tb)
+                                        : rbtree_difference(ta, tb);
+    check_tree(t, expect, m);
+    delete_rbtree(t);
+  }
+
+  free(expect);
+  free(b);
+  free(a);
+}
+
+// counted trees hold one node per distinct key; check_tree also covers
+// select and sizes, which count every copy
+static size_t count_nodes(const rbtree *t) {
+  size_t nodes = 0, keys = 0;
+  for (node_t *p = rbtree_iter_begin(t); p != NULL; p = rbtree_iter_next(t, p)) {
+    nodes++;
+    keys += rbtree_node_count(p);
+  }
+  assert(keys == rbtree_size(t));
+  return nodes;
+}
+
+static size_t count_distinct(const key_t *sorted, const size_t n) {
+  size_t distinct = 0;
+  for (size_t i = 0; i < n; i++) {
+    distinct += i == 0 || sorted[i - 1] != sorted[i];
+  }
+  return distinct;
+}
+
+// insert/erase/range/split/set operations on counted trees should match the
+// same multiset kept as a sorted array
+void test_counted(const size_t n, const unsigned int seed) {
+  srand(seed);
+  const key_t range = 40;
+  key_t *sorted = calloc(2 * n, sizeof(key_t));
+  key_t *other = calloc(n, sizeof(key_t));
+  key_t *expect = calloc(2 * n, sizeof(key_t));
+  rbtree *t = new_rbtree_counted();
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = rand() % range;
+    node_t *p = rbtree_insert(t, sorted[i]);
+    assert(p->key == sorted[i]);
+    assert(rbtree_find(t, sorted[i]) == p);
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+  size_t m = n;
+  check_tree(t, sorted, m);
+  assert(count_nodes(t) == count_distinct(sorted, m));
+  for (key_t k = -1; k <= range; k++) {
+    assert(rbtree_rank(t, k) == sorted_rank(sorted, m, k));
+  }
+
+  key_t *res = calloc(2 * n, sizeof(key_t));
+  rbtree_to_array(t, res, m);
+  for (size_t i = 0; i < m; i++) {
+    assert(res[i] == sorted[i]);
+  }
+
+  // erase drops one copy at a time and the node goes with the last one
+  for (size_t i = 0; i < n / 4; i++) {
+    const size_t j = rand() % m;
+    node_t *p = rbtree_find(t, sorted[j]);
+    const size_t count = rbtree_node_count(p);
+    rbtree_erase(t, p);
+    if (count > 1) {
+      assert(rbtree_find(t, sorted[j]) == p);
+      assert(rbtree_node_count(p) == count - 1);
+    }
+    for (size_t k = j + 1; k < m; k++) {
+      sorted[k - 1] = sorted[k];
+    }
+    m--;
+  }
+  check_tree(t, sorted, m);
+  assert(count_nodes(t) == count_distinct(sorted, m));
+
+  m = check_erase_range(t, sorted, m, 3, 5);
+  m = check_erase_range(t, sorted, m, 10, 30);
+  assert(count_nodes(t) == count_distinct(sorted, m));
+
+  // split and join keep every copy on the right side
+  const key_t key = range / 2;
+  const size_t rank = sorted_rank(sorted, m, key);
+  rbtree *lo, *hi;
+  rbtree_split(t, key, &lo, &hi);
+  assert(hi->counted);
+  check_tree(lo, sorted, rank);
+  check_tree(hi, sorted + rank, m - rank);
+  t = rbtree_join(lo, key, hi);
+  for (size_t i = m; i > rank; i--) {
+    sorted[i] = sorted[i - 1];
+  }
+  sorted[rank] = key;
+  check_tree(t, sorted, ++m);
+
+  // set operations, on a separate pool so the smaller side is rebuilt
+  for (int round = 0; round < 4; round++) {
+    const set_op_kind_t op = round % 3;
+    rbtree *a = new_rbtree_counted();
+    rbtree *b = new_rbtree_counted();
+    for (size_t i = 0; i < m; i++) {
+      rbtree_insert(a, sorted[i]);
+    }
+    const size_t nb = round == 3 ? 3 : n;  // a tiny union inserts instead
+    for (size_t i = 0; i < nb; i++) {
+      other[i] = rand() % range;
+      rbtree_insert(b, other[i]);
+    }
+    qsort(other, nb, sizeof(key_t), comp);
+    const size_t ne = set_op_ref(op, sorted, m, other, nb, expect);
+    rbtree *r = op == OP_UNION          ? rbtree_union(a, b)
+                : op == OP_INTERSECTION ? rbtree_intersection(a, b)
+                                        : rbtree_difference(a, b);
+    check_tree(r, expect, ne);
+    assert(count_nodes(r) == count_distinct(expect, ne));
+    delete_rbtree(r);
+  }
+
+  delete_rbtree(t);
+  free(res);
+  free(expect);
+  free(other);
+  free(sorted);
+}
+
+// reading through a cursor in chunks of any size, or streaming to a file,
+// should produce exactly rbtree_to_array's output
+static void check_export(const rbtree *t, const key_t *sorted, const size_t n) {
+  key_t *buf = calloc(n + 1, sizeof(key_t));
+  const size_t chunks[] = {1, 3, 64, n + 1};
+  for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+    rbtree_cursor_t cursor;
+    rbtree_cursor_begin(t, &cursor);
+    size_t total = 0, got;
+    while ((got = rbtree_cursor_read(t, &cursor, buf + total, chunks[c])) > 0) {
+      assert(got <= chunks[c]);
+      total += got;
+    }
+    assert(total == n);
+    for (size_t i = 0; i < n; i++) {
+      assert(buf[i] == sorted[i]);
+    }
+    assert(rbtree_cursor_read(t, &cursor, buf, 1) == 0);
+  }
+
+  FILE *f = tmpfile();
+  assert(f != NULL);
+  assert(rbtree_write_fd(t, fileno(f)) == 0);
+  assert(lseek(fileno(f), 0, SEEK_SET) == 0);
+  assert(read(fileno(f), buf, (n + 1) * sizeof(key_t)) ==
+         (ssize_t)(n * sizeof(key_t)));
+  for (size_t i = 0; i < n; i++) {
+    assert(buf[i] == sorted[i]);
+  }
+  fclose(f);
+  free(buf);
+}
+
+void test_export(const size_t n, const unsigned int seed) {
+  srand(seed);
+  key_t *sorted = calloc(n + 1, sizeof(key_t));
+  rbtree *t = new_rbtree();
+  rbtree *c = new_rbtree_counted();
+  check_export(t, sorted, 0);
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = rand() % (n / 8 + 1);
+    rbtree_insert(t, sorted[i]);
+    rbtree_insert(c, sorted[i]);
+  }
+  qsort(sorted, n, sizeof(key_t), comp);
+  check_export(t, sorted, n);
+  check_export(c, sorted, n);
+
+  // more keys than one write block, also as a single counted node, and a
+  // failing write
+  delete_rbtree(t);
+  delete_rbtree(c);
+  t = new_rbtree();
+  c = new_rbtree_counted();
+  const size_t big = 40000;
+  key_t *keys = calloc(big, sizeof(key_t));
+  key_t *same = calloc(big, sizeof(key_t));
+  for (size_t i = 0; i < big; i++) {
+    keys[i] = (key_t)i;
+    same[i] = 7;
+    rbtree_insert(t, keys[i]);
+    rbtree_insert(c, same[i]);
+  }
+  check_export(t, keys, big);
+  check_export(c, same, big);
+  assert(rbtree_write_fd(t, -1) == -1);
+
+  free(same);
+  free(keys);
+  delete_rbtree(c);
+  delete_rbtree(t);
+  free(sorted);
+}
+
+// Stack usage
+// paint_stack fills a region below the caller's frame with a pattern, and
+// stack_used reports how deep the calls made since then wrote into it.
+// The probe only has to be deep enough to see a recursive fixup or teardown
+// grow with the tree, and 16384 keys already make that several KiB; a 64 KiB
+// probe over 65536 keys made the suite take half a minute.
+#define STACK_PROBE_BYTES (8 * 1024)
+#define STACK_PATTERN 0xa5
+#define STACK_SLACK_BYTES 256  // libc paths, e.g. malloc growing the heap
+
+// AddressSanitizer pads every frame with redzones, so the numbers would not
+// mean anything there
+#if defined(__SANITIZE_ADDRESS__)
+#define STACK_PROBE_SKIP 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define STACK_PROBE_SKIP 1
+#endif
+#endif
+
+static uintptr_t stack_probe;  // address of paint_stack's (dead) buffer
+
+static __attribute__((noinline)) void paint_stack(void) {
+  volatile unsigned char probe[STACK_PROBE_BYTES];
+  for (size_t i = 0; i < STACK_PROBE_BYTES; i++) {
+    probe[i] = STACK_PATTERN;
+  }
+  stack_probe = (uintptr_t)probe;
+}
+
+static size_t stack_used(void) {
+  const volatile unsigned char *probe =
+      (const volatile unsigned char *)stack_probe;
+  size_t untouched = 0;
+  while (untouched < STACK_PROBE_BYTES && probe[untouched] == STACK_PATTERN) {
+    untouched++;
+  }
+  return STACK_PROBE_BYTES - untouched;
+}
+
+// insert/erase fixups and teardown should run in constant stack space, so a
+// large tree needs no more stack than a small one
+static size_t max_stack_usage(const size_t n) {
+  size_t max_used = 0, used;
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    paint_stack();
+    rbtree_insert(t, (key_t)i);
+    used = stack_used();
+    max_used = used > max_used ? used : max_used;
+  }
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find(t, (key_t)(i * 7919 % n));
+    paint_stack();
+    rbtree_erase(t, p);
+    used = stack_used();
+    max_used = used > max_used ? used : max_used;
+  }
+  insert_arr(t, (key_t[]){3, 1, 4, 1, 5, 9, 2, 6}, 8);
+  paint_stack();
+  delete_rbtree(t);
+  used = stack_used();
+  return used > max_used ? used : max_used;
+}
+
+void test_stack_usage(void) {
+#ifdef STACK_PROBE_SKIP
+  printf("stack usage: skipped under AddressSanitizer\n");
+#else
+  const size_t small = max_stack_usage(16);
+  const size_t large = max_stack_usage(1 << 14);
+  printf("stack usage: %zu bytes (16 keys), %zu bytes (16384 keys)\n", small, large);
+  assert(large <= small + STACK_SLACK_BYTES);
+#endif
+}
+
+// hinted inserts and finger finds from random, nearby and NULL fingers should
+// match plain insert / find on the same keys
+static void check_finger(rbtree *t, const size_t n, const int sorted_input) {
+  key_t *keys = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = sorted_input ? (key_t)(i * 4 + rand() % 16) : rand() % (key_t)n;
+    node_t *hint = NULL;
+    if (i > 0 && rand() % 2) {
+      hint = rbtree_find(t, keys[rand() % i]);
+    }
+    assert(rbtree_insert_hint(t, hint, keys[i])->key == keys[i]);
+  }
+  qsort(keys, n, sizeof(key_t), comp);
+  check_tree(t, keys, n);
+
+  for (key_t key = -2; key < (key_t)(4 * n + 20); key++) {
+    const size_t rank = sorted_rank(keys, n, key);
+    const int present = rank < n && keys[rank] == key;
+    node_t *fingers[] = {NULL, rbtree_min(t), rbtree_max(t),
+                         rbtree_select(t, rank < n ? rank : n - 1),
+                         rbtree_select(t, rand() % n)};
+    for (size_t f = 0; f < sizeof(fingers) / sizeof(fingers[0]); f++) {
+      node_t *p = rbtree_find_from(t, fingers[f], key);
+      assert(present ? (p != NULL && p->key == key) : p == NULL);
+    }
+  }
+
+  // the automatic finger must not outlive its node
+  for (size_t i = 0; i < n / 2; i++) {
+    rbtree_erase(t, rbtree_find(t, keys[i]));
+    rbtree_insert_hint(t, NULL, keys[i]);
+    rbtree_erase(t, t->finger);
+    assert(t->finger == NULL || rbtree_find(t, t->finger->key) != NULL);
+  }
+  check_tree(t, keys + n / 2, n - n / 2);
+  free(keys);
+}
+
+void test_finger(const size_t n, const unsigned int seed) {
+  srand(seed);
+  for (int sorted_input = 0; sorted_input < 2; sorted_input++) {
+    rbtree *t = new_rbtree();
+    check_finger(t, n, sorted_input);
+    delete_rbtree(t);
+  }
+
+  // counted mode bumps the existing node instead of adding one
+  rbtree *t = new_rbtree_counted();
+  node_t *first = rbtree_insert_hint(t, NULL, 5);
+  for (key_t key = 0; key < 10; key++) {
+    rbtree_insert_hint(t, NULL, key);
+  }
+  assert(rbtree_find_from(t, NULL, 5) == first);
+  assert(rbtree_node_count(first) == 2 && rbtree_size(t) == 11);
+  assert(count_nodes(t) == 10);
+  delete_rbtree(t);
+
+  // split hands nodes to another tree, so the finger is dropped
+  t = new_rbtree();
+  for (key_t key = 0; key < 100; key++) {
+    rbtree_insert_hint(t, NULL, key);
+  }
+  rbtree *lo, *hi;
+  rbtree_split(t, 50, &lo, &hi);
+  assert(lo->finger == NULL && hi->finger == NULL);
+  rbtree_insert_hint(lo, NULL, 49);
+  assert(rbtree_size(lo) == 51);
+  delete_rbtree(lo);
+  delete_rbtree(hi);
+
+  // hinted inserts leave the sizes to settle: a few settle one path each,
+  // a long run is recounted in one pass, and plain inserts and rotations in
+  // between must keep both consistent
+  t = new_rbtree();
+  for (key_t key = 0; key < 1000; key++) {
+    rbtree_insert(t, 2 * key);
+  }
+  for (key_t key = 1; key < 10; key += 2) {
+    assert(rbtree_node_count(rbtree_insert_hint(t, NULL, key)) == 1);
+  }
+  assert(t->unsized_count == 5 && rbtree_size(t) == 1005);
+  assert(rbtree_rank(t, 10) == 10 && t->unsized_count == 0);
+  for (key_t key = 2000; key < 6000; key++) {
+    rbtree_insert_hint(t, NULL, key);
+    if (key % 100 == 0) {
+      rbtree_insert(t, -key);
+    }
+  }
+  assert(rbtree_size(t) == 5045 && t->unsized_count > 0);
+  assert(rbtree_select(t, 40)->key == 0 && rbtree_rank(t, 2000) == 1045);
+  assert(t->unsized_count == 0 && rbtree_select(t, 5044)->key == 5999);
+  rbtree_insert_hint(t, NULL, 6000);
+  rbtree_erase(t, rbtree_find(t, 1));
+  assert(rbtree_size(t) == 5045 && rbtree_rank(t, 6000) == 5044);
+  delete_rbtree(t);
+}
+
+// node sizes should equal the copies in each subtree
+static size_t size_traverse(const node_t *p, const node_t *nil) {
+  if (p == nil) {
+    return 0;
+  }
+  const size_t below =
+      size_traverse(p->left, nil) + size_traverse(p->right, nil);
+  assert(p->size > below);
+  return p->size;
+}
+
+// erase should relink nodes instead of moving keys, so handles to nodes that
+// are not erased keep pointing at their key (plain and counted trees)
+void test_stable_handles(const size_t n, const unsigned int seed) {
+  srand(seed);
+  for (int counted = 0; counted < 2; counted++) {
+    rbtree *t = counted ? new_rbtree_counted() : new_rbtree();
+    node_t **handles = calloc(n, sizeof(node_t *));
+    key_t *keys = calloc(n, sizeof(key_t));
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = (key_t)(i * 7 % n);
+      handles[i] = rbtree_insert(t, keys[i]);
+    }
+    if (counted) {
+      // a second copy of every even key: erasing one keeps the node
+      for (size_t i = 0; i < n; i += 2) {
+        assert(rbtree_insert(t, keys[i]) == handles[i]);
+      }
+    }
+
+    size_t live = n;
+    while (live > 0) {
+      const size_t j = (size_t)rand() % live;
+      node_t *p = handles[j];
+      const int last_copy = rbtree_node_count(p) == 1;
+      rbtree_erase(t, p);
+      if (last_copy) {
+        handles[j] = handles[live - 1];
+        keys[j] = keys[live - 1];
+        live--;
+      }
+      if (live % 97 == 0) {
+        for (size_t i = 0; i < live; i++) {
+          assert(handles[i]->key == keys[i]);
+          assert(rbtree_find(t, keys[i]) == handles[i]);
+        }
+        test_color_constraint(t);
+        test_search_constraint(t);
+        assert(parent_traverse(t->root, t->nil, t->nil));
+        assert(size_traverse(t->root, t->nil) == rbtree_size(t));
+      }
+    }
+    assert(rbtree_size(t) == 0);
+    free(keys);
+    free(handles);
+    delete_rbtree(t);
+  }
+}
+
+// the cached min and max are the ends of the leftmost and rightmost paths
+void test_cached_ends(const rbtree *t) {
+  node_t *first = t->root, *last = t->root;
+  while (first != t->nil && first->left != t->nil) {
+    first = first->left;
+  }
+  while (last != t->nil && last->right != t->nil) {
+    last = last->right;
+  }
+  assert(t->leftmost == first && t->rightmost == last);
+}
+
+// pop_min / pop_max drain a multiset in order, mixed with inserts and
+// erases, and keep the cached ends, sizes and colors right throughout
+void test_pop(const size_t n, const unsigned int seed) {
+  srand(seed);
+  for (int counted = 0; counted < 2; counted++) {
+    rbtree *t = counted ? new_rbtree_counted() : new_rbtree();
+    key_t key;
+    assert(rbtree_pop_min(t, &key) == -1 && rbtree_pop_max(t, NULL) == -1);
+    assert(rbtree_min(t) == t->nil && rbtree_max(t) == t->nil);
+
+    // ref is kept sorted; keys repeat so counted nodes hold several copies
+    key_t *ref = calloc(n, sizeof(key_t));
+    size_t m = 0;
+    for (size_t i = 0; i < 4 * n; i++) {
+      const int op = rand() % 4;
+      if (m < n && (op == 0 || m == 0)) {
+        key = (key_t)(rand() % (n / 2 + 1));
+        rbtree_insert(t, key);
+        size_t j = m++;
+        for (; j > 0 && ref[j - 1] > key; j--) {
+          ref[j] = ref[j - 1];
+        }
+        ref[j] = key;
+      } else if (op == 1) {
+        assert(rbtree_pop_min(t, &key) == 0 && key == ref[0]);
+        memmove(ref, ref + 1, --m * sizeof(key_t));
+      } else if (op == 2) {
+        assert(rbtree_pop_max(t, &key) == 0 && key == ref[--m]);
+      } else {
+        const size_t j = (size_t)rand() % m;
+        rbtree_erase(t, rbtree_find(t, ref[j]));
+        memmove(ref + j, ref + j + 1, (--m - j) * sizeof(key_t));
+      }
+      if (m > 0) {
+        assert(rbtree_min(t)->key == ref[0] && rbtree_max(t)->key == ref[m - 1]);
+      }
+      if (i % 61 == 0) {
+        test_color_constraint(t);
+        test_search_constraint(t);
+        test_cached_ends(t);
+        assert(parent_traverse(t->root, t->nil, t->nil));
+        assert(size_traverse(t->root, t->nil) == m && rbtree_size(t) == m);
+      }
+    }
+
+    // drain from both ends
+    for (size_t lo = 0, hi = m; lo < hi;) {
+      if (rand() % 2) {
+        assert(rbtree_pop_min(t, &key) == 0 && key == ref[lo++]);
+      } else {
+        assert(rbtree_pop_max(t, &key) == 0 && key == ref[--hi]);
+      }
+    }
+    assert(rbtree_size(t) == 0 && t->root == t->nil);
+    test_cached_ends(t);
+    assert(rbtree_min(t) == t->nil && rbtree_max(t) == t->nil);
+    assert(rbtree_iter_begin(t) == NULL);
+    free(ref);
+    delete_rbtree(t);
+  }
+
+  // builders, split and join recompute the ends
+  key_t arr[] = {9, 2, 7, 4, 4, 11, 0, 5};
+  key_t key;
+  rbtree *t = rbtree_from_array(arr, 8);
+  assert(rbtree_min(t)->key == 0 && rbtree_max(t)->key == 11);
+  rbtree *lo, *hi;
+  rbtree_split(t, 5, &lo, &hi);
+  test_search_constraint(lo);
+  test_search_constraint(hi);
+  test_cached_ends(lo);
+  test_cached_ends(hi);
+  assert(rbtree_max(lo)->key == 4 && rbtree_min(hi)->key == 5);
+  assert(rbtree_pop_max(lo, &key) == 0 && key == 4 && rbtree_max(lo)->key == 4);
+  t = rbtree_join(lo, 5, hi);
+  test_search_constraint(t);
+  test_cached_ends(t);
+  assert(rbtree_min(t)->key == 0 && rbtree_max(t)->key == 11);
+  delete_rbtree(t);
+}
+
+#ifdef RBTREE_STATS
+// counters on small hand-worked cases, then the height bound on a large run
+void test_stats(const size_t n) {
+  rbtree *t = new_rbtree();
+  rbtree_insert(t, 1);
+  rbtree_insert(t, 2);
+  assert(t->stats.rotations == 0 && t->stats.recolors == 1);
+  // 1 -> 2 -> 3 is the outer case: one rotation, parent and grandparent recolored
+  rbtree_insert(t, 3);
+  assert(t->stats.rotations == 1 && t->stats.insert_fixup[1] == 1);
+  assert(t->stats.recolors == 3 && t->stats.comparisons == 3);
+  assert(t->stats.max_height == 3);
+  rbtree_find(t, 2);
+  assert(t->stats.comparisons == 4);
+  rbtree_find(t, 0);
+  assert(t->stats.comparisons == 6);
+  rbtree_stats_reset(t);
+  assert(t->stats.comparisons == 0 && t->stats.max_height == 0);
+  delete_rbtree(t);
+
+  // 3 -> 1 -> 2 is the inner case: two rotations
+  t = new_rbtree();
+  rbtree_insert(t, 3);
+  rbtree_insert(t, 1);
+  rbtree_insert(t, 2);
+  assert(t->stats.rotations == 2 && t->stats.insert_fixup[2] == 1);
+  delete_rbtree(t);
+
+  t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)i);
+  }
+  size_t bound = 1;
+  while (((size_t)1 << bound) <= n) {
+    bound++;
+  }
+  // height <= 2 log2(n + 1), and a new node sits one below a leaf
+  assert(t->stats.max_height <= 2 * bound + 1);
+  const size_t rotations = t->stats.rotations;
+  assert(rotations > 0 && rotations < n);
+  for (size_t i = 0; i < n; i++) {
+    rbtree_erase(t, rbtree_find(t, (key_t)i));
+  }
+  const rbtree_stats_t *stats = &t->stats;
+  assert(stats->erase_fixup[0] + stats->erase_fixup[1] + stats->erase_fixup[2] +
+             stats->erase_fixup[3] > 0);
+  assert(stats->rotations > rotations);
+  FILE *out = tmpfile();
+  rbtree_stats_dump(t, out);
+  assert(ftell(out) > 0);
+  fclose(out);
+  delete_rbtree(t);
+}
+#endif
+
 int main(void) {
   test_init();
   test_insert_single(1024);
@@ -379,5 +1445,24 @@ int main(void) {
   test_duplicate_values();
   test_multi_instance();
   test_find_erase_rand(10000, 17);
+  test_node_reuse();
+  test_iterator_suite();
+  test_erase_constraints(20000, 3);
+  test_order_statistics(300, 5);
+  test_from_array(130);
+  test_stack_usage();
+  test_find_many(5000, 4096, 13);
+  test_range_fixed();
+  test_range_rand(2000, 23);
+  test_split_join(500, 29);
+  test_set_operations(2000, 31);
+  test_counted(3000, 37);
+  test_export(3000, 43);
+  test_finger(2000, 47);
+  test_stable_handles(3000, 53);
+  test_pop(2000, 59);
+#ifdef RBTREE_STATS
+  test_stats(10000);
+#endif
   printf("Passed all tests!\n");
 }